@@ -0,0 +1,323 @@
+// BatchSession.cpp
+// The line command syntax shared with the server, and batch mode.
+#include "MediTrack.h"
+
+// ------------------- CommandSyntax -------------------
+bool CommandSyntax::tokenize(string_view line, vector<string>& fields) {
+    fields.clear();
+    size_t i = 0;
+    while (true) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+        if (i == line.size()) return true;
+        string field;
+        if (line[i] == '"') {
+            for (++i;; ++i) {
+                if (i == line.size()) return false;
+                if (line[i] == '"') { ++i; break; }
+                if (line[i] == '\\' && i + 1 < line.size()) ++i;
+                field += line[i];
+            }
+        } else {
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') field += line[i++];
+        }
+        fields.push_back(move(field));
+    }
+}
+
+const char* CommandSyntax::parsePatient(const vector<string>& f, PatientArgs& out) {
+    if (f.size() < 3 || f.size() > 4) return "usage: add-patient NAME AGE [CONTACT]";
+    if (f[1].empty()) return "empty name";
+    if (!parseNumber(f[2], out.age) || out.age < 0 || out.age > 150) return "bad age";
+    out.name = f[1];
+    out.contact = f.size() == 4 ? f[3] : string();
+    return nullptr;
+}
+
+const char* CommandSyntax::parseRecord(const vector<string>& f, RecordArgs& out) {
+    const char* usage = "usage: add-record PATIENT BP|Weight|Sugar VALUE [DIASTOLIC] [TIMESTAMP]";
+    if (f.size() < 4) return usage;
+    if (!parseKind(f[2], out.kind)) return "unknown type";
+    size_t values = vitalInfo(out.kind).values;
+    if (f.size() < 3 + values || f.size() > 4 + values) return usage;
+    if (!parseNumber(f[3], out.value1) || !plausible(out.value1)) return "bad value";
+    out.value2 = 0;
+    if (values == 2 && (!parseNumber(f[4], out.value2) || !plausible(out.value2))) return "bad value";
+    long long timestamp = time(nullptr);
+    if (f.size() == 4 + values && (!parseNumber(f[3 + values], timestamp) || timestamp <= 0)) return "bad timestamp";
+    out.timestamp = time_t(timestamp);
+    return nullptr;
+}
+
+const char* CommandSyntax::parseTrend(const vector<string>& f, TrendArgs& out) {
+    long long days = 30;
+    if (f.size() < 3 || f.size() > 5) return "usage: query-trend PATIENT BP|Weight|Sugar [DAYS [readings|day|week]]";
+    if (!parseKind(f[2], out.kind)) return "unknown type";
+    if (f.size() >= 4 && (!parseNumber(f[3], days) || days < 0)) return "bad number of days";
+    out.view = f.size() == 5 ? f[4] : "readings";
+    if (out.view != "readings" && out.view != "day" && out.view != "week") return "unknown view";
+    out.to = numeric_limits<time_t>::max();
+    out.from = days == 0 ? numeric_limits<time_t>::min() : time(nullptr) - time_t(days) * 24 * 60 * 60;
+    return nullptr;
+}
+
+void CommandSyntax::writeReading(JsonWriter& json, VitalKind kind, const VitalSeries& s, size_t i, bool withType) {
+    json.beginObject();
+    if (withType) json.field("type", kindTag(kind));
+    json.field("timestamp", uint64_t(s.times()[i]));
+    json.field("value", s.values1()[i]);
+    if (vitalHasSecondValue(kind)) json.field("value2", s.secondAt(i));
+    json.endObject();
+}
+
+void CommandSyntax::writeTrend(JsonWriter& json, long long patientId, const TrendArgs& t, const VitalSeries& s, size_t first,
+                               size_t last, const RollupBucket* buckets, size_t bucketCount) {
+    json.field("patient", uint64_t(patientId));
+    json.field("type", kindTag(t.kind));
+    json.field("view", t.view);
+    if (t.view == "readings") {
+        json.beginArray("readings");
+        for (size_t i = first; i < last; ++i) writeReading(json, t.kind, s, i, false);
+        json.endArray();
+        return;
+    }
+    json.beginArray("buckets");
+    for (size_t i = 0; i < bucketCount; ++i) {
+        const RollupBucket& b = buckets[i];
+        json.beginObject();
+        json.field("start", uint64_t(b.start));
+        json.field("readings", uint64_t(b.count));
+        json.field("min", b.min1).field("max", b.max1).field("avg", b.avg1());
+        if (vitalHasSecondValue(t.kind)) json.field("min2", b.min2).field("max2", b.max2).field("avg2", b.avg2());
+        json.endObject();
+    }
+    json.endArray();
+}
+
+void CommandSyntax::writePatient(JsonWriter& json, const Patient& p) {
+    json.beginObject("patient");
+    json.field("id", uint64_t(p.getRowId()));
+    json.field("name", p.getName());
+    json.field("age", uint64_t(p.getAge()));
+    json.field("contact", p.getContact());
+    json.beginArray("records");
+    for (VitalKind kind : allVitalKinds) {
+        const VitalSeries& s = p.getVitals().series(kind);
+        for (size_t i = 0; i < s.size(); ++i) writeReading(json, kind, s, i, true);
+    }
+    json.endArray();
+    json.beginArray("medications");
+    for (const Medication& m : p.getMedications()) {
+        json.beginObject().field("name", m.getName()).field("dosage", m.getDosage()).field("schedule", m.getSchedule()).endObject();
+    }
+    json.endArray();
+    json.beginArray("reminders");
+    for (const Reminder& r : p.getReminders()) {
+        json.beginObject().field("message", r.getMessage()).field("date", r.getDate().view()).field("time", r.getTime().view());
+        json.field("frequency", frequencyTag(r.getFrequency())).endObject();
+    }
+    json.endArray();
+    json.endObject();
+}
+
+void CommandSyntax::begin(JsonWriter& json, size_t line, string_view command) {
+    json.beginObject();
+    json.field("line", uint64_t(line));
+    json.field("command", command);
+}
+
+string CommandSyntax::error(size_t line, string_view command, const char* message) {
+    JsonWriter json(true);
+    begin(json, line, command);
+    json.flag("ok", false);
+    json.field("error", message);
+    json.endObject();
+    return json.text();
+}
+
+// ------------------- BatchSession -------------------
+const char* BatchSession::resolve(const string& ref, long long& id, const Patient*& patient) const {
+    id = 0;
+    patient = nullptr;
+    if (!ref.empty() && ref[0] == '$') {
+        size_t n = added.size();
+        if (ref.size() > 1 && (!parseNumber(ref.substr(1), n) || n == 0)) return "bad patient reference";
+        if (n > added.size()) return "no such added patient";
+        const Patient* p = added[n - 1].get();
+        if (!p) return "patient was not added";
+        if (p->isNew()) patient = p; // still queued
+        id = p->getRowId();
+        return nullptr;
+    }
+    if (!parseNumber(ref, id)) return "bad patient id";
+    return knownPatients.count(id) ? nullptr : "unknown patient";
+}
+
+void BatchSession::emit(JsonWriter& json) {
+    json.endObject();
+    out << json.text() << '\n';
+}
+
+void BatchSession::fail(size_t line, const string& command, const char* error) {
+    if (!queued.empty()) {
+        queued.push_back({line, command, 0, error});
+        return;
+    }
+    printError(line, command, error);
+}
+
+void BatchSession::printError(size_t line, const string& command, const char* message) {
+    out << error(line, command, message) << '\n';
+    ++report.failed;
+}
+
+void BatchSession::queue(size_t line, const char* command, PendingWrite w) {
+    w.queuedAt = chrono::steady_clock::now();
+    queued.push_back({line, command, writes.size(), nullptr});
+    writes.push_back(move(w));
+    if (writes.size() >= batchSize) applyQueued();
+}
+
+size_t BatchSession::applyQueued() {
+    bool ok = writes.empty() || db.applyWrites(writes, patientIds);
+    size_t written = 0;
+    for (const Queued& q : queued) {
+        if (q.error) {
+            printError(q.line, q.command, q.error);
+            continue;
+        }
+        PendingWrite& w = writes[q.write];
+        if (!ok || w.rowId == 0) {
+            if (w.kind == PendingWrite::Kind::Patient) added[w.index].reset();
+            printError(q.line, q.command, ok ? "patient was not saved" : "transaction rolled back");
+            continue;
+        }
+        if (w.kind == PendingWrite::Kind::Patient) {
+            const_cast<Patient*>(w.patient)->markSaved(w.rowId);
+            knownPatients.insert(w.rowId);
+        }
+        JsonWriter json(true);
+        begin(json, q.line, q.command);
+        json.flag("ok", true);
+        json.field("id", uint64_t(w.rowId));
+        emit(json);
+        ++written;
+    }
+    writes.clear();
+    queued.clear();
+    patientIds.clear(); // every queued patient is now saved or gone
+    return written;
+}
+
+void BatchSession::addPatient(size_t line, const vector<string>& f) {
+    PatientArgs args;
+    if (const char* error = parsePatient(f, args)) return fail(line, "add-patient", error);
+    added.push_back(make_unique<Patient>(args.name, args.age, args.contact));
+    PendingWrite w{PendingWrite::Kind::Patient, added.back().get()};
+    w.name = move(args.name);
+    w.age = args.age;
+    w.contact = move(args.contact);
+    w.index = added.size() - 1;
+    queue(line, "add-patient", move(w));
+}
+
+void BatchSession::addRecord(size_t line, const vector<string>& f) {
+    RecordArgs args;
+    PendingWrite w{PendingWrite::Kind::Vital, nullptr};
+    if (const char* error = parseRecord(f, args)) return fail(line, "add-record", error);
+    if (const char* error = resolve(f[1], w.patientId, w.patient)) return fail(line, "add-record", error);
+    w.vitalKind = args.kind;
+    w.value1 = args.value1;
+    w.value2 = args.value2;
+    w.timestamp = args.timestamp;
+    queue(line, "add-record", move(w));
+}
+
+void BatchSession::queryTrend(size_t line, const vector<string>& f) {
+    long long id;
+    const Patient* unsaved;
+    TrendArgs args;
+    if (const char* error = parseTrend(f, args)) return fail(line, "query-trend", error);
+    applyQueued();
+    if (const char* error = resolve(f[1], id, unsaved)) return fail(line, "query-trend", error);
+
+    VitalSeries series(vitalHasSecondValue(args.kind));
+    vector<RollupBucket> buckets;
+    if (args.view == "readings") db.loadVitalsInRange(id, args.kind, args.from, args.to, series);
+    else db.loadRollups(id, args.kind, args.period(), args.from, args.to, buckets);
+    JsonWriter json(true);
+    begin(json, line, "query-trend");
+    json.flag("ok", true);
+    writeTrend(json, id, args, series, 0, series.size(), buckets.data(), buckets.size());
+    emit(json);
+}
+
+void BatchSession::writePatientLine(size_t line, const Patient& p) {
+    JsonWriter json(true);
+    begin(json, line, "export");
+    json.flag("ok", true);
+    writePatient(json, p);
+    emit(json);
+}
+
+void BatchSession::exportPatients(size_t line, const vector<string>& f) {
+    if (f.size() != 2) return fail(line, "export", "usage: export PATIENT|all");
+    applyQueued();
+    pmr::unsynchronized_pool_resource memory;
+    vector<unique_ptr<Patient>> loaded;
+    if (f[1] != "all") {
+        long long id;
+        const Patient* unsaved;
+        if (const char* error = resolve(f[1], id, unsaved)) return fail(line, "export", error);
+        if (!db.loadPatientRange(loaded, id, id, &memory) || loaded.empty()) return fail(line, "export", "could not read patient");
+        return writePatientLine(line, *loaded.front());
+    }
+    // In id ranges of ExportBatch patients, so memory stays bounded.
+    constexpr size_t ExportBatch = 512;
+    vector<long long> ids(knownPatients.begin(), knownPatients.end());
+    sort(ids.begin(), ids.end());
+    size_t exported = 0;
+    for (size_t first = 0; first < ids.size(); first += ExportBatch) {
+        size_t last = min(ids.size(), first + ExportBatch) - 1;
+        loaded.clear();
+        if (!db.loadPatientRange(loaded, ids[first], ids[last], &memory)) return fail(line, "export", "could not read patients");
+        for (const auto& p : loaded) writePatientLine(line, *p);
+        exported += loaded.size();
+    }
+    JsonWriter json(true);
+    begin(json, line, "export");
+    json.flag("ok", true);
+    json.field("exported", uint64_t(exported));
+    emit(json);
+}
+
+BatchReport BatchSession::run(istream& in) {
+    auto started = chrono::steady_clock::now();
+    string text;
+    vector<string> f;
+    for (size_t line = 1; getline(in, text); ++line) {
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == string::npos || text[start] == '#') continue;
+        ++report.commands;
+        if (!tokenize(text, f)) { fail(line, "", "unterminated quote"); continue; }
+        const string& command = f[0];
+        if (command == "add-patient") addPatient(line, f);
+        else if (command == "add-record") addRecord(line, f);
+        else if (command == "query-trend") queryTrend(line, f);
+        else if (command == "export") exportPatients(line, f);
+        else if (command == "commit") {
+            size_t written = applyQueued();
+            JsonWriter json(true);
+            begin(json, line, "commit");
+            json.flag("ok", true);
+            json.field("written", uint64_t(written));
+            emit(json);
+            out.flush();
+        } else {
+            fail(line, command, "unknown command");
+        }
+    }
+    applyQueued();
+    out.flush();
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return report;
+}
@@ -0,0 +1,166 @@
+// BulkImporter.cpp
+// CSV bulk import.
+#include "MediTrack.h"
+
+// ------------------- BulkImporter -------------------
+string_view BulkImporter::trim(string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+const char* BulkImporter::parseLine(string_view line, const unordered_set<long long>& knownPatients, ImportedVital& out) {
+    string_view fields[6];
+    size_t count = 0;
+    while (count < 6) {
+        size_t comma = line.find(',');
+        fields[count++] = trim(line.substr(0, comma));
+        if (comma == string_view::npos) break;
+        line.remove_prefix(comma + 1);
+    }
+    if (count < 4 || count > 5) return "wrong number of fields";
+
+    if (!vitalKindFromTag(fields[1], out.kind)) return "unknown type";
+
+    long long timestamp;
+    if (!parseNumber(fields[0], out.patientId)) return "bad patient id";
+    if (!parseNumber(fields[2], timestamp) || timestamp <= 0) return "bad timestamp";
+    out.timestamp = (time_t)timestamp;
+    if (!parseNumber(fields[3], out.value1) || !(out.value1 > 0 && out.value1 < 1e6)) return "bad value";
+    out.value2 = 0;
+    bool hasSecond = count == 5 && !fields[4].empty();
+    if (vitalHasSecondValue(out.kind)) {
+        if (!hasSecond) return "missing second value";
+        if (!parseNumber(fields[4], out.value2) || !(out.value2 > 0 && out.value2 < 1e6)) return "bad value";
+    } else if (hasSecond) {
+        return "unexpected second value";
+    }
+    if (!knownPatients.count(out.patientId)) return "unknown patient";
+    return nullptr;
+}
+
+BulkImporter::ParsedChunk BulkImporter::parseChunk(string_view text, bool first, const unordered_set<long long>& knownPatients) {
+    ParsedChunk result;
+    result.rows.reserve(text.size() / 24);
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        string_view line = text.substr(0, end);
+        text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+        size_t lineNo = result.lineCount++;
+
+        string_view content = trim(line);
+        if (content.empty() || content.front() == '#') continue;
+        if (first && lineNo == 0 && content.substr(0, 10) == "patient_id") continue;
+
+        ImportedVital row;
+        if (const char* reason = parseLine(content, knownPatients, row)) {
+            result.rejects.push_back({lineNo, reason, trim(line)});
+        } else {
+            result.rows.push_back(row);
+        }
+    }
+    return result;
+}
+
+void BulkImporter::readStage(string_view data) {
+    size_t sequence = 0;
+    while (!data.empty()) {
+        size_t cut = data.size() <= ChunkBytes ? string_view::npos : data.find('\n', ChunkBytes);
+        cut = cut == string_view::npos ? data.size() : cut + 1;
+        unique_lock<mutex> guard(lock);
+        chunkTaken.wait(guard, [&] { return inFlight < maxInFlight; });
+        ++inFlight;
+        pendingChunks.push({sequence++, data.substr(0, cut)});
+        chunkReady.notify_one();
+        data.remove_prefix(cut);
+    }
+    lock_guard<mutex> guard(lock);
+    readerDone = true;
+    chunkReady.notify_all();
+}
+
+void BulkImporter::parseStage(const unordered_set<long long>& knownPatients) {
+    while (true) {
+        Chunk chunk;
+        {
+            unique_lock<mutex> guard(lock);
+            chunkReady.wait(guard, [&] { return !pendingChunks.empty() || readerDone; });
+            if (pendingChunks.empty()) return;
+            chunk = pendingChunks.front();
+            pendingChunks.pop();
+        }
+        ParsedChunk result = parseChunk(chunk.text, chunk.sequence == 0, knownPatients);
+        lock_guard<mutex> guard(lock);
+        parsed.emplace(chunk.sequence, move(result));
+        parsedReady.notify_all();
+    }
+}
+
+BulkImporter::BulkImporter(DatabaseManager& database, size_t batch, unsigned parsers)
+    : db(database), batchRows(batch ? batch : 1), parserCount(parsers) {
+    if (parserCount == 0) parserCount = max(1u, thread::hardware_concurrency());
+    maxInFlight = parserCount * 4;
+}
+
+ImportReport BulkImporter::run(const string& path, const string& rejectsPath) {
+    ImportReport report;
+    auto started = chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Could not open import file: " << path << endl;
+        report.ok = false;
+        return report;
+    }
+    ofstream rejects(rejectsPath, ios::binary | ios::trunc);
+    if (!rejects) {
+        cerr << "Could not create rejects file: " << rejectsPath << endl;
+        report.ok = false;
+        return report;
+    }
+    const unordered_set<long long> knownPatients = db.loadPatientIds();
+
+    readerDone = false;
+    inFlight = 0;
+    thread reader(&BulkImporter::readStage, this, file.contents());
+    vector<thread> parsers;
+    for (unsigned i = 0; i < parserCount; ++i) parsers.emplace_back(&BulkImporter::parseStage, this, cref(knownPatients));
+
+    // Writer stage: consume chunks in file order so line numbers are exact.
+    vector<ImportedVital> batch;
+    batch.reserve(batchRows);
+    size_t nextSequence = 0;
+    while (true) {
+        ParsedChunk chunk;
+        {
+            unique_lock<mutex> guard(lock);
+            parsedReady.wait(guard, [&] {
+                return parsed.count(nextSequence) || (readerDone && inFlight == 0);
+            });
+            auto it = parsed.find(nextSequence);
+            if (it == parsed.end()) break;
+            chunk = move(it->second);
+            parsed.erase(it);
+            --inFlight;
+            chunkTaken.notify_one();
+        }
+        ++nextSequence;
+
+        for (const Reject& r : chunk.rejects) {
+            rejects << "# line " << report.lines + r.line + 1 << ": " << r.reason << "\n" << r.text << "\n";
+        }
+        report.lines += chunk.lineCount;
+        report.rejected += chunk.rejects.size();
+        for (const ImportedVital& row : chunk.rows) {
+            batch.push_back(row);
+            if (batch.size() < batchRows) continue;
+            if (report.ok && (report.ok = db.insertVitalBatch(batch))) report.imported += batch.size();
+            batch.clear();
+        }
+    }
+    if (report.ok && !batch.empty() && (report.ok = db.insertVitalBatch(batch))) report.imported += batch.size();
+
+    reader.join();
+    for (thread& t : parsers) t.join();
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return report;
+}
@@ -1,39 +1,559 @@
-// File: DatabaseManager.cpp
+// DatabaseManager.cpp
+// The SQLite layer: vitals chunk encoding and DatabaseManager (connection setup,
+// schema migrations, loaders and savers).
+#include "MediTrack.h"
 
-#include "DatabaseManager.h"
-#include "mediTrack_ver_3.cpp" // Include definitions for Patient, Records, etc.
-#include <iostream>
-#include <sstream>
+// ------------------- VitalChunkCodec -------------------
+unsigned VitalChunkCodec::seeds(uint8_t transform) {
+    return transform == VitalChunkStream::DeltaOfDelta ? 2 : transform == VitalChunkStream::Plain ? 0 : 1;
+}
+
+uint8_t VitalChunkCodec::bitWidth(uint64_t range) {
+    uint8_t w = 0;
+    while (w < 64 && (range >> w) != 0) ++w;
+    return w;
+}
+
+void VitalChunkCodec::residuals(const uint64_t* x, size_t n, uint8_t transform, vector<uint64_t>& r) {
+    r.clear();
+    for (size_t i = seeds(transform); i < n; ++i) {
+        switch (transform) {
+            case VitalChunkStream::Plain: r.push_back(x[i]); break;
+            case VitalChunkStream::Delta: r.push_back(x[i] - x[i - 1]); break;
+            case VitalChunkStream::DeltaOfDelta: r.push_back((x[i] - x[i - 1]) - (x[i - 1] - x[i - 2])); break;
+            default: r.push_back(x[i] ^ x[i - 1]); break;
+        }
+    }
+}
+
+void VitalChunkCodec::appendStream(string& out, const uint64_t* x, size_t n, initializer_list<uint8_t> transforms, uint8_t decimals) {
+    VitalChunkStream h{};
+    vector<uint64_t> r, best;
+    size_t bestBits = numeric_limits<size_t>::max();
+    for (uint8_t t : transforms) {
+        if (n < seeds(t)) continue;
+        residuals(x, n, t, r);
+        int64_t lo = 0, hi = 0;
+        if (!r.empty()) lo = hi = int64_t(r[0]);
+        for (uint64_t v : r) { lo = min(lo, int64_t(v)); hi = max(hi, int64_t(v)); }
+        uint8_t width = bitWidth(uint64_t(hi) - uint64_t(lo));
+        if (r.size() * width >= bestBits) continue;
+        bestBits = r.size() * width;
+        h.transform = t;
+        h.width = width;
+        h.reference = uint64_t(lo);
+        best.swap(r);
+    }
+    h.decimals = decimals;
+    for (unsigned k = 0; k < seeds(h.transform); ++k) h.seed[k] = k == 0 ? x[0] : x[1] - x[0];
+    vector<uint64_t> words(VitalChunkStream::packedWords(best.size(), h.width), 0);
+    if (h.width > 0) {
+        for (size_t i = 0; i < best.size(); ++i) {
+            uint64_t v = best[i] - h.reference;
+            size_t pos = i * h.width, k = pos / 64, shift = pos % 64;
+            words[k] |= v << shift;
+            if (shift + h.width > 64) words[k + 1] |= v >> (64 - shift);
+        }
+    }
+    out.append((const char*)&h, sizeof h);
+    out.append((const char*)words.data(), words.size() * sizeof(uint64_t));
+}
+
+int VitalChunkCodec::decimalsFor(const double* v, size_t n) {
+    for (int d = 0; d < int(size(Scales)); ++d) {
+        bool exact = true;
+        for (size_t i = 0; exact && i < n; ++i) {
+            double scaled = v[i] * Scales[d];
+            if (!(fabs(scaled) < 1e15)) { exact = false; break; }
+            double back = double(llround(scaled)) / Scales[d];
+            exact = memcmp(&back, &v[i], sizeof back) == 0;
+        }
+        if (exact) return d;
+    }
+    return -1;
+}
+
+void VitalChunkCodec::appendValues(string& out, const double* v, size_t n, vector<uint64_t>& x) {
+    int d = decimalsFor(v, n);
+    x.resize(n);
+    if (d >= 0) {
+        for (size_t i = 0; i < n; ++i) x[i] = uint64_t(llround(v[i] * Scales[d]));
+        appendStream(out, x.data(), n, {VitalChunkStream::Plain, VitalChunkStream::Delta}, uint8_t(d));
+    } else {
+        memcpy(x.data(), v, n * sizeof(double));
+        appendStream(out, x.data(), n, {VitalChunkStream::Plain, VitalChunkStream::Xor}, 0xFF);
+    }
+}
+
+bool VitalChunkCodec::readStream(const char*& p, const char* end, size_t n, uint64_t* x, uint8_t& decimals) {
+    VitalChunkStream h;
+    if (size_t(end - p) < sizeof h) return false;
+    memcpy(&h, p, sizeof h);
+    p += sizeof h;
+    unsigned lead = seeds(h.transform);
+    if (h.transform > VitalChunkStream::Xor || h.width > 64 || n < lead) return false;
+    size_t m = n - lead, packed = VitalChunkStream::packedWords(m, h.width);
+    if (size_t(end - p) / sizeof(uint64_t) < packed) return false;
+    const char* words = p;
+    p += packed * sizeof(uint64_t);
+    decimals = h.decimals;
+
+    // Unpack: each residual straddles at most two words; the shifts are split so
+    // a zero offset needs no branch.
+    const uint64_t mask = h.width == 64 ? ~uint64_t(0) : (uint64_t(1) << h.width) - 1;
+    uint64_t* r = x + lead;
+    if (h.width == 0) fill(r, r + m, h.reference); // a constant run, nothing packed
+    else for (size_t i = 0; i < m; ++i) {
+        size_t pos = i * h.width, k = pos / 64;
+        unsigned shift = unsigned(pos % 64);
+        uint64_t lo, hi;
+        memcpy(&lo, words + k * 8, 8);
+        memcpy(&hi, words + k * 8 + 8, 8);
+        r[i] = (((lo >> shift) | ((hi << 1) << (63 - shift))) & mask) + h.reference;
+    }
+    for (unsigned k = 0; k < lead; ++k) x[k] = h.seed[k];
+    switch (h.transform) {
+        case VitalChunkStream::Delta:
+            for (size_t i = 1; i < n; ++i) x[i] += x[i - 1];
+            break;
+        case VitalChunkStream::DeltaOfDelta: // x[1..] become the deltas, then the values
+            for (size_t i = 2; i < n; ++i) x[i] += x[i - 1];
+            for (size_t i = 1; i < n; ++i) x[i] += x[i - 1];
+            break;
+        case VitalChunkStream::Xor:
+            for (size_t i = 1; i < n; ++i) x[i] ^= x[i - 1];
+            break;
+        default: break;
+    }
+    return true;
+}
+
+bool VitalChunkCodec::readValues(const char*& p, const char* end, VitalChunkColumns& c, vector<double>& out) {
+    size_t n = c.times.size();
+    uint8_t decimals;
+    c.scratch.resize(n);
+    if (!readStream(p, end, n, c.scratch.data(), decimals)) return false;
+    out.resize(n);
+    if (decimals == 0xFF) {
+        memcpy(out.data(), c.scratch.data(), n * sizeof(double));
+    } else {
+        if (decimals >= size(Scales)) return false;
+        const double scale = Scales[decimals];
+        for (size_t i = 0; i < n; ++i) out[i] = double(int64_t(c.scratch[i])) / scale;
+    }
+    return true;
+}
+
+string VitalChunkCodec::encode(const time_t* times, const double* v1, const double* v2, size_t n) {
+    VitalChunkHeader h{{'M', 'V', 'C', '1'}, VitalChunkByteOrder, uint32_t(n), v2 ? 3u : 2u};
+    string out((const char*)&h, sizeof h);
+    vector<uint64_t> x(times, times + n);
+    appendStream(out, x.data(), n, {VitalChunkStream::Plain, VitalChunkStream::Delta, VitalChunkStream::DeltaOfDelta}, 0);
+    appendValues(out, v1, n, x);
+    if (v2) appendValues(out, v2, n, x);
+    return out;
+}
+
+bool VitalChunkCodec::decode(const void* data, size_t bytes, VitalChunkColumns& c) {
+    VitalChunkHeader h;
+    if (!data || bytes < sizeof h) return false;
+    memcpy(&h, data, sizeof h);
+    if (memcmp(h.magic, "MVC1", 4) != 0 || h.byteOrder != VitalChunkByteOrder || h.streams < 2 || h.streams > 3) return false;
+    const char* p = (const char*)data + sizeof h;
+    const char* end = (const char*)data + bytes;
+    uint8_t unused;
+    c.times.resize(h.count);
+    if (!readStream(p, end, h.count, (uint64_t*)c.times.data(), unused)) return false;
+    if (!readValues(p, end, c, c.values1)) return false;
+    if (h.streams == 3) return readValues(p, end, c, c.values2);
+    c.values2.clear();
+    return true;
+}
+
+// ------------------- DatabaseManager -------------------
+CachedStatement DatabaseManager::prepare(const char* sql) {
+    auto it = statements.find(sql);
+    if (it != statements.end()) return CachedStatement(it->second.get());
+    sqlite3_stmt* stmt = nullptr;
+    int rc;
+    {
+        ScopedTimer timer(DbMetrics::global().enabled() ? &DbMetrics::global().prepares : nullptr);
+        rc = sqlite3_prepare_v3(DB, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, 0);
+    }
+    if (rc != SQLITE_OK) {
+        cerr << "SQL prepare error: " << sqlite3_errmsg(DB) << endl;
+        sqlite3_finalize(stmt);
+        return CachedStatement(nullptr);
+    }
+    statements.emplace(sqlite3_sql(stmt), StatementHandle(stmt));
+    return CachedStatement(stmt);
+}
+
+int DatabaseManager::step(sqlite3_stmt* stmt) {
+    DbMetrics& metrics = DbMetrics::global();
+    int rc;
+    if (metrics.enabled()) {
+        ScopedTimer timer(&metrics.steps);
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) timer.addRows(1);
+    } else {
+        rc = sqlite3_step(stmt);
+    }
+    if (rc == SQLITE_ROW) ++rowsTouched;
+    else if (rc != SQLITE_DONE) metrics.recordError(rc, sqlite3_errmsg(DB), sqlite3_sql(stmt));
+    return rc;
+}
+
+bool DatabaseManager::begin(const char* sql) {
+    if (sqlite3_exec(DB, sql, 0, 0, 0) != SQLITE_OK) return false;
+    timingTransaction = DbMetrics::global().enabled();
+    if (timingTransaction) transactionStart = chrono::steady_clock::now();
+    return true;
+}
+
+bool DatabaseManager::commit() {
+    if (sqlite3_exec(DB, "COMMIT;", 0, 0, 0) != SQLITE_OK) return false;
+    endTransaction();
+    return true;
+}
+
+void DatabaseManager::rollback() {
+    sqlite3_exec(DB, "ROLLBACK;", 0, 0, 0);
+    pendingRollups.clear();
+    DbMetrics::global().rollbacks.fetch_add(1, memory_order_relaxed);
+    endTransaction();
+}
+
+void DatabaseManager::endTransaction() {
+    if (!timingTransaction) return;
+    timingTransaction = false;
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - transactionStart).count();
+    DbMetrics::global().transactions.record(uint64_t(ns), 0);
+}
+
+int DatabaseManager::onBusy(void* self, int attempt) {
+    static const int delays[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100};
+    static const int totals[] = {0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178, 228};
+    const int last = int(size(delays)) - 1;
+    int timeout = static_cast<DatabaseManager*>(self)->profile.busyTimeoutMs;
+    int delay = delays[min(attempt, last)];
+    int prior = attempt <= last ? totals[attempt] : totals[last] + delay * (attempt - last);
+    if (prior + delay > timeout) delay = timeout - prior;
+    if (delay <= 0) return 0;
+    DbMetrics::global().busyRetries.fetch_add(1, memory_order_relaxed);
+    this_thread::sleep_for(chrono::milliseconds(delay));
+    return 1;
+}
+
+string DatabaseManager::columnText(sqlite3_stmt* stmt, int col) {
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    return text ? string((const char*)text) : string();
+}
+
+string_view DatabaseManager::columnView(sqlite3_stmt* stmt, int col) {
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    return text ? string_view((const char*)text, sqlite3_column_bytes(stmt, col)) : string_view();
+}
+
+void DatabaseManager::bindView(sqlite3_stmt* stmt, int index, string_view text) {
+    sqlite3_bind_text(stmt, index, text.data() ? text.data() : "", (int)text.size(), SQLITE_STATIC);
+}
+
+void DatabaseManager::addRecordRow(Patient& patient, sqlite3_stmt* stmt) {
+    VitalKind kind;
+    if (!readVitalType(stmt, 2, kind)) return;
+    patient.addVital(kind, sqlite3_column_int64(stmt, 5), sqlite3_column_double(stmt, 3),
+                     sqlite3_column_double(stmt, 4), sqlite3_column_int64(stmt, 1));
+}
+
+VitalChunkColumns& DatabaseManager::chunkScratch() {
+    thread_local VitalChunkColumns columns;
+    return columns;
+}
+
+void DatabaseManager::addChunkRow(Patient& patient, sqlite3_stmt* stmt) {
+    decodeChunkRow(stmt, [&](VitalKind kind, time_t ts, double v1, double v2, long long id) { patient.addVital(kind, ts, v1, v2, id); });
+}
 
-using namespace std;
+void DatabaseManager::storeChunkRow(Patient& patient, sqlite3_stmt* stmt) {
+    decodeChunkRow(stmt, [&](VitalKind kind, time_t ts, double v1, double v2, long long id) { patient.getVitals().add(kind, ts, v1, v2, id); });
+}
+
+void DatabaseManager::addMedicationRow(Patient& patient, sqlite3_stmt* stmt) {
+    Medication med(columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4));
+    med.markSaved(sqlite3_column_int64(stmt, 1));
+    patient.addMedication(med);
+}
+
+void DatabaseManager::addReminderRow(Patient& patient, sqlite3_stmt* stmt) {
+    Reminder rem(columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4), parseFrequency(columnView(stmt, 5)));
+    rem.markSaved(sqlite3_column_int64(stmt, 1));
+    patient.addReminder(rem);
+}
+
+void DatabaseManager::storeRecordRow(Patient& patient, sqlite3_stmt* stmt) {
+    VitalKind kind;
+    if (!readVitalType(stmt, 2, kind)) return;
+    patient.getVitals().add(kind, sqlite3_column_int64(stmt, 5), sqlite3_column_double(stmt, 3),
+                            sqlite3_column_double(stmt, 4), sqlite3_column_int64(stmt, 1));
+}
+
+void DatabaseManager::storeMedicationRow(Patient& patient, sqlite3_stmt* stmt) {
+    patient.getMedications().emplace_back(columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4))
+           .markSaved(sqlite3_column_int64(stmt, 1));
+}
+
+void DatabaseManager::storeReminderRow(Patient& patient, sqlite3_stmt* stmt) {
+    Reminder rem(columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4), parseFrequency(columnView(stmt, 5)));
+    rem.markSaved(sqlite3_column_int64(stmt, 1));
+    patient.getReminders().push_back(rem);
+}
+
+bool DatabaseManager::stepWrite(sqlite3_stmt* stmt, long long& rowId) {
+    bool inserting = (rowId == 0);
+    if (step(stmt) != SQLITE_DONE) return false;
+    ++rowsTouched;
+    if (inserting) rowId = sqlite3_last_insert_rowid(DB);
+    return true;
+}
+
+void DatabaseManager::bindChange(sqlite3_stmt* stmt, bool inserted, long long rowId, long long patient_id) {
+    sqlite3_bind_text(stmt, 1, inserted ? "insert" : "update", -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, rowId);
+    sqlite3_bind_int64(stmt, 3, patient_id);
+}
+
+bool DatabaseManager::savePatientRow(string_view name, int age, string_view contact, long long& rowId) {
+    bool inserting = rowId == 0;
+    const char* sql = inserting
+        ? "INSERT INTO patients (name, age, contact) VALUES (?, ?, ?);"
+        : "UPDATE patients SET name = ?, age = ?, contact = ? WHERE id = ?;";
+    CachedStatement stmt = prepare(sql);
+    if (!stmt) return false;
+    bindView(stmt, 1, name);
+    sqlite3_bind_int(stmt, 2, age);
+    bindView(stmt, 3, contact);
+    if (!inserting) sqlite3_bind_int64(stmt, 4, rowId);
+    if (!stepWrite(stmt, rowId)) return false;
+    CachedStatement change = prepare(
+        "INSERT INTO change_log (entity, op, row_id, patient_id, data) "
+        "VALUES ('patient', ?, ?, ?, json_object('name', ?, 'age', ?, 'contact', ?));");
+    if (!change) return false;
+    bindChange(change, inserting, rowId, rowId);
+    bindView(change, 4, name);
+    sqlite3_bind_int(change, 5, age);
+    bindView(change, 6, contact);
+    return step(change) == SQLITE_DONE;
+}
+
+bool DatabaseManager::savePatientRow(const Patient& patient, long long& rowId) {
+    return savePatientRow(patient.getName(), patient.getAge(), patient.getContact(), rowId);
+}
+
+bool DatabaseManager::readVitalType(sqlite3_stmt* stmt, int column, VitalKind& kind) {
+    return vitalKindFromStorageId(sqlite3_column_int64(stmt, column), kind);
+}
+
+bool DatabaseManager::bumpGeneration() {
+    CachedStatement stmt = prepare("UPDATE meta SET value = value + 1 WHERE key = 'generation';");
+    return stmt && step(stmt) == SQLITE_DONE;
+}
+
+bool DatabaseManager::insertVital(long long patient_id, VitalKind kind, time_t timestamp, double value1, double value2, long long& rowId) {
+    CachedStatement stmt = prepare("INSERT INTO health_records (patient_id, type, value1, value2, timestamp) VALUES (?, ?, ?, ?, ?);");
+    if (!stmt) return false;
+    sqlite3_bind_int64(stmt, 1, patient_id);
+    sqlite3_bind_int(stmt, 2, vitalTypeId(kind));
+    sqlite3_bind_double(stmt, 3, value1);
+    if (vitalHasSecondValue(kind)) sqlite3_bind_double(stmt, 4, value2);
+    sqlite3_bind_int64(stmt, 5, timestamp);
+    if (!stepWrite(stmt, rowId)) return false;
+    CachedStatement change = prepare(vitalHasSecondValue(kind)
+        ? "INSERT INTO change_log (entity, op, row_id, patient_id, data) "
+          "VALUES ('record', ?, ?, ?, json_object('type', ?, 'timestamp', ?, 'value', ?, 'value2', ?));"
+        : "INSERT INTO change_log (entity, op, row_id, patient_id, data) "
+          "VALUES ('record', ?, ?, ?, json_object('type', ?, 'timestamp', ?, 'value', ?));");
+    if (!change) return false;
+    bindChange(change, true, rowId, patient_id);
+    sqlite3_bind_text(change, 4, vitalInfo(kind).tag, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(change, 5, timestamp);
+    sqlite3_bind_double(change, 6, value1);
+    if (vitalHasSecondValue(kind)) sqlite3_bind_double(change, 7, value2);
+    if (step(change) != SQLITE_DONE) return false;
+    double second = vitalHasSecondValue(kind) ? value2 : 0.0;
+    for (auto [period, start] : {pair(RollupPeriod::Day, LocalCalendar::dayStart(timestamp)),
+                                 pair(RollupPeriod::Week, LocalCalendar::weekStart(timestamp))}) {
+        RollupBucket& b = pendingRollups[{patient_id, kind, period, start}];
+        b.start = start;
+        b.add(value1, second);
+    }
+    return true;
+}
+
+void DatabaseManager::bindRollup(sqlite3_stmt* stmt, long long patient_id, VitalKind kind, RollupPeriod period, const RollupBucket& b) {
+    sqlite3_bind_int64(stmt, 1, patient_id);
+    sqlite3_bind_int(stmt, 2, vitalTypeId(kind));
+    sqlite3_bind_text(stmt, 3, rollupPeriodTag(period), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, b.start);
+    sqlite3_bind_int64(stmt, 5, b.count);
+    sqlite3_bind_double(stmt, 6, b.min1);
+    sqlite3_bind_double(stmt, 7, b.max1);
+    sqlite3_bind_double(stmt, 8, b.sum1);
+    if (vitalHasSecondValue(kind)) {
+        sqlite3_bind_double(stmt, 9, b.min2);
+        sqlite3_bind_double(stmt, 10, b.max2);
+        sqlite3_bind_double(stmt, 11, b.sum2);
+    }
+}
+
+bool DatabaseManager::flushRollups() {
+    bool ok = true;
+    for (const auto& [key, bucket] : pendingRollups) {
+        CachedStatement stmt = prepare(UpsertRollupSql);
+        if (!stmt) { ok = false; break; }
+        bindRollup(stmt, get<0>(key), get<1>(key), get<2>(key), bucket);
+        if (!(ok = step(stmt) == SQLITE_DONE)) break;
+        ++rowsTouched;
+    }
+    pendingRollups.clear();
+    return ok;
+}
+
+bool DatabaseManager::insertVitalRow(VitalKind kind, const VitalSeries& s, size_t i, long long patient_id, long long& rowId) {
+    return insertVital(patient_id, kind, s.times()[i], s.values1()[i], s.secondAt(i), rowId);
+}
+
+bool DatabaseManager::saveMedicationRow(const Medication& med, long long patient_id, long long& rowId) {
+    bool inserting = rowId == 0;
+    const char* sql = inserting
+        ? "INSERT INTO medications (patient_id, name, dosage, schedule) VALUES (?, ?, ?, ?);"
+        : "UPDATE medications SET patient_id = ?, name = ?, dosage = ?, schedule = ? WHERE id = ?;";
+    CachedStatement stmt = prepare(sql);
+    if (!stmt) return false;
+    sqlite3_bind_int64(stmt, 1, patient_id);
+    bindView(stmt, 2, med.getName());
+    bindView(stmt, 3, med.getDosage());
+    bindView(stmt, 4, med.getSchedule());
+    if (!inserting) sqlite3_bind_int64(stmt, 5, rowId);
+    if (!stepWrite(stmt, rowId)) return false;
+    CachedStatement change = prepare(
+        "INSERT INTO change_log (entity, op, row_id, patient_id, data) "
+        "VALUES ('medication', ?, ?, ?, json_object('name', ?, 'dosage', ?, 'schedule', ?));");
+    if (!change) return false;
+    bindChange(change, inserting, rowId, patient_id);
+    bindView(change, 4, med.getName());
+    bindView(change, 5, med.getDosage());
+    bindView(change, 6, med.getSchedule());
+    return step(change) == SQLITE_DONE;
+}
+
+bool DatabaseManager::saveReminderRow(const Reminder& rem, long long patient_id, long long& rowId) {
+    bool inserting = rowId == 0;
+    const char* sql = inserting
+        ? "INSERT INTO reminders (patient_id, message, date, time, frequency) VALUES (?, ?, ?, ?, ?);"
+        : "UPDATE reminders SET patient_id = ?, message = ?, date = ?, time = ?, frequency = ? WHERE id = ?;";
+    CachedStatement stmt = prepare(sql);
+    if (!stmt) return false;
+    ReminderText dateText = rem.getDate(), timeText = rem.getTime(); // bound in place, so kept until the step
+    sqlite3_bind_int64(stmt, 1, patient_id);
+    bindView(stmt, 2, rem.getMessage());
+    bindView(stmt, 3, dateText);
+    bindView(stmt, 4, timeText);
+    sqlite3_bind_text(stmt, 5, frequencyTag(rem.getFrequency()), -1, SQLITE_STATIC);
+    if (!inserting) sqlite3_bind_int64(stmt, 6, rowId);
+    if (!stepWrite(stmt, rowId)) return false;
+    CachedStatement change = prepare(
+        "INSERT INTO change_log (entity, op, row_id, patient_id, data) VALUES ('reminder', ?, ?, ?, "
+        "json_object('message', ?, 'date', ?, 'time', ?, 'frequency', ?));");
+    if (!change) return false;
+    bindChange(change, inserting, rowId, patient_id);
+    bindView(change, 4, rem.getMessage());
+    bindView(change, 5, dateText);
+    bindView(change, 6, timeText);
+    sqlite3_bind_text(change, 7, frequencyTag(rem.getFrequency()), -1, SQLITE_STATIC);
+    return step(change) == SQLITE_DONE;
+}
 
-// --- Constructor / Destructor ---
-DatabaseManager::DatabaseManager(const string& filename) : db_file(filename), DB(nullptr) {}
 DatabaseManager::~DatabaseManager() {
+    {
+        ScopedTimer timer(DbMetrics::global().enabled() ? &DbMetrics::global().finalizes : nullptr);
+        timer.addRows(statements.size());
+        statements.clear(); // statements must be finalized before the connection closes
+    }
     if (DB) {
         sqlite3_close(DB);
     }
 }
 
-// --- Connection and Table Creation ---
-bool DatabaseManager::open() {
-    if (sqlite3_open(db_file.c_str(), &DB) != SQLITE_OK) {
+bool DatabaseManager::open(const ConnectionProfile& chosen) {
+    OperationScope scope(*this, DbOperation::Open);
+    profile = chosen;
+    if (sqlite3_open_v2(db_file.c_str(), &DB, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
         cerr << "Error opening database: " << sqlite3_errmsg(DB) << endl;
         return false;
     }
+    if (!applyProfile(profile)) {
+        cerr << "Error configuring database: " << sqlite3_errmsg(DB) << endl;
+        return false;
+    }
     cout << "Database opened successfully.\n";
     return true;
 }
 
-void DatabaseManager::createTables() {
+bool DatabaseManager::openReadOnly(const ConnectionProfile& chosen) {
+    profile = chosen;
+    if (sqlite3_open_v2(db_file.c_str(), &DB, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) return false;
+    return applyProfile(profile, true);
+}
+
+bool DatabaseManager::openWriter(const ConnectionProfile& chosen) {
+    profile = chosen;
+    if (sqlite3_open_v2(db_file.c_str(), &DB, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) return false;
+    return applyProfile(profile, true) && sqlite3_exec(DB, "PRAGMA foreign_keys = ON;", 0, 0, 0) == SQLITE_OK;
+}
+
+bool DatabaseManager::applyProfile(const ConnectionProfile& profile, bool secondary) {
+    sqlite3_busy_handler(DB, onBusy, this);
+    string pragmas =
+        "PRAGMA synchronous = " + string(profile.synchronous) + ";"
+        "PRAGMA cache_size = -" + to_string(profile.cacheSizeKiB) + ";"
+        "PRAGMA mmap_size = " + to_string(profile.mmapSizeBytes) + ";"
+        "PRAGMA temp_store = " + (profile.tempStoreMemory ? "MEMORY" : "DEFAULT") + ";";
+    if (sqlite3_exec(DB, pragmas.c_str(), 0, 0, 0) != SQLITE_OK) return false;
+    if (secondary) return true;
+
+    // journal_mode reports the mode actually in effect (WAL is refused on some filesystems).
+    string request = "PRAGMA journal_mode = " + string(profile.journalMode) + ";";
+    CachedStatement stmt = prepare(request.c_str());
+    if (!stmt || step(stmt) != SQLITE_ROW) return false;
+    string mode = columnText(stmt, 0), wanted = profile.journalMode;
+    transform(wanted.begin(), wanted.end(), wanted.begin(), [](unsigned char c) { return char(tolower(c)); });
+    if (mode != wanted) {
+        cerr << "Warning: journal_mode " << profile.journalMode << " unavailable, using " << mode << endl;
+    }
+    return true;
+}
+
+int DatabaseManager::schemaVersion() {
+    CachedStatement stmt = prepare("PRAGMA user_version;");
+    return stmt && step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+}
+
+bool DatabaseManager::createTables() {
+    OperationScope scope(*this, DbOperation::CreateTables);
+    if (schemaVersion() == SchemaVersion) {
+        sqlite3_exec(DB, "PRAGMA foreign_keys = ON;", 0, 0, 0);
+        cout << "Schema is current.\n";
+        return true;
+    }
     char* errMsg = 0;
-    const char* sql_statements = 
+    const char* schema =
         "CREATE TABLE IF NOT EXISTS patients ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
         "name TEXT NOT NULL, age INTEGER, contact TEXT);"
 
         "CREATE TABLE IF NOT EXISTS health_records ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER, type TEXT, "
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER, type INTEGER, "
         "value1 REAL, value2 REAL, timestamp INTEGER, "
         "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);"
         
@@ -44,142 +564,699 @@ void DatabaseManager::createTables() {
 
         "CREATE TABLE IF NOT EXISTS reminders ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER, message TEXT, "
-        "date TEXT, time TEXT, "
-        "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);";
+        "date TEXT, time TEXT, frequency TEXT DEFAULT 'once', "
+        "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);"
+
+        // Covering indexes: the loader's ordered scans are answered from the index alone.
+        "CREATE INDEX IF NOT EXISTS idx_health_records_patient_ts "
+        "ON health_records(patient_id, timestamp, type, value1, value2);"
+        "CREATE INDEX IF NOT EXISTS idx_health_records_patient_type_ts "
+        "ON health_records(patient_id, type, timestamp, value1, value2);"
+        "CREATE INDEX IF NOT EXISTS idx_medications_patient "
+        "ON medications(patient_id, name, dosage, schedule);"
+        "CREATE INDEX IF NOT EXISTS idx_reminders_patient_date "
+        "ON reminders(patient_id, date, time, message, frequency);"
+        // Name (case-insensitive, so LIKE 'prefix%' can use it) and contact lookups in SQL,
+        // matching the in-memory PatientIndex.
+        "CREATE INDEX IF NOT EXISTS idx_patients_name ON patients(name COLLATE NOCASE);"
+        "CREATE INDEX IF NOT EXISTS idx_patients_contact ON patients(contact);"
+
+        // The type column of the three vitals tables is the kind's storage id (VitalTraits).
+        // Daily and weekly aggregates per patient and vital kind, maintained with every
+        // reading inserted (see flushRollups) and rebuildable from health_records.
+        "CREATE TABLE IF NOT EXISTS health_rollups ("
+        "patient_id INTEGER NOT NULL, type INTEGER NOT NULL, period TEXT NOT NULL, bucket_start INTEGER NOT NULL, "
+        "readings INTEGER NOT NULL, value1_min REAL, value1_max REAL, value1_sum REAL, "
+        "value2_min REAL, value2_max REAL, value2_sum REAL, "
+        "PRIMARY KEY (patient_id, type, period, bucket_start), "
+        "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE) WITHOUT ROWID;"
+
+        // Sealed readings, compressed (see VitalChunkCodec and compactVitals). A reading
+        // is either here or in health_records, never both.
+        "CREATE TABLE IF NOT EXISTS health_chunks ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER NOT NULL, type INTEGER NOT NULL, "
+        "first_ts INTEGER NOT NULL, last_ts INTEGER NOT NULL, readings INTEGER NOT NULL, data BLOB NOT NULL, "
+        "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);"
+        "CREATE INDEX IF NOT EXISTS idx_health_chunks_patient_type_ts "
+        "ON health_chunks(patient_id, type, last_ts, first_ts);"
 
-    if (sqlite3_exec(DB, sql_statements, 0, 0, &errMsg) != SQLITE_OK) {
+        // Change data capture: every insert or update of a patient, reading, medication or
+        // reminder appends a row here in the same transaction (see bindChange), with the
+        // new values as JSON in data. Rows are never deleted by the app, and sealing readings
+        // into chunks is not a change. seq is AUTOINCREMENT so it is never reused, even
+        // after pruneChanges; a consumer copies the database once, then follows seq from the
+        // highest one in its copy (see forEachChange).
+        "CREATE TABLE IF NOT EXISTS change_log ("
+        "seq INTEGER PRIMARY KEY AUTOINCREMENT, entity TEXT NOT NULL, op TEXT NOT NULL, "
+        "row_id INTEGER NOT NULL, patient_id INTEGER NOT NULL, data TEXT NOT NULL);"
+
+        // generation counts committed writes, so derived copies (the snapshot) can tell they are stale.
+        "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value INTEGER) WITHOUT ROWID;"
+        "INSERT OR IGNORE INTO meta (key, value) VALUES ('generation', 0);";
+
+    // Databases created before reminders could recur lack the frequency column.
+    // This runs first so the index below can include it.
+    // Databases from before rollups get theirs computed from the existing readings, as
+    // do those where that rebuild failed and left the table empty.
+    bool rollupsMissing = tableExists("health_records") && (!tableExists("health_rollups") || !tableHasRows("health_rollups"));
+    if (tableExists("reminders") && !columnExists("reminders", "frequency") &&
+        sqlite3_exec(DB, "BEGIN IMMEDIATE;"
+                         "ALTER TABLE reminders ADD COLUMN frequency TEXT DEFAULT 'once';"
+                         "DROP INDEX IF EXISTS idx_reminders_patient_date;"
+                         "COMMIT;", 0, 0, &errMsg) != SQLITE_OK) {
+        cerr << "Could not add the reminder frequency column: " << errMsg << endl;
+        sqlite3_free(errMsg);
+        sqlite3_exec(DB, "ROLLBACK;", 0, 0, 0);
+        return false;
+    }
+    // Databases from before storage ids tag their vitals with text. Foreign keys are
+    // still off here, which the table rebuild needs.
+    if (tableExists("health_records") && columnType("health_records", "type") == "TEXT" && !migrateVitalTypes(schema))
+        return false;
+    sqlite3_exec(DB, "PRAGMA foreign_keys = ON;", 0, 0, 0);
+    if (sqlite3_exec(DB, schema, 0, 0, &errMsg) != SQLITE_OK) {
         cerr << "SQL error: " << errMsg << endl;
         sqlite3_free(errMsg);
-    } else {
-        cout << "Tables created or already exist.\n";
-    }
-}
-
-// --- Saving and Loading ---
-void DatabaseManager::saveAllPatients(const vector<unique_ptr<Patient>>& patients) {
-    // Clear existing data to prevent duplicates
-    sqlite3_exec(DB, "DELETE FROM patients;", 0, 0, 0);
-    sqlite3_exec(DB, "DELETE FROM health_records;", 0, 0, 0);
-    sqlite3_exec(DB, "DELETE FROM medications;", 0, 0, 0);
-    sqlite3_exec(DB, "DELETE FROM reminders;", 0, 0, 0);
-
-    sqlite3_stmt *stmt_p, *stmt_r, *stmt_m, *stmt_rem;
-    const char* sql_p = "INSERT INTO patients (name, age, contact) VALUES (?, ?, ?);";
-    const char* sql_r = "INSERT INTO health_records (patient_id, type, value1, value2, timestamp) VALUES (?, ?, ?, ?, ?);";
-    const char* sql_m = "INSERT INTO medications (patient_id, name, dosage, schedule) VALUES (?, ?, ?, ?);";
-    const char* sql_rem = "INSERT INTO reminders (patient_id, message, date, time) VALUES (?, ?, ?, ?);";
-
-    for (const auto& patient : patients) {
-        // Save Patient
-        sqlite3_prepare_v2(DB, sql_p, -1, &stmt_p, 0);
-        sqlite3_bind_text(stmt_p, 1, patient->getName().c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt_p, 2, patient->getAge());
-        sqlite3_bind_text(stmt_p, 3, patient->getContact().c_str(), -1, SQLITE_STATIC);
-        sqlite3_step(stmt_p);
-        sqlite3_finalize(stmt_p);
-        
-        long long patient_id = sqlite3_last_insert_rowid(DB);
-
-        // Save Health Records
-        for (const auto& rec : patient->getRecords()) {
-            sqlite3_prepare_v2(DB, sql_r, -1, &stmt_r, 0);
-            sqlite3_bind_int(stmt_r, 1, patient_id);
-            sqlite3_bind_int64(stmt_r, 5, rec->getTimestamp());
-            if (auto r = dynamic_cast<BloodPressureRecord*>(rec.get())) {
-                sqlite3_bind_text(stmt_r, 2, "BP", -1, SQLITE_STATIC);
-                sqlite3_bind_double(stmt_r, 3, r->getSystolic());
-                sqlite3_bind_double(stmt_r, 4, r->getDiastolic());
-            } else if (auto r = dynamic_cast<WeightRecord*>(rec.get())) {
-                sqlite3_bind_text(stmt_r, 2, "Weight", -1, SQLITE_STATIC);
-                sqlite3_bind_double(stmt_r, 3, r->getWeight());
-            } else if (auto r = dynamic_cast<BloodSugarRecord*>(rec.get())) {
-                sqlite3_bind_text(stmt_r, 2, "Sugar", -1, SQLITE_STATIC);
-                sqlite3_bind_double(stmt_r, 3, r->getSugar());
+        return false;
+    }
+    cout << "Tables created or already exist.\n";
+    if (rollupsMissing && !rebuildRollups()) return false;
+    // Stamped last: a database left part way stays at its old version and goes
+    // through the steps that failed again on the next start.
+    string stamp = "PRAGMA user_version = " + to_string(SchemaVersion) + ";";
+    if (sqlite3_exec(DB, stamp.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
+        cerr << "Could not record the schema version: " << errMsg << endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::tableHasRows(const char* table) {
+    string sql = string("SELECT 1 FROM ") + table + " LIMIT 1;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(DB, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+    bool rows = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+bool DatabaseManager::tableExists(const char* table) {
+    CachedStatement stmt = prepare("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?;");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    return step(stmt) == SQLITE_ROW;
+}
+
+bool DatabaseManager::columnExists(const char* table, const char* column) {
+    CachedStatement stmt = prepare("SELECT 1 FROM pragma_table_info(?) WHERE name = ?;");
+    if (!stmt) return false;
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    return step(stmt) == SQLITE_ROW;
+}
+
+string DatabaseManager::columnType(const char* table, const char* column) {
+    CachedStatement stmt = prepare("SELECT upper(type) FROM pragma_table_info(?) WHERE name = ?;");
+    if (!stmt) return string();
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    return step(stmt) == SQLITE_ROW ? columnText(stmt, 0) : string();
+}
+
+bool DatabaseManager::migrateVitalTypes(const char* schema) {
+    string tagToId = "CASE type";
+    for (const VitalKindInfo& info : vitalKindInfos) {
+        tagToId += " WHEN '" + string(info.tag) + "' THEN " + to_string(info.storageId);
+    }
+    tagToId += " ELSE 0 END";
+    struct Table { const char* name; const char* columns; };
+    const Table tables[] = {
+        {"health_records", "id, patient_id, ?, value1, value2, timestamp"},
+        {"health_rollups", "patient_id, ?, period, bucket_start, readings, value1_min, value1_max, value1_sum, "
+                           "value2_min, value2_max, value2_sum"},
+        {"health_chunks", "id, patient_id, ?, first_ts, last_ts, readings, data"},
+    };
+    string sql = "BEGIN IMMEDIATE;"
+                 "DROP INDEX IF EXISTS idx_health_records_patient_ts;"
+                 "DROP INDEX IF EXISTS idx_health_records_patient_type_ts;"
+                 "DROP INDEX IF EXISTS idx_health_chunks_patient_type_ts;";
+    vector<const Table*> present;
+    for (const Table& t : tables) {
+        if (!tableExists(t.name)) continue;
+        present.push_back(&t);
+        sql += "ALTER TABLE " + string(t.name) + " RENAME TO " + t.name + "_text;";
+    }
+    sql += schema;
+    for (const Table* t : present) {
+        string name = t->name, columns = t->columns, select = columns;
+        size_t at = columns.find('?');
+        columns.replace(at, 1, "type");
+        select.replace(at, 1, tagToId);
+        sql += "INSERT INTO " + name + " (" + columns + ") SELECT " + select + " FROM " + name + "_text;";
+        sql += "UPDATE sqlite_sequence SET seq = max(seq, coalesce((SELECT seq FROM sqlite_sequence WHERE name = '" +
+               name + "_text'), 0)) WHERE name = '" + name + "';";
+        sql += "DROP TABLE " + name + "_text;";
+    }
+    sql += "COMMIT;";
+    char* errMsg = 0;
+    if (sqlite3_exec(DB, sql.c_str(), 0, 0, &errMsg) != SQLITE_OK) {
+        cerr << "Could not convert vitals type tags: " << errMsg << endl;
+        sqlite3_free(errMsg);
+        sqlite3_exec(DB, "ROLLBACK;", 0, 0, 0);
+        return false;
+    }
+    cout << "Converted vitals type tags to storage ids.\n";
+    return true;
+}
+
+bool DatabaseManager::saveAllPatients(vector<unique_ptr<Patient>>& patients) {
+    OperationScope scope(*this, DbOperation::SaveAllPatients);
+    if (!begin()) {
+        cerr << "Could not start save transaction: " << sqlite3_errmsg(DB) << endl;
+        return false;
+    }
+
+    struct SavedVital { VitalSeries* series; size_t index; long long rowId; };
+    vector<pair<Persistent*, long long>> saved;
+    vector<SavedVital> savedVitals;
+    vector<Patient*> touched;
+    bool ok = true;
+    for (auto& patient : patients) {
+        if (!patient->hasUnsavedChanges()) continue;
+        touched.push_back(patient.get());
+
+        long long patient_id = patient->getRowId();
+        if (patient->isNew() || patient->isDirty()) {
+            ok = savePatientRow(*patient, patient_id);
+            if (!ok) break;
+            saved.push_back({patient.get(), patient_id});
+        }
+
+        for (VitalKind kind : allVitalKinds) {
+            VitalSeries& s = patient->getVitals().series(kind);
+            for (size_t i = 0; ok && s.unsavedCount() > 0 && i < s.size(); ++i) {
+                if (s.rowIdAt(i) != 0) continue;
+                long long id = 0;
+                if ((ok = insertVitalRow(kind, s, i, patient_id, id))) savedVitals.push_back({&s, i, id});
             }
-            sqlite3_step(stmt_r);
-            sqlite3_finalize(stmt_r);
         }
+        if (!ok) break;
+        for (auto& med : patient->getMedications()) {
+            if (!med.isNew() && !med.isDirty()) continue;
+            long long id = med.getRowId();
+            if (!(ok = saveMedicationRow(med, patient_id, id))) break;
+            saved.push_back({&med, id});
+        }
+        if (!ok) break;
+        for (auto& rem : patient->getReminders()) {
+            if (!rem.isNew() && !rem.isDirty()) continue;
+            long long id = rem.getRowId();
+            if (!(ok = saveReminderRow(rem, patient_id, id))) break;
+            saved.push_back({&rem, id});
+        }
+        if (!ok) break;
+    }
 
-        // Save Medications
-        for (const auto& med : patient->getMedications()) {
-            sqlite3_prepare_v2(DB, sql_m, -1, &stmt_m, 0);
-            sqlite3_bind_int(stmt_m, 1, patient_id);
-            sqlite3_bind_text(stmt_m, 2, med.getName().c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt_m, 3, med.getDosage().c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt_m, 4, med.getSchedule().c_str(), -1, SQLITE_STATIC);
-            sqlite3_step(stmt_m);
-            sqlite3_finalize(stmt_m);
+    if (ok && !(saved.empty() && savedVitals.empty())) ok = flushRollups() && bumpGeneration();
+    if (!ok || !commit()) {
+        cerr << "Save failed, rolling back: " << sqlite3_errmsg(DB) << endl;
+        rollback();
+        return false;
+    }
+
+    for (auto& entry : saved) entry.first->markSaved(entry.second);
+    for (auto& entry : savedVitals) entry.series->markSaved(entry.index, entry.rowId);
+    for (Patient* p : touched) p->markHistorySaved();
+    cout << "Saved " << saved.size() + savedVitals.size() << " changed rows to database.\n";
+    return true;
+}
+
+bool DatabaseManager::applyWrites(vector<PendingWrite>& batch, unordered_map<const Patient*, long long>& patientIds) {
+    OperationScope scope(*this, DbOperation::ApplyWrites);
+    if (!begin()) {
+        cerr << "\nCould not start background save: " << sqlite3_errmsg(DB) << endl;
+        return false;
+    }
+    vector<const Patient*> inserted;
+    bool ok = true;
+    for (PendingWrite& w : batch) {
+        long long patient_id = w.patientId, id = 0;
+        if (w.kind == PendingWrite::Kind::Patient) {
+            patientIds.erase(w.patient);
+            inserted.push_back(w.patient);
+            ok = savePatientRow(w.name, w.age, w.contact, id);
+            if (ok) patientIds[w.patient] = id;
+        } else {
+            if (patient_id == 0) {
+                auto it = patientIds.find(w.patient);
+                if (it == patientIds.end()) continue;
+                patient_id = it->second;
+            }
+            switch (w.kind) {
+                case PendingWrite::Kind::Vital:
+                    ok = insertVital(patient_id, w.vitalKind, w.timestamp, w.value1, w.value2, id);
+                    break;
+                case PendingWrite::Kind::Medication: ok = saveMedicationRow(*w.medication, patient_id, id); break;
+                default: ok = saveReminderRow(*w.reminder, patient_id, id); break;
+            }
         }
+        if (!ok) break;
+        w.rowId = id;
+    }
+    if (ok) ok = flushRollups() && bumpGeneration();
+    if (!ok || !commit()) {
+        cerr << "\nBackground save failed, rolling back: " << sqlite3_errmsg(DB) << endl;
+        rollback();
+        for (PendingWrite& w : batch) w.rowId = 0;
+        for (const Patient* p : inserted) patientIds.erase(p);
+        return false;
+    }
+    return true;
+}
 
-        // Save Reminders
-        for (const auto& rem : patient->getReminders()) {
-            sqlite3_prepare_v2(DB, sql_rem, -1, &stmt_rem, 0);
-            sqlite3_bind_int(stmt_rem, 1, patient_id);
-            sqlite3_bind_text(stmt_rem, 2, rem.getMessage().c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt_rem, 3, rem.getDate().c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_text(stmt_rem, 4, rem.getTime().c_str(), -1, SQLITE_STATIC);
-            sqlite3_step(stmt_rem);
-            sqlite3_finalize(stmt_rem);
+bool DatabaseManager::insertVitalBatch(const vector<ImportedVital>& rows) {
+    OperationScope scope(*this, DbOperation::InsertVitalBatch);
+    if (!begin()) {
+        cerr << "Could not start import transaction: " << sqlite3_errmsg(DB) << endl;
+        return false;
+    }
+    for (const ImportedVital& row : rows) {
+        long long id = 0;
+        if (!insertVital(row.patientId, row.kind, row.timestamp, row.value1, row.value2, id)) {
+            cerr << "Import batch failed, rolling back: " << sqlite3_errmsg(DB) << endl;
+            rollback();
+            return false;
         }
     }
-    cout << "All data saved to database.\n";
+    if (!flushRollups() || !bumpGeneration() || !commit()) {
+        cerr << "Import commit failed: " << sqlite3_errmsg(DB) << endl;
+        rollback();
+        return false;
+    }
+    return true;
 }
 
-void DatabaseManager::loadPatients(vector<unique_ptr<Patient>>& patients) {
+long long DatabaseManager::generation() {
+    CachedStatement stmt = prepare("SELECT value FROM meta WHERE key = 'generation';");
+    if (!stmt || step(stmt) != SQLITE_ROW) return -1;
+    return sqlite3_column_int64(stmt, 0);
+}
+
+unordered_set<long long> DatabaseManager::loadPatientIds() {
+    unordered_set<long long> ids;
+    CachedStatement stmt = prepare("SELECT id FROM patients;");
+    if (!stmt) return ids;
+    while (step(stmt) == SQLITE_ROW) ids.insert(sqlite3_column_int64(stmt, 0));
+    return ids;
+}
+
+void DatabaseManager::loadPatients(vector<unique_ptr<Patient>>& patients, pmr::memory_resource* memory) {
+    OperationScope scope(*this, DbOperation::LoadPatients);
     patients.clear();
-    sqlite3_stmt *stmt_p, *stmt_r, *stmt_m, *stmt_rem;
-    const char* sql_p = "SELECT id, name, age, contact FROM patients;";
-    
-    sqlite3_prepare_v2(DB, sql_p, -1, &stmt_p, 0);
-    while (sqlite3_step(stmt_p) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt_p, 0);
-        string name = (const char*)sqlite3_column_text(stmt_p, 1);
-        int age = sqlite3_column_int(stmt_p, 2);
-        string contact = (const char*)sqlite3_column_text(stmt_p, 3);
-        
-        auto patient = make_unique<Patient>(name, age, contact);
-
-        // Load Health Records
-        const char* sql_r = "SELECT type, value1, value2, timestamp FROM health_records WHERE patient_id = ?;";
-        sqlite3_prepare_v2(DB, sql_r, -1, &stmt_r, 0);
-        sqlite3_bind_int(stmt_r, 1, id);
-        while (sqlite3_step(stmt_r) == SQLITE_ROW) {
-            string type = (const char*)sqlite3_column_text(stmt_r, 0);
-            double val1 = sqlite3_column_double(stmt_r, 1);
-            double val2 = sqlite3_column_double(stmt_r, 2);
-            time_t ts = sqlite3_column_int64(stmt_r, 3);
-            if (type == "BP") patient->addRecord(make_unique<BloodPressureRecord>(val1, val2, ts));
-            else if (type == "Weight") patient->addRecord(make_unique<WeightRecord>(val1, ts));
-            else if (type == "Sugar") patient->addRecord(make_unique<BloodSugarRecord>(val1, ts));
-        }
-        sqlite3_finalize(stmt_r);
-
-        // Load Medications
-        const char* sql_m = "SELECT name, dosage, schedule FROM medications WHERE patient_id = ?;";
-        sqlite3_prepare_v2(DB, sql_m, -1, &stmt_m, 0);
-        sqlite3_bind_int(stmt_m, 1, id);
-        while(sqlite3_step(stmt_m) == SQLITE_ROW) {
-            string m_name = (const char*)sqlite3_column_text(stmt_m, 0);
-            string m_dosage = (const char*)sqlite3_column_text(stmt_m, 1);
-            string m_schedule = (const char*)sqlite3_column_text(stmt_m, 2);
-            patient->addMedication(Medication(m_name, m_dosage, m_schedule));
-        }
-        sqlite3_finalize(stmt_m);
-        
-        // Load Reminders
-        const char* sql_rem = "SELECT message, date, time FROM reminders WHERE patient_id = ?;";
-        sqlite3_prepare_v2(DB, sql_rem, -1, &stmt_rem, 0);
-        sqlite3_bind_int(stmt_rem, 1, id);
-        while(sqlite3_step(stmt_rem) == SQLITE_ROW) {
-            string r_msg = (const char*)sqlite3_column_text(stmt_rem, 0);
-            string r_date = (const char*)sqlite3_column_text(stmt_rem, 1);
-            string r_time = (const char*)sqlite3_column_text(stmt_rem, 2);
-            patient->addReminder(Reminder(r_msg, r_date, r_time));
-        }
-        sqlite3_finalize(stmt_rem);
+    const char* sql_p = "SELECT id, name, age, contact FROM patients ORDER BY id;";
+    const char* sql_c = "SELECT patient_id, id, type, data FROM health_chunks "
+                        "ORDER BY patient_id, type, last_ts;";
+    const char* sql_r = "SELECT patient_id, id, type, value1, value2, timestamp FROM health_records "
+                        "ORDER BY patient_id, timestamp;";
+    const char* sql_m = "SELECT patient_id, id, name, dosage, schedule FROM medications "
+                        "ORDER BY patient_id;";
+    const char* sql_rem = "SELECT patient_id, id, message, date, time, frequency FROM reminders "
+                          "ORDER BY patient_id, date, time;";
 
-        patients.push_back(move(patient));
+    if (CachedStatement stmt_p = prepare(sql_p)) {
+        while (step(stmt_p) == SQLITE_ROW) {
+            auto patient = make_unique<Patient>(columnText(stmt_p, 1), sqlite3_column_int(stmt_p, 2), columnText(stmt_p, 3), memory);
+            patient->markSaved(sqlite3_column_int64(stmt_p, 0));
+            patients.push_back(move(patient));
+        }
     }
-    sqlite3_finalize(stmt_p);
+
+    // Sealed readings first: they are the older ones, so most readings append.
+    if (CachedStatement stmt = prepare(sql_c)) mergeChildRows(stmt, patients, addChunkRow);
+    if (CachedStatement stmt = prepare(sql_r)) mergeChildRows(stmt, patients, addRecordRow);
+    if (CachedStatement stmt = prepare(sql_m)) mergeChildRows(stmt, patients, addMedicationRow);
+    if (CachedStatement stmt = prepare(sql_rem)) mergeChildRows(stmt, patients, addReminderRow);
+
+    for (auto& patient : patients) patient->markHistorySaved();
     cout << "Loaded " << patients.size() << " patients from database.\n";
-}
\ No newline at end of file
+}
+
+bool DatabaseManager::loadPatientRange(vector<unique_ptr<Patient>>& out, long long firstId, long long lastId, pmr::memory_resource* memory) {
+    OperationScope scope(*this, DbOperation::LoadPatientRange);
+    const char* sql_p = "SELECT id, name, age, contact FROM patients WHERE id BETWEEN ? AND ? ORDER BY id;";
+    const char* sql_c = "SELECT patient_id, id, type, data FROM health_chunks "
+                        "WHERE patient_id BETWEEN ? AND ? ORDER BY patient_id, type, last_ts;";
+    const char* sql_r = "SELECT patient_id, id, type, value1, value2, timestamp FROM health_records "
+                        "WHERE patient_id BETWEEN ? AND ? ORDER BY patient_id, timestamp;";
+    const char* sql_m = "SELECT patient_id, id, name, dosage, schedule FROM medications "
+                        "WHERE patient_id BETWEEN ? AND ? ORDER BY patient_id;";
+    const char* sql_rem = "SELECT patient_id, id, message, date, time, frequency FROM reminders "
+                          "WHERE patient_id BETWEEN ? AND ? ORDER BY patient_id, date, time;";
+    auto bindRange = [&](sqlite3_stmt* stmt) {
+        if (!stmt) return stmt;
+        sqlite3_bind_int64(stmt, 1, firstId);
+        sqlite3_bind_int64(stmt, 2, lastId);
+        return stmt;
+    };
+    if (!begin("BEGIN;")) return false;
+    {
+        CachedStatement stmt = prepare(sql_p);
+        if (!bindRange(stmt)) { rollback(); return false; }
+        while (step(stmt) == SQLITE_ROW) {
+            auto patient = make_unique<Patient>(columnText(stmt, 1), sqlite3_column_int(stmt, 2), columnText(stmt, 3), memory);
+            patient->markSaved(sqlite3_column_int64(stmt, 0));
+            out.push_back(move(patient));
+        }
+    }
+    if (CachedStatement stmt = prepare(sql_c)) mergeChildRows(bindRange(stmt), out, storeChunkRow);
+    if (CachedStatement stmt = prepare(sql_r)) mergeChildRows(bindRange(stmt), out, storeRecordRow);
+    if (CachedStatement stmt = prepare(sql_m)) mergeChildRows(bindRange(stmt), out, storeMedicationRow);
+    if (CachedStatement stmt = prepare(sql_rem)) mergeChildRows(bindRange(stmt), out, storeReminderRow);
+    commit();
+    return true;
+}
+
+void DatabaseManager::loadPatientsParallel(vector<unique_ptr<Patient>>& patients, PatientArena& arena, unsigned threads) {
+    OperationScope scope(*this, DbOperation::LoadPatientsParallel);
+    vector<long long> ids;
+    if (CachedStatement stmt = prepare("SELECT id FROM patients ORDER BY id;")) {
+        while (step(stmt) == SQLITE_ROW) ids.push_back(sqlite3_column_int64(stmt, 0));
+    }
+    threads = (unsigned)min<size_t>(threads, ids.size() / 256);
+    if (threads <= 1) { loadPatients(patients, arena.resource()); return; }
+
+    struct Range {
+        long long firstId, lastId;
+        pmr::memory_resource* memory;
+        vector<unique_ptr<Patient>> patients;
+        bool ok = false;
+    };
+    vector<Range> ranges(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        Range& r = ranges[t];
+        // The outer ranges are open-ended so rows added meanwhile are not missed.
+        r.firstId = t == 0 ? numeric_limits<long long>::min() : ids[ids.size() * t / threads];
+        r.lastId = t + 1 == threads ? numeric_limits<long long>::max() : ids[ids.size() * (t + 1) / threads] - 1;
+        r.memory = arena.newPool();
+    }
+    vector<thread> workers;
+    for (Range& r : ranges) {
+        workers.emplace_back([this, &r] {
+            DatabaseManager reader(db_file);
+            r.ok = reader.openReadOnly(profile) && reader.loadPatientRange(r.patients, r.firstId, r.lastId, r.memory);
+        });
+    }
+    for (thread& w : workers) w.join();
+    for (const Range& r : ranges) {
+        if (!r.ok) {
+            cerr << "Parallel load failed, loading on one connection.\n";
+            loadPatients(patients, arena.resource());
+            return;
+        }
+    }
+
+    patients.clear();
+    patients.reserve(ids.size());
+    for (Range& r : ranges) {
+        for (auto& patient : r.patients) patients.push_back(move(patient));
+    }
+    for (auto& patient : patients) {
+        patient->announceHistory();
+        patient->markHistorySaved();
+    }
+    cout << "Loaded " << patients.size() << " patients from database (" << threads << " threads).\n";
+}
+
+void DatabaseManager::loadPatientSummaries(vector<unique_ptr<Patient>>& patients, HistoryCache* cache,
+                                           pmr::memory_resource* memory) {
+    OperationScope scope(*this, DbOperation::LoadPatientSummaries);
+    patients.clear();
+    CachedStatement stmt = prepare("SELECT id, name, age, contact FROM patients ORDER BY id;");
+    if (!stmt) return;
+    while (step(stmt) == SQLITE_ROW) {
+        auto patient = make_unique<Patient>(columnText(stmt, 1), sqlite3_column_int(stmt, 2), columnText(stmt, 3), memory);
+        patient->markSaved(sqlite3_column_int64(stmt, 0));
+        patient->attachHistoryCache(cache);
+        patients.push_back(move(patient));
+    }
+    cout << "Loaded " << patients.size() << " patient summaries from database.\n";
+}
+
+void DatabaseManager::loadHistory(Patient& patient) {
+    OperationScope scope(*this, DbOperation::LoadHistory);
+    const char* sql_c = "SELECT patient_id, id, type, data FROM health_chunks "
+                        "WHERE patient_id = ? ORDER BY type, last_ts;";
+    const char* sql_r = "SELECT patient_id, id, type, value1, value2, timestamp FROM health_records "
+                        "WHERE patient_id = ? ORDER BY timestamp;";
+    const char* sql_m = "SELECT patient_id, id, name, dosage, schedule FROM medications WHERE patient_id = ?;";
+    const char* sql_rem = "SELECT patient_id, id, message, date, time, frequency FROM reminders "
+                          "WHERE patient_id = ? ORDER BY date, time;";
+    bool wasDirty = patient.hasUnsavedHistory();
+    if (CachedStatement stmt = prepare(sql_c)) {
+        sqlite3_bind_int64(stmt, 1, patient.getRowId());
+        while (step(stmt) == SQLITE_ROW) addChunkRow(patient, stmt);
+    }
+    if (CachedStatement stmt = prepare(sql_r)) {
+        sqlite3_bind_int64(stmt, 1, patient.getRowId());
+        while (step(stmt) == SQLITE_ROW) addRecordRow(patient, stmt);
+    }
+    if (CachedStatement stmt = prepare(sql_m)) {
+        sqlite3_bind_int64(stmt, 1, patient.getRowId());
+        while (step(stmt) == SQLITE_ROW) addMedicationRow(patient, stmt);
+    }
+    if (CachedStatement stmt = prepare(sql_rem)) {
+        sqlite3_bind_int64(stmt, 1, patient.getRowId());
+        while (step(stmt) == SQLITE_ROW) addReminderRow(patient, stmt);
+    }
+    if (!wasDirty) patient.markHistorySaved();
+}
+
+void DatabaseManager::loadVitalsInRange(long long patient_id, VitalKind kind, time_t from, time_t to, VitalSeries& out) {
+    OperationScope scope(*this, DbOperation::LoadVitalsInRange);
+    if (CachedStatement chunks = prepare(
+            "SELECT patient_id, id, type, data FROM health_chunks "
+            "WHERE patient_id = ? AND type = ? AND last_ts >= ? AND first_ts <= ? ORDER BY last_ts;")) {
+        sqlite3_bind_int64(chunks, 1, patient_id);
+        sqlite3_bind_int(chunks, 2, vitalTypeId(kind));
+        sqlite3_bind_int64(chunks, 3, from);
+        sqlite3_bind_int64(chunks, 4, to);
+        while (step(chunks) == SQLITE_ROW) {
+            decodeChunkRow(chunks, [&](VitalKind, time_t ts, double v1, double v2, long long id) {
+                if (ts >= from && ts <= to) out.insert(ts, v1, v2, id);
+            });
+        }
+    }
+    CachedStatement stmt = prepare(
+        "SELECT id, value1, value2, timestamp FROM health_records "
+        "WHERE patient_id = ? AND type = ? AND timestamp BETWEEN ? AND ? ORDER BY timestamp;");
+    if (!stmt) return;
+    sqlite3_bind_int64(stmt, 1, patient_id);
+    sqlite3_bind_int(stmt, 2, vitalTypeId(kind));
+    sqlite3_bind_int64(stmt, 3, from);
+    sqlite3_bind_int64(stmt, 4, to);
+    while (step(stmt) == SQLITE_ROW) {
+        out.insert(sqlite3_column_int64(stmt, 3), sqlite3_column_double(stmt, 1),
+                   sqlite3_column_double(stmt, 2), sqlite3_column_int64(stmt, 0));
+    }
+}
+
+void DatabaseManager::loadRollups(long long patient_id, VitalKind kind, RollupPeriod period, time_t from, time_t to, vector<RollupBucket>& out) {
+    OperationScope scope(*this, DbOperation::LoadRollups);
+    CachedStatement stmt = prepare(
+        "SELECT bucket_start, readings, value1_min, value1_max, value1_sum, value2_min, value2_max, value2_sum "
+        "FROM health_rollups WHERE patient_id = ? AND type = ? AND period = ? AND bucket_start BETWEEN ? AND ? "
+        "ORDER BY bucket_start;");
+    if (!stmt) return;
+    sqlite3_bind_int64(stmt, 1, patient_id);
+    sqlite3_bind_int(stmt, 2, vitalTypeId(kind));
+    sqlite3_bind_text(stmt, 3, rollupPeriodTag(period), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, from);
+    sqlite3_bind_int64(stmt, 5, to);
+    while (step(stmt) == SQLITE_ROW) {
+        RollupBucket b;
+        b.start = sqlite3_column_int64(stmt, 0);
+        b.count = uint32_t(sqlite3_column_int64(stmt, 1));
+        b.min1 = sqlite3_column_double(stmt, 2);
+        b.max1 = sqlite3_column_double(stmt, 3);
+        b.sum1 = sqlite3_column_double(stmt, 4);
+        b.min2 = sqlite3_column_double(stmt, 5);
+        b.max2 = sqlite3_column_double(stmt, 6);
+        b.sum2 = sqlite3_column_double(stmt, 7);
+        out.push_back(b);
+    }
+}
+
+bool DatabaseManager::rebuildRollups() {
+    OperationScope scope(*this, DbOperation::RebuildRollups);
+    if (!begin()) {
+        cerr << "Could not start rollup rebuild: " << sqlite3_errmsg(DB) << endl;
+        return false;
+    }
+    bool ok = sqlite3_exec(DB, "DELETE FROM health_rollups;", 0, 0, 0) == SQLITE_OK;
+    size_t written = 0;
+    long long groupPatient = 0;
+    VitalKind groupKind = VitalKind::BloodPressure;
+    VitalRollups group;
+    auto writeGroup = [&] {
+        for (RollupPeriod period : {RollupPeriod::Day, RollupPeriod::Week}) {
+            for (const RollupBucket& b : group.buckets(period)) {
+                CachedStatement upsert = prepare(UpsertRollupSql);
+                if (!upsert) return false;
+                bindRollup(upsert, groupPatient, groupKind, period, b);
+                if (step(upsert) != SQLITE_DONE) return false;
+                ++rowsTouched;
+                ++written;
+            }
+        }
+        group.clear();
+        return true;
+    };
+    auto enterGroup = [&](long long patient_id, VitalKind kind) {
+        if (patient_id == groupPatient && kind == groupKind) return true;
+        bool wrote = writeGroup();
+        groupPatient = patient_id;
+        groupKind = kind;
+        return wrote;
+    };
+    if (CachedStatement stmt = prepare("SELECT patient_id, id, type, data FROM health_chunks "
+                                       "ORDER BY patient_id, type, last_ts;")) {
+        while (ok && step(stmt) == SQLITE_ROW) {
+            decodeChunkRow(stmt, [&](VitalKind kind, time_t ts, double v1, double v2, long long) {
+                if (ok) ok = enterGroup(sqlite3_column_int64(stmt, 0), kind);
+                group.add(ts, v1, vitalHasSecondValue(kind) ? v2 : 0.0);
+            });
+        }
+    } else {
+        ok = false;
+    }
+    if (ok) ok = writeGroup();
+    if (CachedStatement stmt = prepare("SELECT patient_id, type, value1, value2, timestamp FROM health_records "
+                                       "ORDER BY patient_id, type, timestamp;")) {
+        while (ok && step(stmt) == SQLITE_ROW) {
+            VitalKind kind;
+            if (!readVitalType(stmt, 1, kind)) continue;
+            ok = enterGroup(sqlite3_column_int64(stmt, 0), kind);
+            double second = vitalHasSecondValue(kind) ? sqlite3_column_double(stmt, 3) : 0.0;
+            group.add(sqlite3_column_int64(stmt, 4), sqlite3_column_double(stmt, 2), second);
+        }
+    } else {
+        ok = false;
+    }
+    if (ok) ok = writeGroup();
+    if (!ok || !commit()) {
+        cerr << "Rollup rebuild failed, rolling back: " << sqlite3_errmsg(DB) << endl;
+        rollback();
+        return false;
+    }
+    cout << "Rebuilt " << written << " rollup rows from the stored readings.\n";
+    return true;
+}
+
+bool DatabaseManager::compactVitals(time_t sealBefore) {
+    OperationScope scope(*this, DbOperation::CompactVitals);
+    long long bytesBefore = databaseBytes();
+    if (!begin()) {
+        cerr << "Could not start compaction: " << sqlite3_errmsg(DB) << endl;
+        return false;
+    }
+    struct Group { long long patient_id; VitalKind kind; size_t readings; };
+    vector<Group> sealed;
+    size_t chunks = 0, chunkBytes = 0;
+    bool ok = true;
+    vector<time_t> times;
+    vector<double> values1, values2;
+    Group group{0, VitalKind::BloodPressure, 0};
+    auto sealGroup = [&] {
+        size_t n = times.size();
+        if (n >= VitalChunkMinReadings) {
+            bool two = vitalHasSecondValue(group.kind);
+            size_t parts = (n + VitalChunkMaxReadings - 1) / VitalChunkMaxReadings;
+            for (size_t part = 0; part < parts; ++part) {
+                size_t lo = n * part / parts, hi = n * (part + 1) / parts;
+                string data = VitalChunkCodec::encode(times.data() + lo, values1.data() + lo, two ? values2.data() + lo : nullptr, hi - lo);
+                CachedStatement insert = prepare(
+                    "INSERT INTO health_chunks (patient_id, type, first_ts, last_ts, readings, data) VALUES (?, ?, ?, ?, ?, ?);");
+                if (!insert) return false;
+                sqlite3_bind_int64(insert, 1, group.patient_id);
+                sqlite3_bind_int(insert, 2, vitalTypeId(group.kind));
+                sqlite3_bind_int64(insert, 3, times[lo]);
+                sqlite3_bind_int64(insert, 4, times[hi - 1]);
+                sqlite3_bind_int64(insert, 5, (long long)(hi - lo));
+                sqlite3_bind_blob(insert, 6, data.data(), (int)data.size(), SQLITE_STATIC);
+                if (step(insert) != SQLITE_DONE) return false;
+                ++rowsTouched;
+                ++chunks;
+                chunkBytes += data.size();
+            }
+            group.readings = n;
+            sealed.push_back(group);
+        }
+        times.clear();
+        values1.clear();
+        values2.clear();
+        return true;
+    };
+    if (CachedStatement stmt = prepare("SELECT patient_id, type, value1, value2, timestamp FROM health_records "
+                                       "WHERE timestamp < ? ORDER BY patient_id, type, timestamp;")) {
+        sqlite3_bind_int64(stmt, 1, sealBefore);
+        while (ok && step(stmt) == SQLITE_ROW) {
+            VitalKind kind;
+            if (!readVitalType(stmt, 1, kind)) continue;
+            long long patient_id = sqlite3_column_int64(stmt, 0);
+            if (patient_id != group.patient_id || kind != group.kind) {
+                ok = sealGroup();
+                group = {patient_id, kind, 0};
+            }
+            times.push_back(sqlite3_column_int64(stmt, 4));
+            values1.push_back(sqlite3_column_double(stmt, 2));
+            if (vitalHasSecondValue(kind)) values2.push_back(sqlite3_column_double(stmt, 3));
+        }
+    } else {
+        ok = false;
+    }
+    if (ok) ok = sealGroup();
+
+    // The deletes must remove exactly what was sealed; anything else rolls back.
+    size_t readings = 0;
+    for (const Group& g : sealed) {
+        if (!ok) break;
+        CachedStatement del = prepare("DELETE FROM health_records WHERE patient_id = ? AND type = ? AND timestamp < ?;");
+        if (!(ok = bool(del))) break;
+        sqlite3_bind_int64(del, 1, g.patient_id);
+        sqlite3_bind_int(del, 2, vitalTypeId(g.kind));
+        sqlite3_bind_int64(del, 3, sealBefore);
+        ok = step(del) == SQLITE_DONE && size_t(sqlite3_changes(DB)) == g.readings;
+        rowsTouched += g.readings;
+        readings += g.readings;
+    }
+    if (ok && !sealed.empty()) ok = bumpGeneration();
+    if (!ok || !commit()) {
+        cerr << "Compaction failed, rolling back: " << sqlite3_errmsg(DB) << endl;
+        rollback();
+        return false;
+    }
+    if (sqlite3_exec(DB, "VACUUM;", 0, 0, 0) != SQLITE_OK) cerr << "VACUUM failed: " << sqlite3_errmsg(DB) << endl;
+    cout << "Sealed " << readings << " readings into " << chunks << " chunks";
+    if (readings) cout << " (" << double(chunkBytes) / readings << " bytes per reading)";
+    cout << "; database " << bytesBefore / 1024 << " KiB -> " << databaseBytes() / 1024 << " KiB.\n";
+    return true;
+}
+
+long long DatabaseManager::databaseBytes() {
+    CachedStatement pages = prepare("PRAGMA page_count;");
+    if (!pages || step(pages) != SQLITE_ROW) return -1;
+    long long count = sqlite3_column_int64(pages, 0);
+    CachedStatement size = prepare("PRAGMA page_size;");
+    if (!size || step(size) != SQLITE_ROW) return -1;
+    return count * sqlite3_column_int64(size, 0);
+}
+
+long long DatabaseManager::pruneChanges(long long throughSeq) {
+    OperationScope scope(*this, DbOperation::PruneChanges);
+    CachedStatement stmt = prepare("DELETE FROM change_log WHERE seq <= ?;");
+    if (!stmt) return -1;
+    sqlite3_bind_int64(stmt, 1, throughSeq);
+    if (step(stmt) != SQLITE_DONE) return -1;
+    return sqlite3_changes(DB);
+}
@@ -0,0 +1,409 @@
+// MediTrack.cpp
+// Out-of-line parts of meditrack_core: lazy history loading and the console UI
+// (Patient views, menus, patient selection).
+#include "MediTrack.h"
+
+void Patient::ensureHistory() const {
+    // History is cached state, so loading it is allowed from const readers.
+    if (historyCache) historyCache->require(const_cast<Patient&>(*this));
+}
+
+
+// ------------------- Patient Method Implementations -------------------
+// (We declare these down here because they use UI elements like cout/cin)
+void Patient::calculateAndDisplayBMI() const {
+    ensureHistory();
+    const VitalSeries& weights = vitals.series(VitalKind::Weight);
+    double lastWeight = weights.hasLatest() ? weights.values1()[weights.latest()] : 0.0;
+    if (lastWeight <= 0) {
+        cout << "\nBMI cannot be calculated. No weight records found.\n";
+        return;
+    }
+    double heightMeters;
+    cout << "\nPlease enter patient's height in meters (e.g., 1.75): ";
+    cin >> heightMeters;
+    if (cin.fail() || heightMeters <= 0) {
+        cout << "Invalid height. Cannot calculate BMI.\n";
+        cin.clear();
+        clearInputBuffer();
+        return;
+    }
+    double bmi = lastWeight / (heightMeters * heightMeters);
+    cout << "\n--- BMI Calculation for " << name << " ---\n";
+    cout << "Using most recent weight: " << lastWeight << " kg\n";
+    cout << "Height: " << heightMeters << " m\n";
+    cout << "Calculated BMI is: " << bmi << "\n";
+    if (bmi < 18.5) cout << "Category: Underweight\n";
+    else if (bmi < 25) cout << "Category: Normal weight\n";
+    else if (bmi < 30) cout << "Category: Overweight\n";
+    else cout << "Category: Obesity\n";
+    cout << "---------------------------------\n";
+}
+
+void Patient::displayHealthTrend() const {
+    int choice, windowChoice;
+    cout << "\n--- View Health Trends for " << name << " ---\n";
+    for (size_t i = 0; i < VitalKindCount; ++i) cout << i + 1 << ". " << vitalKindInfos[i].label << " Trend\n";
+    cout << "Enter your choice: ";
+    cin >> choice;
+    if (cin.fail()) {
+        cin.clear(); clearInputBuffer();
+        cout << "Invalid input.\n";
+        return;
+    }
+    if (choice < 1 || choice > int(VitalKindCount)) { cout << "Invalid choice.\n"; return; }
+    VitalKind kind = allVitalKinds[choice - 1];
+    cout << "Time window: 1. All  2. Last 7 days  3. Last 30 days  4. Last 90 days  5. Last N readings\n"
+            "             6. Daily summary, last year  7. Weekly summary, all time\n";
+    cout << "Enter your choice: ";
+    cin >> windowChoice;
+    if (cin.fail()) {
+        cin.clear(); clearInputBuffer();
+        cout << "Invalid input.\n";
+        return;
+    }
+    if (windowChoice == 6 || windowChoice == 7) {
+        displayRollups(kind, windowChoice == 6 ? RollupPeriod::Day : RollupPeriod::Week);
+        return;
+    }
+    const int windowDays[] = {0, 7, 30, 90, 0};
+    if (windowChoice < 1 || windowChoice > 5) { cout << "Invalid choice.\n"; return; }
+    long long latestCount = 0;
+    if (windowChoice == 5) {
+        cout << "How many readings: ";
+        cin >> latestCount;
+        if (cin.fail() || latestCount <= 0) {
+            if (cin.fail()) { cin.clear(); clearInputBuffer(); }
+            cout << "Invalid number.\n";
+            return;
+        }
+    }
+    time_t to = numeric_limits<time_t>::max();
+    time_t from = windowDays[windowChoice - 1] == 0 ? numeric_limits<time_t>::min()
+                                                   : time(0) - time_t(windowDays[windowChoice - 1]) * 24 * 60 * 60;
+
+    RenderBuffer out;
+    Pager pager(out);
+    out << "\n--- Trend Report ---\n";
+    auto show = [&](const HealthRecord& rec) { if (pager.more()) rec.render(out); };
+    auto report = [&](const VitalsStore& store) {
+        return latestCount > 0 ? store.forEachLatestRecord(kind, size_t(latestCount), show)
+                               : store.forEachRecordInRange(kind, from, to, show);
+    };
+    size_t shown;
+    if (historyCache && !historyLoaded) {
+        // Lazy patient: read just the window from the database instead of hydrating.
+        VitalsStore window;
+        window.series(kind) = historyCache->loadWindow(*this, kind, from, to);
+        shown = report(window);
+    } else {
+        ensureHistory();
+        shown = report(vitals);
+    }
+    if (shown == 0) out << "No records of that type found.\n";
+    if (pager.more()) out << "--------------------\n";
+}
+
+// One line per rollup bucket: a few hundred rows cover years of readings.
+void Patient::displayRollups(VitalKind kind, RollupPeriod period) const {
+    time_t to = numeric_limits<time_t>::max();
+    time_t from = period == RollupPeriod::Day ? LocalCalendar::dayStart(time(0) - time_t(365) * 24 * 60 * 60)
+                                              : numeric_limits<time_t>::min();
+    vector<RollupBucket> stored;
+    const RollupBucket* first;
+    size_t count;
+    if (historyCache && !historyLoaded) {
+        // Lazy patient: the buckets come from health_rollups, no readings are loaded.
+        stored = historyCache->loadRollups(*this, kind, period, from, to);
+        first = stored.data();
+        count = stored.size();
+    } else {
+        ensureHistory();
+        const VitalRollups& rollups = vitals.series(kind).rollups();
+        auto window = rollups.range(period, from, to);
+        first = rollups.buckets(period).data() + window.first;
+        count = window.second - window.first;
+    }
+
+    const char* unit = vitalInfo(kind).unit;
+    RenderBuffer out;
+    Pager pager(out);
+    out << "\n--- " << (period == RollupPeriod::Day ? "Daily" : "Weekly") << " Summary (" << unit << ") ---\n";
+    for (size_t i = 0; i < count && pager.more(); ++i) {
+        const RollupBucket& b = first[i];
+        out.date(b.start) << (period == RollupPeriod::Week ? " week" : "") << ": " << (unsigned long)b.count
+                          << (b.count == 1 ? " reading" : " readings") << ", avg " << b.avg1();
+        if (vitalHasSecondValue(kind)) {
+            out << "/" << b.avg2() << ", min " << b.min1 << "/" << b.min2 << ", max " << b.max1 << "/" << b.max2 << "\n";
+        } else {
+            out << ", min " << b.min1 << ", max " << b.max1 << "\n";
+        }
+    }
+    if (count == 0) out << "No records of that type found.\n";
+    if (pager.more()) out << "--------------------\n";
+}
+
+static void displayVitalsSummary(const VitalsSummary& s) {
+    auto row = [](const char* label, const ColumnStats& c, const char* unit) {
+        if (c.count == 0) { cout << label << ": no readings\n"; return; }
+        cout << label << ": " << c.count << " readings, min " << c.min << ", max " << c.max
+             << ", mean " << c.mean() << ", stddev " << c.stddev() << " " << unit << "\n";
+    };
+    row("Systolic", s.systolic, "mmHg");
+    row("Diastolic", s.diastolic, "mmHg");
+    cout << "  Blood pressure alerts: " << s.bloodPressure.high << " high, " << s.bloodPressure.low << " low\n";
+    row("Weight", s.weight, "kg");
+    row("Blood Sugar", s.sugar, "mg/dL");
+    cout << "  Blood sugar alerts: " << s.sugar.high << " high, " << s.sugar.low << " low\n";
+}
+
+void Patient::displayVitalsStatistics() const {
+    ensureHistory();
+    cout << "\n--- Vitals Statistics for " << name << " ---\n";
+    displayVitalsSummary(summarizeVitals(vitals));
+    cout << "---------------------------------\n";
+}
+
+void Patient::display() const {
+    ensureHistory();
+    RenderBuffer out;
+    Pager pager(out);
+    out << "\n--- Patient Profile ---\n";
+    out << "Name: " << name << "\nAge: " << age << "\nContact: " << contactInfo << "\n";
+    out << "\n--- Health Records ---\n";
+    if (vitals.empty()) out << "No health records found.\n";
+    else vitals.forEachRecord([&](const HealthRecord& r) { if (pager.more()) r.render(out); });
+    if (pager.more()) {
+        out << "\n--- Medications ---\n";
+        if (medications.empty()) out << "No medications found.\n";
+        for (const auto &m : medications) if (pager.more()) m.render(out);
+    }
+    if (pager.more()) {
+        out << "\n--- Reminders ---\n";
+        if (reminders.empty()) out << "No reminders found.\n";
+        for (const auto &rem : reminders) if (pager.more()) rem.render(out);
+    }
+    if (pager.more()) out << "-----------------------\n";
+}
+
+void Patient::checkReminders() const {
+    ensureHistory();
+    cout << "\n--- Checking Reminders for " << name << " ---\n";
+    bool found = false;
+    for (const auto &rem : reminders) {
+        if (rem.isDue()) {
+            cout << "⚠️ Reminder Due: ";
+            rem.display();
+            found = true;
+        }
+    }
+    if (!found) cout << "No reminders are currently due.\n";
+}
+
+// ------------------- UI Functions -------------------
+void clearInputBuffer() {
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+}
+
+void addNewPatient(PatientRegistry& registry) {
+    string name, contact;
+    int age;
+    cout << "\nEnter patient's full name: ";
+    clearInputBuffer();
+    getline(cin, name);
+    cout << "Enter patient's age: ";
+    cin >> age;
+    cout << "Enter patient's contact info: ";
+    clearInputBuffer();
+    getline(cin, contact);
+    Patient& patient = registry.add(make_unique<Patient>(move(name), age, move(contact)));
+    patient.announceCreated();
+    cout << "Patient '" << patient.getName() << "' added successfully!\n";
+}
+
+void listAllPatients(const vector<unique_ptr<Patient>>& patients) {
+    RenderBuffer out;
+    Pager pager(out);
+    out << "\n--- All Patients ---\n";
+    if (patients.empty()) { out << "No patients in the system.\n"; return; }
+    for (size_t i = 0; i < patients.size() && pager.more(); ++i) {
+        out << i + 1 << ". " << patients[i]->getName() << '\n';
+    }
+}
+
+// Views read the patient directly (this is the registry's owner thread); changes go
+// through registry.edit so other threads reading the patient see them whole. A lazy
+// patient's history is loaded first, since loading it takes the same shard.
+void patientSubMenu(PatientRegistry& registry, Patient* patient) {
+    static const char* actionNames[] = {"", "patient.viewProfile", "patient.addRecord", "patient.addMedication", "patient.addReminder",
+                                        "patient.bmi", "patient.trends", "patient.vitalsStatistics", "patient.return"};
+    int choice;
+    do {
+        cout << "\n--- Managing Patient: " << patient->getName() << " ---\n";
+        cout << "1. View Patient Profile\n";
+        cout << "2. Add Health Record\n";
+        cout << "3. Add Medication\n";
+        cout << "4. Add Reminder\n";
+        cout << "5. Calculate BMI\n";
+        cout << "6. View Health Trends\n";
+        cout << "7. Vitals Statistics\n";
+        cout << "8. Return to Main Menu\n";
+        cout << "Enter your choice: ";
+        cin >> choice;
+        if (cin.fail()) {
+            cout << "Invalid input.\n";
+            cin.clear(); clearInputBuffer();
+            choice = 0; continue;
+        }
+        ScopedTimer timer(choice >= 1 && choice <= 8 ? DbMetrics::global().action(actionNames[choice]) : nullptr);
+        switch (choice) {
+            case 1: patient->display(); break;
+            case 2: {
+                int recordChoice;
+                cout << "\nSelect record type:\n";
+                for (size_t i = 0; i < VitalKindCount; ++i) cout << i + 1 << ". " << vitalKindInfos[i].label << "\n";
+                cout << "Choice: ";
+                cin >> recordChoice;
+                if (recordChoice >= 1 && recordChoice <= int(VitalKindCount)) {
+                    const VitalKindInfo& info = vitalKindInfos[recordChoice - 1];
+                    double values[2] = {0, 0};
+                    for (int v = 0; v < info.values; ++v) { cout << info.prompts[v]; cin >> values[v]; }
+                    if (!cin.fail()) {
+                        HealthRecord record(info.kind, values[0], values[1]);
+                        patient->ensureHistory();
+                        registry.edit(*patient, [&](Patient& p) { p.addRecord(record); });
+                    }
+                } else { cout << "Invalid record type.\n"; }
+                if(!cin.fail()) cout << "Record added.\n";
+                break;
+            }
+            case 3: {
+                string name, dosage, schedule;
+                cout << "Medication name: "; clearInputBuffer(); getline(cin, name);
+                cout << "Dosage (e.g., 500mg): "; getline(cin, dosage);
+                cout << "Schedule (e.g., Twice a day): "; getline(cin, schedule);
+                patient->ensureHistory();
+                registry.edit(*patient, [&](Patient& p) { p.emplaceMedication(name, dosage, schedule); });
+                cout << "Medication added.\n";
+                break;
+            }
+            case 4: {
+                string msg, date, time;
+                cout << "Reminder message: "; clearInputBuffer(); getline(cin, msg);
+                cout << "Date (YYYY-MM-DD): "; getline(cin, date);
+                cout << "Time (HH:MM, 24-hr): "; getline(cin, time);
+                string repeat;
+                cout << "Repeat (once/daily/weekly): "; getline(cin, repeat);
+                patient->ensureHistory();
+                registry.edit(*patient, [&](Patient& p) { p.emplaceReminder(msg, date, time, parseFrequency(repeat)); });
+                cout << "Reminder added.\n";
+                break;
+            }
+            case 5: patient->calculateAndDisplayBMI(); break;
+            case 6: patient->displayHealthTrend(); break;
+            case 7: patient->displayVitalsStatistics(); break;
+            case 8: cout << "Returning to main menu...\n"; break;
+            default: cout << "Invalid choice. Please try again.\n";
+        }
+    } while (choice != 8);
+}
+
+// Per-patient summaries and population totals in a single pass over the patients.
+void displayPopulationStatistics(const vector<unique_ptr<Patient>>& patients) {
+    VitalsSummary total;
+    size_t withAlerts = 0;
+    for (const auto& p : patients) {
+        p->ensureHistory();
+        VitalsSummary s = summarizeVitals(p->getVitals());
+        if (s.bloodPressure.high + s.bloodPressure.low + s.sugar.high + s.sugar.low > 0) ++withAlerts;
+        total.merge(s);
+    }
+    cout << "\n--- Population Vitals Statistics (" << patients.size() << " patients) ---\n";
+    displayVitalsSummary(total);
+    cout << "Patients with at least one abnormal reading: " << withAlerts << "\n";
+    cout << "---------------------------------\n";
+}
+
+void displayAlertingPatients(const AlertEngine& alerts) {
+    cout << "\n--- Patients Currently Alerting (" << alerts.alertingPatients().size() << ") ---\n";
+    for (int st = 0; st < AlertStateCount; ++st) {
+        const auto& members = alerts.patientsIn(AlertState(st));
+        cout << alertStateName(AlertState(st)) << " (" << members.size() << "):";
+        for (const Patient* p : members) cout << "\n  - " << p->getName();
+        cout << "\n";
+    }
+    cout << "---------------------------------\n";
+}
+
+void displayDatabaseStatistics() {
+    RenderBuffer out;
+    DbMetrics::global().render(out);
+    out.flush();
+}
+
+// db is given in lazy mode, for the patients whose history is not in memory.
+void displayPopulationReport(const PatientRegistry& registry, const DatabaseManager* db, WorkStealingPool& pool, int inactiveDays) {
+    ReportOptions options;
+    options.inactiveDays = inactiveDays;
+    auto start = chrono::steady_clock::now();
+    PopulationReport report = ReportEngine::run(registry, pool, db, options);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    RenderBuffer out;
+    report.render(out, options);
+    out << "(" << seconds << " s on " << int(pool.threads()) << " threads)\n";
+    out.flush();
+}
+
+// Lazy mode: patients without loaded history get their alert state from the newest
+// readings in the database. Hydrated patients already have an up-to-date state.
+void seedAlertsFromDatabase(DatabaseManager& db, const vector<unique_ptr<Patient>>& patients, AlertEngine& alerts) {
+    unordered_map<long long, const Patient*> byRowId;
+    for (const auto& p : patients) {
+        if (!p->isNew() && !p->isHistoryLoaded()) byRowId[p->getRowId()] = p.get();
+    }
+    db.forEachLatestVitals([&](long long patient_id, VitalKind kind, const VitalReading& latest, const VitalReading* previous) {
+        auto it = byRowId.find(patient_id);
+        if (it != byRowId.end()) alerts.evaluate(*it->second, kind, latest, previous);
+    });
+}
+
+// Reads a 1-based choice among `count` listed entries; 0 when the input is not one.
+static size_t readSelection(size_t count) {
+    cout << "Select a patient by number: ";
+    long long choice;
+    cin >> choice;
+    if (cin.fail() || choice <= 0 || (size_t)choice > count) {
+        cout << "Invalid selection.\n";
+        if(cin.fail()){ cin.clear(); clearInputBuffer(); }
+        return 0;
+    }
+    return (size_t)choice;
+}
+
+void selectPatient(PatientRegistry& registry, const PatientIndex& index) {
+    const vector<unique_ptr<Patient>>& patients = registry.patients();
+    if (patients.empty()) { cout << "No patients to select.\n"; return; }
+    cout << "Search by name or contact (Enter to list everyone): ";
+    clearInputBuffer();
+    string query;
+    getline(cin, query);
+    if (query.empty()) {
+        listAllPatients(patients);
+        if (size_t choice = readSelection(patients.size())) patientSubMenu(registry, patients[choice - 1].get());
+        return;
+    }
+
+    const size_t MaxMatches = 20;
+    vector<Patient*> matches = index.findByContact(query);
+    for (Patient* p : index.findByNamePrefix(query, MaxMatches)) {
+        if (matches.size() >= MaxMatches) break;
+        if (find(matches.begin(), matches.end(), p) == matches.end()) matches.push_back(p);
+    }
+    if (matches.empty()) { cout << "No patients match '" << query << "'.\n"; return; }
+    cout << "\n--- Matching Patients ---\n";
+    for (size_t i = 0; i < matches.size(); ++i) {
+        cout << i + 1 << ". " << matches[i]->getName() << " (" << matches[i]->getContact() << ")\n";
+    }
+    if (matches.size() == MaxMatches) cout << "(showing the first " << MaxMatches << "; type more of the name to narrow it down)\n";
+    if (size_t choice = readSelection(matches.size())) patientSubMenu(registry, matches[choice - 1]);
+}
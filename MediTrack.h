@@ -0,0 +1,2936 @@
+// MediTrack.h
+// The MediTrack domain model and its storage tier: the vital kinds, records, the
+// columnar vitals store, patients and their observers, the SQLite DatabaseManager,
+// snapshots, the history cache, bulk import, batch commands, the write-behind queue,
+// population reports and the patient server. Declared here, with templates and small
+// accessors inline; the rest is defined in one source file per component
+// (DatabaseManager.cpp, Snapshot.cpp, ...), built together into meditrack_core.
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <memory>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <algorithm>
+#include <array>
+#include <queue>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <cstdint>
+#include <charconv>
+#include <fstream>
+#include <chrono>
+#include <map>
+#include <functional>
+#include <tuple>
+#include <memory_resource>
+#include <csignal>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "sqlite3.h" // The SQLite C header
+#include "VitalsStats.h"
+
+using namespace std;
+
+// --- Forward Declarations ---
+class Patient;
+class DatabaseManager;
+class HistoryCache;
+class AlertEngine;
+void clearInputBuffer();
+class PatientRegistry;
+void addNewPatient(PatientRegistry& registry);
+void listAllPatients(const vector<unique_ptr<Patient>>& patients);
+void patientSubMenu(PatientRegistry& registry, Patient* patient);
+class PatientIndex;
+void selectPatient(PatientRegistry& registry, const PatientIndex& index);
+void displayPopulationStatistics(const vector<unique_ptr<Patient>>& patients);
+void displayAlertingPatients(const AlertEngine& alerts);
+void seedAlertsFromDatabase(DatabaseManager& db, const vector<unique_ptr<Patient>>& patients, AlertEngine& alerts);
+void displayDatabaseStatistics();
+class WorkStealingPool;
+void displayPopulationReport(const PatientRegistry& registry, const DatabaseManager* db, WorkStealingPool& pool, int inactiveDays);
+
+
+// ------------------- Persistence Bookkeeping -------------------
+// Remembers where an object lives in SQLite so a save only writes what changed.
+class Persistent {
+    long long rowId = 0; // 0 until the object has been saved once
+    bool dirty = true;
+public:
+    long long getRowId() const { return rowId; }
+    bool isNew() const { return rowId == 0; }
+    bool isDirty() const { return dirty; }
+    void markDirty() { dirty = true; }
+    void markSaved(long long id) { rowId = id; dirty = false; }
+};
+
+
+// ------------------- Console Rendering -------------------
+// Long listings (profiles, trends, the patient list) are formatted into one
+// preallocated buffer and written with a single write per page, instead of a stream
+// insertion per field. Readings are mostly in time order, so consecutive timestamps
+// usually fall on the same local day: the formatted date is cached per day and only
+// the time of day is computed per reading, without localtime/strftime.
+class RenderBuffer {
+    string text;
+    size_t lines = 0;
+    time_t dayStart = 1, dayEnd = 0; // cached local day [dayStart, dayEnd); empty at first
+    char dayText[11];
+
+    void cacheDay(time_t ts) {
+        tm day = *localtime(&ts);
+        // Reduced to their digit counts, so the text is always the 10 characters appended.
+        snprintf(dayText, sizeof(dayText), "%04u-%02u-%02u", unsigned(1900 + day.tm_year) % 10000u,
+                 unsigned(1 + day.tm_mon) % 100u, unsigned(day.tm_mday) % 100u);
+        day.tm_hour = day.tm_min = day.tm_sec = 0;
+        day.tm_isdst = -1;
+        dayStart = mktime(&day);
+        ++day.tm_mday;
+        day.tm_isdst = -1;
+        dayEnd = mktime(&day);
+        // On a DST change the hours are not (ts - dayStart) / 3600; don't cache those days.
+        if (dayEnd - dayStart != 24 * 60 * 60) dayEnd = dayStart;
+    }
+    void twoDigits(int v) {
+        text.push_back(char('0' + v / 10));
+        text.push_back(char('0' + v % 10));
+    }
+    template <typename T>
+    RenderBuffer& integer(T v) {
+        char digits[24];
+        auto result = to_chars(digits, digits + sizeof(digits), v);
+        text.append(digits, result.ptr);
+        return *this;
+    }
+
+public:
+    explicit RenderBuffer(size_t reserveBytes = 64 * 1024) { text.reserve(reserveBytes); }
+
+    RenderBuffer& operator<<(string_view s) {
+        text.append(s);
+        lines += count(s.begin(), s.end(), '\n');
+        return *this;
+    }
+    RenderBuffer& operator<<(const char* s) { return *this << string_view(s); }
+    RenderBuffer& operator<<(const string& s) { return *this << string_view(s); }
+    RenderBuffer& operator<<(char c) {
+        text.push_back(c);
+        if (c == '\n') ++lines;
+        return *this;
+    }
+    RenderBuffer& operator<<(int v) { return integer(v); }
+    RenderBuffer& operator<<(long v) { return integer(v); }
+    RenderBuffer& operator<<(long long v) { return integer(v); }
+    RenderBuffer& operator<<(unsigned long v) { return integer(v); }
+    RenderBuffer& operator<<(unsigned long long v) { return integer(v); }
+    // Same digits as cout's default formatting (%g, 6 significant digits).
+    RenderBuffer& operator<<(double v) {
+        char digits[32];
+        int n = snprintf(digits, sizeof(digits), "%g", v);
+        text.append(digits, n > 0 ? size_t(n) : 0);
+        return *this;
+    }
+
+    // "YYYY-MM-DD" in local time.
+    RenderBuffer& date(time_t ts) {
+        if (ts < dayStart || ts >= dayEnd) cacheDay(ts);
+        text.append(dayText, 10);
+        return *this;
+    }
+    // "YYYY-MM-DD HH:MM" in local time, as HealthRecord::getFormattedTimestamp.
+    RenderBuffer& timestamp(time_t ts) {
+        if (ts < dayStart || ts >= dayEnd) cacheDay(ts);
+        text.append(dayText, 10);
+        text.push_back(' ');
+        if (dayEnd > dayStart) {
+            int minutes = int((ts - dayStart) / 60);
+            twoDigits(minutes / 60);
+            text.push_back(':');
+            twoDigits(minutes % 60);
+        } else {
+            char clock[8];
+            strftime(clock, sizeof(clock), "%H:%M", localtime(&ts));
+            text.append(clock);
+        }
+        return *this;
+    }
+
+    size_t lineCount() const { return lines; }
+
+    // Writes everything buffered in one call and empties the buffer. Anything still
+    // queued in cout/stdout goes first, so output stays in order.
+    void flush() {
+        if (text.empty()) return;
+        cout.flush();
+        fflush(stdout);
+#ifndef _WIN32
+        for (size_t done = 0; done < text.size();) {
+            ssize_t n = ::write(STDOUT_FILENO, text.data() + done, text.size() - done);
+            if (n <= 0) break;
+            done += size_t(n);
+        }
+#else
+        fwrite(text.data(), 1, text.size(), stdout);
+        fflush(stdout);
+#endif
+        text.clear();
+        lines = 0;
+    }
+};
+
+// Splits a RenderBuffer listing into pages. Call more() before each row: once a page
+// is full it is written out and, on a terminal, the user is asked whether to go on.
+// more() returns false after they stop, and the rest of the rows are skipped.
+// Without a terminal everything is written, still one page per write.
+class Pager {
+    RenderBuffer& out;
+    size_t pageLines;
+    bool interactive;
+    bool stopped = false;
+public:
+    explicit Pager(RenderBuffer& buffer, size_t linesPerPage = 40)
+        : out(buffer), pageLines(linesPerPage),
+#ifndef _WIN32
+          interactive(isatty(STDIN_FILENO) && isatty(STDOUT_FILENO))
+#else
+          interactive(false)
+#endif
+    {}
+    ~Pager() { out.flush(); }
+
+    bool more() {
+        if (stopped) return false;
+        if (out.lineCount() < pageLines) return true;
+        out.flush();
+        if (!interactive) return true;
+        cout << "-- Enter for the next page, q to stop -- " << flush;
+        // The menu read its choice with >>, which leaves the newline behind.
+        if (cin.rdbuf()->in_avail() > 0 && cin.peek() == '\n') cin.get();
+        string answer;
+        getline(cin, answer);
+        stopped = !cin || (!answer.empty() && (answer[0] == 'q' || answer[0] == 'Q'));
+        return !stopped;
+    }
+    bool wasStopped() const { return stopped; }
+};
+
+
+// ------------------- Vital Kinds -------------------
+// Everything that differs between kinds of vital is declared once, in the kind's
+// VitalTraits specialization, and VitalKinds lists the kinds. Storage (the type id in
+// every vitals table), CSV and command parsing, display and the threshold alerts are
+// written against these, so adding a kind means an enum value, its traits and its
+// place in the list. The enum value indexes per-kind arrays; storageId is what the
+// database keeps and must never change once rows carry it.
+enum class VitalKind { BloodPressure, Weight, BloodSugar };
+
+// Alert states are per kind with limits: a high and a low one each.
+enum class AlertState { HighBloodPressure, LowBloodPressure, HighBloodSugar, LowBloodSugar };
+constexpr int AlertStateCount = 4;
+constexpr unsigned alertBit(AlertState s) { return 1u << int(s); }
+
+inline const char* alertStateName(AlertState s) {
+    switch (s) {
+        case AlertState::HighBloodPressure: return "High Blood Pressure";
+        case AlertState::LowBloodPressure: return "Low Blood Pressure";
+        case AlertState::HighBloodSugar: return "High Blood Sugar";
+        default: return "Low Blood Sugar";
+    }
+}
+// How a record display flags a reading in that state.
+inline const char* alertWarning(AlertState s) {
+    switch (s) {
+        case AlertState::HighBloodPressure: return "High Blood Pressure!";
+        case AlertState::LowBloodPressure: return "Low Blood Pressure!";
+        case AlertState::HighBloodSugar: return "High Blood Sugar (Potential Diabetes)!";
+        default: return "Low Blood Sugar (Hypoglycemia)!";
+    }
+}
+
+template <VitalKind K> struct VitalTraits;
+
+// tag: the name in CSV feeds and batch commands. values: 1, or 2 for a pair (value2
+// is 0 otherwise). whole: displayed without decimals. prompts: what the console asks
+// for each value. alerts(): the alert bits a reading triggers, from VitalThresholds;
+// hasLimits is false when it never triggers any, so no alert rule is registered.
+template <> struct VitalTraits<VitalKind::BloodPressure> {
+    static constexpr const char* tag = "BP";
+    static constexpr int storageId = 1;
+    static constexpr const char* label = "Blood Pressure";
+    static constexpr const char* unit = "mmHg";
+    static constexpr int values = 2;
+    static constexpr bool whole = true;
+    static constexpr const char* prompts[2] = {"Enter Systolic: ", "Enter Diastolic: "};
+    static constexpr bool hasLimits = true;
+    static constexpr unsigned alerts(double systolic, double diastolic) {
+        using namespace VitalThresholds;
+        if (systolic >= SystolicHigh || diastolic >= DiastolicHigh) return alertBit(AlertState::HighBloodPressure);
+        if (systolic <= SystolicLow || diastolic <= DiastolicLow) return alertBit(AlertState::LowBloodPressure);
+        return 0;
+    }
+};
+
+template <> struct VitalTraits<VitalKind::Weight> {
+    static constexpr const char* tag = "Weight";
+    static constexpr int storageId = 2;
+    static constexpr const char* label = "Weight";
+    static constexpr const char* unit = "kg";
+    static constexpr int values = 1;
+    static constexpr bool whole = false;
+    static constexpr const char* prompts[2] = {"Enter weight in kg: ", nullptr};
+    static constexpr bool hasLimits = false;
+    static constexpr unsigned alerts(double, double) { return 0; }
+};
+
+template <> struct VitalTraits<VitalKind::BloodSugar> {
+    static constexpr const char* tag = "Sugar";
+    static constexpr int storageId = 3;
+    static constexpr const char* label = "Blood Sugar";
+    static constexpr const char* unit = "mg/dL";
+    static constexpr int values = 1;
+    static constexpr bool whole = false;
+    static constexpr const char* prompts[2] = {"Enter blood sugar in mg/dL: ", nullptr};
+    static constexpr bool hasLimits = true;
+    static constexpr unsigned alerts(double sugar, double) {
+        if (sugar >= VitalThresholds::SugarHigh) return alertBit(AlertState::HighBloodSugar);
+        if (sugar < VitalThresholds::SugarLow) return alertBit(AlertState::LowBloodSugar);
+        return 0;
+    }
+};
+
+template <VitalKind... Ks> struct VitalKindList {};
+using VitalKinds = VitalKindList<VitalKind::BloodPressure, VitalKind::Weight, VitalKind::BloodSugar>;
+
+// The traits as data, for code that only learns the kind at run time.
+struct VitalKindInfo {
+    VitalKind kind;
+    const char* tag;
+    int storageId;
+    const char* label;
+    const char* unit;
+    int values;
+    bool whole;
+    const char* prompts[2];
+    unsigned (*alerts)(double, double);
+};
+
+template <VitalKind... Ks>
+constexpr array<VitalKindInfo, sizeof...(Ks)> makeVitalKindInfos(VitalKindList<Ks...>) {
+    return {{{Ks, VitalTraits<Ks>::tag, VitalTraits<Ks>::storageId, VitalTraits<Ks>::label, VitalTraits<Ks>::unit,
+              VitalTraits<Ks>::values, VitalTraits<Ks>::whole,
+              {VitalTraits<Ks>::prompts[0], VitalTraits<Ks>::prompts[1]}, &VitalTraits<Ks>::alerts}...}};
+}
+inline constexpr auto vitalKindInfos = makeVitalKindInfos(VitalKinds{});
+constexpr size_t VitalKindCount = vitalKindInfos.size();
+
+template <size_t... I>
+constexpr array<VitalKind, sizeof...(I)> listedVitalKinds(index_sequence<I...>) { return {{vitalKindInfos[I].kind...}}; }
+inline constexpr auto allVitalKinds = listedVitalKinds(make_index_sequence<VitalKindCount>{});
+
+constexpr bool vitalKindsInEnumOrder() {
+    for (size_t i = 0; i < VitalKindCount; ++i) {
+        if (size_t(vitalKindInfos[i].kind) != i) return false;
+        for (size_t j = 0; j < i; ++j) {
+            if (vitalKindInfos[j].storageId == vitalKindInfos[i].storageId) return false;
+        }
+    }
+    return true;
+}
+static_assert(vitalKindsInEnumOrder(), "VitalKinds must list every kind once, in enum order, with distinct storage ids");
+
+inline const VitalKindInfo& vitalInfo(VitalKind kind) { return vitalKindInfos[size_t(kind)]; }
+inline bool vitalHasSecondValue(VitalKind kind) { return vitalInfo(kind).values == 2; }
+
+inline bool vitalKindFromTag(string_view tag, VitalKind& kind) {
+    for (const VitalKindInfo& info : vitalKindInfos) {
+        if (tag == info.tag) { kind = info.kind; return true; }
+    }
+    return false;
+}
+inline bool vitalKindFromStorageId(long long id, VitalKind& kind) {
+    for (const VitalKindInfo& info : vitalKindInfos) {
+        if (id == info.storageId) { kind = info.kind; return true; }
+    }
+    return false;
+}
+
+// Calls fn(integral_constant<VitalKind, K>) for every listed kind, at compile time.
+template <typename Fn, VitalKind... Ks>
+void forEachVitalKind(Fn&& fn, VitalKindList<Ks...>) { (fn(integral_constant<VitalKind, Ks>{}), ...); }
+template <typename Fn>
+void forEachVitalKind(Fn&& fn) { forEachVitalKind(fn, VitalKinds{}); }
+
+
+// ------------------- Health Record (with Getters for DB) -------------------
+// Patients keep their vitals column-wise in a VitalsStore (below); a HealthRecord is
+// a facade for entering one reading or displaying one, not the storage format. It is
+// the same small value for every kind, which its VitalTraits describe.
+class HealthRecord : public Persistent {
+    VitalKind kind;
+    double value1, value2;
+    time_t timestamp;
+public:
+    HealthRecord(VitalKind k, double v1, double v2 = 0.0) : HealthRecord(k, v1, v2, time(0)) {}
+    HealthRecord(VitalKind k, double v1, double v2, time_t loaded_time)
+        : kind(k), value1(v1), value2(vitalHasSecondValue(k) ? v2 : 0.0), timestamp(loaded_time) {}
+
+    void render(RenderBuffer& out) const { // one line, newline included
+        const VitalKindInfo& info = vitalInfo(kind);
+        out.timestamp(timestamp) << " - " << info.label << ": ";
+        auto value = [&](double v) { if (info.whole) out << int(v); else out << v; };
+        value(value1);
+        if (info.values == 2) { out << "/"; value(value2); }
+        out << " " << info.unit;
+        unsigned alerts = info.alerts(value1, value2);
+        for (int a = 0; a < AlertStateCount; ++a) {
+            if (alerts & alertBit(AlertState(a))) out << "  <-- ⚠️ ALERT: " << alertWarning(AlertState(a));
+        }
+        out << '\n';
+    }
+    void display() const {
+        RenderBuffer out(256);
+        render(out);
+        out.flush();
+    }
+    VitalKind getKind() const { return kind; }
+    double getValue1() const { return value1; }
+    double getValue2() const { return value2; }
+
+    string getFormattedTimestamp() const {
+        char buffer[20];
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", localtime(&timestamp));
+        return string(buffer);
+    }
+    time_t getTimestamp() const { return timestamp; }
+};
+
+
+// ------------------- Columnar Vitals Store -------------------
+// Read-only view over a contiguous column.
+template <typename T>
+class ColumnView {
+    const T* first;
+    const T* last;
+public:
+    ColumnView(const T* b, const T* e) : first(b), last(e) {}
+    const T* begin() const { return first; }
+    const T* end() const { return last; }
+    const T* data() const { return first; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const T& operator[](size_t i) const { return first[i]; }
+    const T& back() const { return last[-1]; }
+};
+
+// --- Rollups ---
+// Local day and week boundaries for rollup buckets; weeks start on Monday. Each
+// thread keeps the local days it has worked out in a small direct-mapped table keyed
+// by day number, so a history spanning a few years computes each day once and a
+// lookup is a division and a comparison or two. localtime_r/mktime only run on a
+// miss. Days stay right across DST changes.
+struct LocalCalendar {
+    struct Day {
+        time_t start = 1, end = 0; // [start, end); empty at first
+        int weekday = 0;           // 0 = Sunday, as tm_wday
+    };
+    static constexpr time_t DaySeconds = 24 * 60 * 60;
+    static constexpr size_t CacheSlots = 1024;
+
+    static tm localParts(time_t t) {
+        tm parts{};
+#ifdef _WIN32
+        localtime_s(&parts, &t);
+#else
+        localtime_r(&t, &parts);
+#endif
+        return parts;
+    }
+    static Day computeDay(time_t t) {
+        tm d = localParts(t);
+        Day day;
+        day.weekday = d.tm_wday;
+        d.tm_hour = d.tm_min = d.tm_sec = 0;
+        d.tm_isdst = -1;
+        day.start = mktime(&d);
+        ++d.tm_mday;
+        d.tm_isdst = -1;
+        day.end = mktime(&d);
+        return day;
+    }
+    static long long dayNumber(time_t t) { return t >= 0 ? t / DaySeconds : -((-t + DaySeconds - 1) / DaySeconds); }
+    static Day& slot(Day* cache, long long number) { return cache[size_t(number) % CacheSlots]; }
+
+    // The local day containing t. Its start lies at most ~26 hours before t, so the
+    // day is filed under one of the two day numbers at or just before t's.
+    static const Day& dayOf(time_t t) {
+        thread_local Day cache[CacheSlots];
+        long long n = dayNumber(t);
+        for (long long k : {n, n - 1}) {
+            const Day& d = slot(cache, k);
+            if (t >= d.start && t < d.end) return d;
+        }
+        Day day = computeDay(t);
+        return slot(cache, dayNumber(day.start)) = day;
+    }
+
+    static time_t dayStart(time_t t) { return dayOf(t).start; }
+
+    // Days since 1970-01-01 of a proleptic Gregorian date.
+    static long long civilDay(long long y, int month, int mday) {
+        y -= month <= 2;
+        long long era = (y >= 0 ? y : y - 399) / 400;
+        long long yoe = y - era * 400;
+        long long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+        return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+    }
+    static long long civilDay(const tm& t) { return civilDay(1900LL + t.tm_year, 1 + t.tm_mon, t.tm_mday); }
+
+    // The local time `second` seconds into wall-clock day `day` (a civilDay), without
+    // mktime: on a 24-hour day it is the cached day start plus the seconds, confirmed
+    // with one localtime_r. False on the days around a DST change, or when midday UTC
+    // on the date is another local date; the caller falls back to mktime.
+    static bool quickLocalTime(long long day, int second, time_t& out) {
+        const Day& d = dayOf(time_t(day * DaySeconds + DaySeconds / 2));
+        if (d.end - d.start != DaySeconds) return false;
+        time_t t = d.start + second;
+        tm parts = localParts(t);
+        if (civilDay(parts) != day || parts.tm_hour * 3600 + parts.tm_min * 60 + parts.tm_sec != second) return false;
+        out = t;
+        return true;
+    }
+    static time_t weekStart(time_t t) {
+        const Day& d = dayOf(t);
+        int back = (d.weekday + 6) % 7;
+        // Midday `back` days earlier is on the Monday whatever DST does meanwhile.
+        return back == 0 ? d.start : dayOf(d.start - back * DaySeconds + DaySeconds / 2).start;
+    }
+};
+
+enum class RollupPeriod { Day, Week };
+
+inline const char* rollupPeriodTag(RollupPeriod p) { return p == RollupPeriod::Day ? "day" : "week"; }
+
+// Count, min, max and sum of one vital kind over one local day or week. The second
+// value (diastolic) is only meaningful for blood pressure.
+struct RollupBucket {
+    time_t start = 0;
+    uint32_t count = 0;
+    double min1 = 0, max1 = 0, sum1 = 0;
+    double min2 = 0, max2 = 0, sum2 = 0;
+
+    void add(double v1, double v2) {
+        if (count == 0) {
+            min1 = max1 = v1;
+            min2 = max2 = v2;
+        } else {
+            min1 = min(min1, v1);
+            max1 = max(max1, v1);
+            min2 = min(min2, v2);
+            max2 = max(max2, v2);
+        }
+        sum1 += v1;
+        sum2 += v2;
+        ++count;
+    }
+    double avg1() const { return count ? sum1 / count : 0.0; }
+    double avg2() const { return count ? sum2 / count : 0.0; }
+};
+
+// Daily and weekly buckets for one series, each list sorted by start. Folding in a
+// reading from the newest bucket onwards is O(1); an older one costs a binary search
+// and, for a bucket not seen before, an insert.
+class VitalRollups {
+    pmr::vector<RollupBucket> days;
+    pmr::vector<RollupBucket> weeks;
+
+    static void fold(pmr::vector<RollupBucket>& buckets, time_t start, double v1, double v2) {
+        if (buckets.empty() || buckets.back().start < start) {
+            buckets.emplace_back().start = start;
+        } else if (buckets.back().start != start) {
+            auto it = lower_bound(buckets.begin(), buckets.end(), start, [](const RollupBucket& b, time_t s) { return b.start < s; });
+            if (it->start != start) (it = buckets.emplace(it))->start = start;
+            it->add(v1, v2);
+            return;
+        }
+        buckets.back().add(v1, v2);
+    }
+
+public:
+    explicit VitalRollups(pmr::memory_resource* memory = pmr::get_default_resource()) : days(memory), weeks(memory) {}
+
+    void add(time_t ts, double v1, double v2) {
+        fold(days, LocalCalendar::dayStart(ts), v1, v2);
+        fold(weeks, LocalCalendar::weekStart(ts), v1, v2);
+    }
+    void clear() {
+        days.clear();
+        weeks.clear();
+    }
+
+    const pmr::vector<RollupBucket>& buckets(RollupPeriod p) const { return p == RollupPeriod::Day ? days : weeks; }
+    // Index range [first, second) of the buckets starting within [from, to].
+    pair<size_t, size_t> range(RollupPeriod p, time_t from, time_t to) const {
+        const auto& b = buckets(p);
+        auto byStart = [](const RollupBucket& bucket, time_t s) { return bucket.start < s; };
+        auto lo = lower_bound(b.begin(), b.end(), from, byStart);
+        auto hi = upper_bound(lo, b.end(), to, [](time_t s, const RollupBucket& bucket) { return s < bucket.start; });
+        return {size_t(lo - b.begin()), size_t(hi - b.begin())};
+    }
+
+    size_t memoryBytes() const { return (days.capacity() + weeks.capacity()) * sizeof(RollupBucket); }
+};
+
+// All readings of one vital kind as parallel columns, sorted by timestamp.
+// value2 is only populated for blood pressure (diastolic). Daily and weekly
+// rollups are kept up to date as readings are inserted.
+class VitalSeries {
+    bool twoValues;
+    pmr::vector<time_t> timestamps;
+    pmr::vector<double> value1;
+    pmr::vector<double> value2;
+    pmr::vector<long long> rowIds; // 0 for readings not yet saved; -(chunk id) for sealed ones
+    size_t unsaved = 0;
+    VitalRollups aggregates;
+
+    template <typename T>
+    static ColumnView<T> view(const pmr::vector<T>& column) { return ColumnView<T>(column.data(), column.data() + column.size()); }
+
+public:
+    explicit VitalSeries(bool hasSecondValue = false, pmr::memory_resource* memory = pmr::get_default_resource())
+        : twoValues(hasSecondValue), timestamps(memory), value1(memory), value2(memory), rowIds(memory), aggregates(memory) {}
+
+    // Appends in O(1) when readings arrive in time order (the common case),
+    // otherwise inserts at the sorted position. Returns the reading's index.
+    size_t insert(time_t ts, double v1, double v2, long long rowId) {
+        size_t at = timestamps.size();
+        if (!timestamps.empty() && ts < timestamps.back()) {
+            at = upper_bound(timestamps.begin(), timestamps.end(), ts) - timestamps.begin();
+        }
+        timestamps.insert(timestamps.begin() + at, ts);
+        value1.insert(value1.begin() + at, v1);
+        if (twoValues) value2.insert(value2.begin() + at, v2);
+        rowIds.insert(rowIds.begin() + at, rowId);
+        if (rowId == 0) ++unsaved;
+        aggregates.add(ts, v1, twoValues ? v2 : 0.0);
+        return at;
+    }
+
+    const VitalRollups& rollups() const { return aggregates; }
+    // Recomputes the rollups from the readings in one pass.
+    void rebuildRollups() {
+        aggregates.clear();
+        for (size_t i = 0; i < timestamps.size(); ++i) aggregates.add(timestamps[i], value1[i], secondAt(i));
+    }
+
+    size_t size() const { return timestamps.size(); }
+    bool empty() const { return timestamps.empty(); }
+    bool hasSecondValue() const { return twoValues; }
+    ColumnView<time_t> times() const { return view(timestamps); }
+    ColumnView<double> values1() const { return view(value1); }
+    ColumnView<double> values2() const { return view(value2); }
+    double secondAt(size_t i) const { return twoValues ? value2[i] : 0.0; }
+
+    // --- Time index ---
+    // Index range [first, second) of the readings with from <= timestamp <= to,
+    // found by binary search on the sorted timestamp column.
+    pair<size_t, size_t> range(time_t from, time_t to) const {
+        auto lo = lower_bound(timestamps.begin(), timestamps.end(), from);
+        auto hi = upper_bound(lo, timestamps.end(), to);
+        return {size_t(lo - timestamps.begin()), size_t(hi - timestamps.begin())};
+    }
+    // The newest reading is always the last slot, so "latest" is O(1).
+    bool hasLatest() const { return !timestamps.empty(); }
+    size_t latest() const { return timestamps.size() - 1; }
+
+    size_t unsavedCount() const { return unsaved; }
+    long long rowIdAt(size_t i) const { return rowIds[i]; }
+    void markSaved(size_t i, long long rowId) {
+        if (rowIds[i] == 0 && rowId != 0) --unsaved;
+        rowIds[i] = rowId;
+    }
+
+    size_t memoryBytes() const {
+        return timestamps.capacity() * sizeof(time_t) + (value1.capacity() + value2.capacity()) * sizeof(double)
+             + rowIds.capacity() * sizeof(long long) + aggregates.memoryBytes();
+    }
+};
+
+// Per-patient vitals: one series per kind, each walkable with no virtual dispatch.
+class VitalsStore {
+    array<VitalSeries, VitalKindCount> all; // indexed by VitalKind
+
+    template <size_t... I>
+    VitalsStore(pmr::memory_resource* memory, index_sequence<I...>)
+        : all{{VitalSeries(vitalKindInfos[I].values == 2, memory)...}} {}
+
+public:
+    explicit VitalsStore(pmr::memory_resource* memory = pmr::get_default_resource())
+        : VitalsStore(memory, make_index_sequence<VitalKindCount>{}) {}
+
+    VitalSeries& series(VitalKind kind) { return all[size_t(kind)]; }
+    const VitalSeries& series(VitalKind kind) const { return all[size_t(kind)]; }
+
+    size_t add(VitalKind kind, time_t ts, double v1, double v2, long long rowId = 0) {
+        return series(kind).insert(ts, v1, v2, rowId);
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const VitalSeries& s : all) n += s.size();
+        return n;
+    }
+    bool empty() const { return size() == 0; }
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const VitalSeries& s : all) bytes += s.memoryBytes();
+        return bytes;
+    }
+
+    // Builds the facade record for reading i of a series.
+    template <typename Fn>
+    static void withRecord(VitalKind kind, const VitalSeries& s, size_t i, Fn fn) {
+        fn(HealthRecord(kind, s.values1()[i], s.secondAt(i), s.times()[i]));
+    }
+
+    // Visits every reading of one kind in time order as a facade record.
+    template <typename Fn>
+    void forEachRecord(VitalKind kind, Fn fn) const {
+        const VitalSeries& s = series(kind);
+        for (size_t i = 0; i < s.size(); ++i) withRecord(kind, s, i, fn);
+    }
+
+    // Same, limited to readings with from <= timestamp <= to: O(log n + k).
+    template <typename Fn>
+    size_t forEachRecordInRange(VitalKind kind, time_t from, time_t to, Fn fn) const {
+        const VitalSeries& s = series(kind);
+        auto window = s.range(from, to);
+        for (size_t i = window.first; i < window.second; ++i) withRecord(kind, s, i, fn);
+        return window.second - window.first;
+    }
+    // The newest `count` readings of one kind, oldest first.
+    template <typename Fn>
+    size_t forEachLatestRecord(VitalKind kind, size_t count, Fn fn) const {
+        const VitalSeries& s = series(kind);
+        size_t first = s.size() > count ? s.size() - count : 0;
+        for (size_t i = first; i < s.size(); ++i) withRecord(kind, s, i, fn);
+        return s.size() - first;
+    }
+
+    // Visits every reading of every kind in time order (a merge across the kinds).
+    template <typename Fn>
+    void forEachRecord(Fn fn) const {
+        size_t next[VitalKindCount] = {};
+        while (true) {
+            int pick = -1;
+            for (size_t k = 0; k < VitalKindCount; ++k) {
+                const VitalSeries& s = all[k];
+                if (next[k] < s.size() && (pick < 0 || s.times()[next[k]] < all[pick].times()[next[pick]])) pick = int(k);
+            }
+            if (pick < 0) break;
+            withRecord(VitalKind(pick), all[pick], next[pick]++, fn);
+        }
+    }
+};
+
+// One reading from an external feed, not yet attached to a Patient object.
+struct ImportedVital {
+    long long patientId;
+    VitalKind kind;
+    time_t timestamp;
+    double value1;
+    double value2; // diastolic; unused for other kinds
+};
+
+
+// ------------------- Vitals Statistics -------------------
+// One-pass aggregates for a patient's vitals (see VitalsStats.h for the kernels).
+struct VitalsSummary {
+    ColumnStats systolic, diastolic, weight, sugar;
+    PairAlertCounts bloodPressure;
+
+    void merge(const VitalsSummary& o) {
+        systolic.merge(o.systolic);
+        diastolic.merge(o.diastolic);
+        weight.merge(o.weight);
+        sugar.merge(o.sugar);
+        bloodPressure.high += o.bloodPressure.high;
+        bloodPressure.low += o.bloodPressure.low;
+    }
+};
+
+inline VitalsSummary summarizeVitals(const VitalsStore& vitals) {
+    VitalsSummary s;
+    const VitalSeries& bp = vitals.series(VitalKind::BloodPressure);
+    const VitalSeries& w = vitals.series(VitalKind::Weight);
+    const VitalSeries& bs = vitals.series(VitalKind::BloodSugar);
+    s.systolic = columnStats(bp.values1().data(), bp.size());
+    s.diastolic = columnStats(bp.values2().data(), bp.size());
+    s.bloodPressure = bloodPressureAlerts(bp.values1().data(), bp.values2().data(), bp.size());
+    s.weight = columnStats(w.values1().data(), w.size());
+    s.sugar = columnStats(bs.values1().data(), bs.size(), SugarAlerts);
+    return s;
+}
+
+
+// ------------------- Compressed Vitals Chunks -------------------
+// Sealed readings of one patient's vital kind, stored as one BLOB in health_chunks
+// instead of a row each (see DatabaseManager::compactVitals).
+//
+// Layout (native byte order, like the snapshot; 64-bit words throughout):
+//   VitalChunkHeader
+//   per column (timestamps, value1, value2 for blood pressure):
+//     VitalChunkStream, then its packed words
+// Each column becomes a run of 64-bit integers: timestamps as they are, values as
+// fixed-point decimals when every reading has at most four decimals (as entered),
+// otherwise as raw IEEE bits. A stream stores the run itself, its deltas, or its
+// delta-of-deltas (XOR of neighbours for raw bits), whichever packs narrowest,
+// less their minimum, at one fixed bit width. Decoding is a branch-free unpack
+// followed by at most two prefix passes over flat arrays, which the compiler
+// vectorises; no varints, no per-value bit reader.
+constexpr uint32_t VitalChunkByteOrder = 0x01020304;
+constexpr size_t VitalChunkMaxReadings = 512; // keeps a chunk within one 4 KiB page
+constexpr size_t VitalChunkMinReadings = 16;  // shorter groups stay rows; a chunk would not pay for itself
+
+struct VitalChunkHeader {
+    char magic[4];      // "MVC1"
+    uint32_t byteOrder; // VitalChunkByteOrder, as written
+    uint32_t count;     // readings
+    uint32_t streams;   // 2, or 3 with a second value
+};
+struct VitalChunkStream {
+    enum Transform : uint8_t { Plain, Delta, DeltaOfDelta, Xor };
+    uint8_t transform;
+    uint8_t width;    // bits per packed residual, 0 to 64
+    uint8_t decimals; // values are integer / 10^decimals; unused for timestamps and Xor streams
+    uint8_t reserved[5];
+    uint64_t reference; // added to every unpacked residual
+    uint64_t seed[2];   // the leading values the prefix passes start from
+    // followed by packedWords() words: the residuals, then one spare for the unpack's overread
+    static size_t packedWords(size_t residuals, unsigned width) { return (residuals * width + 63) / 64 + 1; }
+};
+static_assert(sizeof(VitalChunkHeader) == 16 && sizeof(VitalChunkStream) == 32, "chunk headers have a fixed layout");
+static_assert(sizeof(time_t) == 8, "chunks store time_t as 64-bit seconds");
+
+// Decoded chunk columns; reused across chunks so decoding does not allocate.
+struct VitalChunkColumns {
+    vector<time_t> times;
+    vector<double> values1, values2; // values2 is empty for single-value kinds
+    vector<uint64_t> scratch;
+};
+
+class VitalChunkCodec {
+    static constexpr double Scales[] = {1, 10, 100, 1000, 10000};
+
+    static unsigned seeds(uint8_t transform);
+    static uint8_t bitWidth(uint64_t range);
+
+    // The residuals of x under a transform. All arithmetic wraps, so it is exact for
+    // any 64-bit input.
+    static void residuals(const uint64_t* x, size_t n, uint8_t transform, vector<uint64_t>& r);
+
+    // Appends one stream for x, choosing among `transforms` the one that packs smallest.
+    static void appendStream(string& out, const uint64_t* x, size_t n, initializer_list<uint8_t> transforms, uint8_t decimals);
+
+    // The fewest decimals (up to four) that represent every value exactly, or -1.
+    static int decimalsFor(const double* v, size_t n);
+
+    static void appendValues(string& out, const double* v, size_t n, vector<uint64_t>& x);
+
+    // Reads the stream at p into x[0, n) and advances p; false if it is malformed.
+    static bool readStream(const char*& p, const char* end, size_t n, uint64_t* x, uint8_t& decimals);
+
+    static bool readValues(const char*& p, const char* end, VitalChunkColumns& c, vector<double>& out);
+
+public:
+    // Encodes n readings, timestamps ascending; v2 is null for single-value kinds.
+    static string encode(const time_t* times, const double* v1, const double* v2, size_t n);
+
+    // Decodes a chunk into c (replacing its contents); false if it is not one.
+    static bool decode(const void* data, size_t bytes, VitalChunkColumns& c);
+};
+
+
+// ------------------- Shared Memory for Patient Data -------------------
+// Medication names, dosages, schedules and reminder texts repeat across patients
+// ("Twice a day"), so each distinct string is stored once, in large blocks kept
+// until exit, and the objects hold views into the pool.
+class StringPool {
+    mutex lock;
+    pmr::monotonic_buffer_resource storage{64 * 1024};
+    unordered_set<string_view> strings;
+public:
+    static StringPool& shared() {
+        static StringPool pool;
+        return pool;
+    }
+
+    string_view intern(string_view text) {
+        if (text.empty()) return string_view("", 0);
+        lock_guard<mutex> guard(lock);
+        auto it = strings.find(text);
+        if (it != strings.end()) return *it;
+        char* copy = (char*)storage.allocate(text.size(), 1);
+        memcpy(copy, text.data(), text.size());
+        return *strings.insert(string_view(copy, text.size())).first;
+    }
+};
+
+// One pool for every patient's vitals columns and medication/reminder vectors:
+// loading then takes a few large chunks from the heap instead of one block per
+// vector and per growth step, and teardown hands them back together. Pools are
+// not thread-safe: patients are changed on the main thread only, and each
+// parallel loader thread builds its patients in a pool of its own (newPool).
+class PatientArena {
+    static constexpr pmr::pool_options Options{0, 256 * 1024};
+    list<pmr::unsynchronized_pool_resource> pools; // list: pools never move
+public:
+    PatientArena() { pools.emplace_back(Options); }
+    pmr::memory_resource* resource() { return &pools.front(); }
+    pmr::memory_resource* newPool() {
+        pools.emplace_back(Options);
+        return &pools.back();
+    }
+};
+
+
+// ------------------- Medication & Reminder Classes (with Getters for DB) -------------------
+class Medication : public Persistent {
+    string_view name, dosage, schedule; // interned
+public:
+    Medication(string_view n, string_view d, string_view s)
+        : name(StringPool::shared().intern(n)), dosage(StringPool::shared().intern(d)), schedule(StringPool::shared().intern(s)) {}
+    void render(RenderBuffer& out) const { out << "Medication: " << name << " | Dosage: " << dosage << " | Schedule: " << schedule << '\n'; }
+    void display() const {
+        RenderBuffer out(256);
+        render(out);
+        out.flush();
+    }
+    string_view getName() const { return name; }
+    string_view getDosage() const { return dosage; }
+    string_view getSchedule() const { return schedule; }
+};
+
+enum class ReminderFrequency { Once, Daily, Weekly };
+
+inline const char* frequencyTag(ReminderFrequency f) {
+    switch (f) {
+        case ReminderFrequency::Daily: return "daily";
+        case ReminderFrequency::Weekly: return "weekly";
+        default: return "once";
+    }
+}
+inline ReminderFrequency parseFrequency(string_view tag) {
+    if (tag == "daily") return ReminderFrequency::Daily;
+    if (tag == "weekly") return ReminderFrequency::Weekly;
+    return ReminderFrequency::Once;
+}
+
+// A reminder date or time as text, without touching the heap: either formatted into
+// the inline buffer from the compact encoding, or a view of the interned raw text.
+class ReminderText {
+    string_view raw;
+    char formatted[10];
+    int length = -1; // -1 while `raw` is the text
+
+    static void digits(char* out, int value, int count) {
+        for (int i = count - 1; i >= 0; --i, value /= 10) out[i] = char('0' + value % 10);
+    }
+
+public:
+    static ReminderText ofRaw(string_view text) {
+        ReminderText t;
+        t.raw = text;
+        return t;
+    }
+    static ReminderText ofDate(int32_t yyyymmdd) { // "YYYY-MM-DD"
+        ReminderText t;
+        digits(t.formatted, yyyymmdd / 10000, 4);
+        t.formatted[4] = '-';
+        digits(t.formatted + 5, yyyymmdd / 100 % 100, 2);
+        t.formatted[7] = '-';
+        digits(t.formatted + 8, yyyymmdd % 100, 2);
+        t.length = 10;
+        return t;
+    }
+    static ReminderText ofTime(int minutes) { // "HH:MM"
+        ReminderText t;
+        digits(t.formatted, minutes / 60, 2);
+        t.formatted[2] = ':';
+        digits(t.formatted + 3, minutes % 60, 2);
+        t.length = 5;
+        return t;
+    }
+
+    string_view view() const { return length < 0 ? raw : string_view(formatted, length); }
+    operator string_view() const { return view(); }
+};
+inline ostream& operator<<(ostream& out, const ReminderText& text) { return out << text.view(); }
+
+// The date and time are kept as integers (yyyymmdd and minutes past midnight), so
+// due checks are integer compares. Text that does not parse as a date or time is
+// kept verbatim instead (interned), so nothing the user typed is lost.
+class Reminder : public Persistent {
+    string_view message;          // interned
+    string_view rawDate, rawTime; // interned; only set when the text did not parse
+    int32_t dateKey = 0;          // yyyymmdd, 0 when unparsed
+    int16_t minuteOfDay = -1;     // -1 when unparsed
+    ReminderFrequency frequency;
+
+    // Splits "a<sep>b[<sep>c]" into exactly `count` integers.
+    static bool parseFields(string_view text, char sep, int* out, int count) {
+        for (int i = 0; i < count; ++i) {
+            size_t end = i + 1 < count ? text.find(sep) : text.size();
+            if (end == string_view::npos || end == 0) return false;
+            auto result = from_chars(text.data(), text.data() + end, out[i]);
+            if (result.ec != errc() || result.ptr != text.data() + end) return false;
+            text.remove_prefix(i + 1 < count ? end + 1 : end);
+        }
+        return true;
+    }
+    static int32_t encodeDate(string_view text) {
+        int f[3];
+        if (!parseFields(text, '-', f, 3) || f[0] < 1 || f[0] > 9999 || f[1] < 1 || f[1] > 12 || f[2] < 1 || f[2] > 31) return 0;
+        return f[0] * 10000 + f[1] * 100 + f[2];
+    }
+    static int16_t encodeTime(string_view text) {
+        int f[2];
+        if (!parseFields(text, ':', f, 2) || f[0] < 0 || f[0] > 23 || f[1] < 0 || f[1] > 59) return -1;
+        return int16_t(f[0] * 60 + f[1]);
+    }
+
+public:
+    Reminder(string_view m, string_view d, string_view t, ReminderFrequency f = ReminderFrequency::Once)
+        : message(StringPool::shared().intern(m)), dateKey(encodeDate(d)), minuteOfDay(encodeTime(t)), frequency(f) {
+        if (dateKey == 0) rawDate = StringPool::shared().intern(d);
+        if (minuteOfDay < 0) rawTime = StringPool::shared().intern(t);
+    }
+    bool isDue() const {
+        time_t now = time(0);
+        tm *ltm = localtime(&now);
+        if (dateKey != 0 && minuteOfDay >= 0) {
+            int32_t today = (1900 + ltm->tm_year) * 10000 + (1 + ltm->tm_mon) * 100 + ltm->tm_mday;
+            return dateKey == today && minuteOfDay <= ltm->tm_hour * 60 + ltm->tm_min;
+        }
+        char todayDate[40], currentTime[24];
+        snprintf(todayDate, sizeof(todayDate), "%04d-%02d-%02d", 1900 + ltm->tm_year, 1 + ltm->tm_mon, ltm->tm_mday);
+        snprintf(currentTime, sizeof(currentTime), "%02d:%02d", ltm->tm_hour, ltm->tm_min);
+        return (getDate().view() == todayDate && getTime().view() <= currentTime);
+    }
+    void render(RenderBuffer& out) const {
+        out << "Reminder: " << message << " on " << getDate().view() << " at " << getTime().view();
+        if (frequency != ReminderFrequency::Once) out << " (" << frequencyTag(frequency) << ")";
+        out << '\n';
+    }
+    void display() const {
+        RenderBuffer out(256);
+        render(out);
+        out.flush();
+    }
+    string_view getMessage() const { return message; }
+    ReminderText getDate() const { return dateKey == 0 ? ReminderText::ofRaw(rawDate) : ReminderText::ofDate(dateKey); }
+    ReminderText getTime() const { return minuteOfDay < 0 ? ReminderText::ofRaw(rawTime) : ReminderText::ofTime(minuteOfDay); }
+    ReminderFrequency getFrequency() const { return frequency; }
+
+    // Whether the first occurrence is before the local date `today` (YYYYMMDD) at
+    // `minute` past midnight; false when the date or time did not parse. Needs no
+    // time zone lookups, so report threads can call it.
+    bool startsBefore(int32_t today, int minute) const {
+        if (dateKey == 0 || minuteOfDay < 0) return false;
+        return dateKey != today ? dateKey < today : minuteOfDay < minute;
+    }
+
+    // The first occurrence (date + reminderTime, local time) as epoch seconds.
+    bool firstOccurrence(time_t& out) const {
+        if (dateKey == 0 || minuteOfDay < 0) return false;
+        long long day = LocalCalendar::civilDay(dateKey / 10000, dateKey / 100 % 100, dateKey % 100);
+        if (LocalCalendar::quickLocalTime(day, minuteOfDay * 60, out)) return true;
+        tm t = {};
+        t.tm_year = dateKey / 10000 - 1900;
+        t.tm_mon = dateKey / 100 % 100 - 1;
+        t.tm_mday = dateKey % 100;
+        t.tm_hour = minuteOfDay / 60;
+        t.tm_min = minuteOfDay % 60;
+        t.tm_isdst = -1;
+        out = mktime(&t);
+        return out != (time_t)-1;
+    }
+};
+
+
+// ------------------- Patient Change Notifications -------------------
+// Observers see every reading entering a patient, whether typed in by the user or
+// read back from the database (rowId != 0), so derived state can be kept up to date
+// at ingest time instead of by rescanning history.
+class PatientObserver {
+public:
+    virtual ~PatientObserver() = default;
+    virtual void onPatientCreated(const Patient& /*patient*/) {}
+    virtual void onVitalAdded(const Patient& /*patient*/, VitalKind /*kind*/, const VitalSeries& /*series*/, size_t /*index*/) {}
+    virtual void onMedicationAdded(const Patient& /*patient*/, const Medication& /*medication*/) {}
+    virtual void onReminderAdded(const Patient& /*patient*/, const Reminder& /*reminder*/) {}
+    virtual void onPatientDestroyed(const Patient& /*patient*/) {}
+};
+
+
+// ------------------- Patient Class -------------------
+class Patient : public Persistent {
+    string name;
+    int age;
+    string contactInfo;
+    pmr::memory_resource* memory; // backs vitals, medications and reminders (see PatientArena)
+    VitalsStore vitals;
+    pmr::vector<Medication> medications;
+    pmr::vector<Reminder> reminders;
+    bool historyDirty = false; // set when a record/medication/reminder is added or changed
+    bool historyLoaded = true; // false while a lazy-mode patient holds only its summary row
+    HistoryCache* historyCache = nullptr;
+public:
+    static vector<PatientObserver*>& observers() {
+        static vector<PatientObserver*> registered;
+        return registered;
+    }
+
+public:
+    Patient(string n, int a, string c, pmr::memory_resource* mem = pmr::get_default_resource())
+        : name(move(n)), age(a), contactInfo(move(c)), memory(mem), vitals(mem), medications(mem), reminders(mem) {}
+    Patient(const Patient&) = delete;
+    Patient& operator=(const Patient&) = delete;
+    ~Patient() { for (PatientObserver* o : observers()) o->onPatientDestroyed(*this); }
+
+    static void addObserver(PatientObserver* o) { observers().push_back(o); }
+    static void removeObserver(PatientObserver* o) {
+        auto& list = observers();
+        list.erase(remove(list.begin(), list.end(), o), list.end());
+    }
+
+    void addVital(VitalKind kind, time_t ts, double v1, double v2 = 0.0, long long rowId = 0) {
+        ensureHistory();
+        size_t at = vitals.add(kind, ts, v1, v2, rowId);
+        if (rowId == 0) historyDirty = true;
+        const VitalSeries& s = vitals.series(kind);
+        for (PatientObserver* o : observers()) o->onVitalAdded(*this, kind, s, at);
+    }
+    void addRecord(const HealthRecord& r) { addVital(r.getKind(), r.getTimestamp(), r.getValue1(), r.getValue2(), r.getRowId()); }
+    // The emplace variants build the object in place from its constructor arguments.
+    template <typename... Args>
+    Medication& emplaceMedication(Args&&... args) {
+        ensureHistory();
+        historyDirty = true;
+        Medication& added = medications.emplace_back(forward<Args>(args)...);
+        for (PatientObserver* o : observers()) o->onMedicationAdded(*this, added);
+        return added;
+    }
+    template <typename... Args>
+    Reminder& emplaceReminder(Args&&... args) {
+        ensureHistory();
+        historyDirty = true;
+        Reminder& added = reminders.emplace_back(forward<Args>(args)...);
+        for (PatientObserver* o : observers()) o->onReminderAdded(*this, added);
+        return added;
+    }
+    void addMedication(const Medication& m) { emplaceMedication(m); }
+    void addReminder(const Reminder& r) { emplaceReminder(r); }
+
+    // Tells the observers about a patient entered in this session; loaders never call it.
+    void announceCreated() const {
+        for (PatientObserver* o : observers()) o->onPatientCreated(*this);
+    }
+
+    // Replays every loaded reading, medication and reminder to the observers, for loaders that
+    // filled the patient without notifying them (the parallel loader's threads).
+    void announceHistory() const {
+        for (PatientObserver* o : observers()) {
+            for (VitalKind kind : allVitalKinds) {
+                const VitalSeries& s = vitals.series(kind);
+                for (size_t i = 0; i < s.size(); ++i) o->onVitalAdded(*this, kind, s, i);
+            }
+            for (const Medication& m : medications) o->onMedicationAdded(*this, m);
+            for (const Reminder& r : reminders) o->onReminderAdded(*this, r);
+        }
+    }
+
+    void calculateAndDisplayBMI() const;
+    void displayHealthTrend() const;
+    void displayRollups(VitalKind kind, RollupPeriod period) const;
+    void display() const;
+    void checkReminders() const;
+    void displayVitalsStatistics() const;
+
+    const string& getName() const { return name; }
+    int getAge() const { return age; }
+    const string& getContact() const { return contactInfo; }
+    const VitalsStore& getVitals() const { return vitals; }
+    VitalsStore& getVitals() { return vitals; }
+    const pmr::vector<Medication>& getMedications() const { return medications; }
+    const pmr::vector<Reminder>& getReminders() const { return reminders; }
+    pmr::vector<Medication>& getMedications() { return medications; }
+    pmr::vector<Reminder>& getReminders() { return reminders; }
+
+    // True when this patient or anything it owns has to be written on the next save.
+    bool hasUnsavedChanges() const { return isNew() || isDirty() || historyDirty; }
+    bool hasUnsavedHistory() const { return historyDirty; }
+    void markHistorySaved() { historyDirty = false; }
+
+    // --- Lazy hydration ---
+    // Patients attached to a HistoryCache start with only their summary row and
+    // fetch records, medications and reminders the first time something needs them.
+    void attachHistoryCache(HistoryCache* cache) { historyCache = cache; historyLoaded = false; }
+    void ensureHistory() const;
+    bool isHistoryLoaded() const { return historyLoaded; }
+    void setHistoryLoaded(bool loaded) { historyLoaded = loaded; }
+    void releaseHistory() {
+        vitals = VitalsStore(memory);
+        pmr::vector<Medication>(memory).swap(medications);
+        pmr::vector<Reminder>(memory).swap(reminders);
+        historyLoaded = false;
+    }
+    // Rough heap footprint of the loaded history, used for the cache budget.
+    // Medication and reminder text lives in the shared StringPool and is not counted.
+    size_t historyBytes() const {
+        return vitals.memoryBytes() + medications.capacity() * sizeof(Medication) + reminders.capacity() * sizeof(Reminder);
+    }
+};
+
+
+// ------------------- Alert Engine -------------------
+struct VitalReading {
+    time_t timestamp;
+    double value1, value2;
+};
+
+// A rule decides which alert states the newest reading of one kind puts a patient
+// in. It also gets the reading before it, so rate-of-change rules fit the same shape.
+class VitalRule {
+public:
+    virtual ~VitalRule() = default;
+    virtual VitalKind kind() const = 0;
+    virtual unsigned evaluate(const VitalReading& latest, const VitalReading* previous) const = 0;
+};
+
+// The same thresholds the record displays flag, for one kind.
+template <VitalKind K>
+class ThresholdRule : public VitalRule {
+public:
+    VitalKind kind() const override { return K; }
+    unsigned evaluate(const VitalReading& r, const VitalReading*) const override {
+        return VitalTraits<K>::alerts(r.value1, r.value2);
+    }
+};
+
+// Keeps each patient's alert state current as readings arrive, plus one set of
+// patients per state, so "who is alerting" is answered without touching history.
+// A patient is in a state while the latest reading of that kind triggers it.
+class AlertEngine : public PatientObserver {
+    vector<unique_ptr<VitalRule>> rules;
+    unordered_map<const Patient*, array<unsigned, VitalKindCount>> perKind;
+    unordered_set<const Patient*> inState[AlertStateCount];
+    unordered_set<const Patient*> alerting;
+
+    void apply(const Patient& patient, VitalKind kind, unsigned bits);
+
+public:
+    AlertEngine();
+    ~AlertEngine() override { Patient::removeObserver(this); }
+    AlertEngine(const AlertEngine&) = delete;
+    AlertEngine& operator=(const AlertEngine&) = delete;
+
+    void addRule(unique_ptr<VitalRule> rule) { rules.push_back(move(rule)); }
+
+    // Re-evaluates a kind given its latest (and previous) reading. O(number of rules).
+    void evaluate(const Patient& patient, VitalKind kind, const VitalReading& latest, const VitalReading* previous);
+
+    void onVitalAdded(const Patient& patient, VitalKind kind, const VitalSeries& s, size_t index) override;
+
+    void onPatientDestroyed(const Patient& patient) override;
+
+    // O(1) to obtain; iterating is O(result size).
+    const unordered_set<const Patient*>& patientsIn(AlertState state) const { return inState[int(state)]; }
+    const unordered_set<const Patient*>& alertingPatients() const { return alerting; }
+};
+
+
+// ------------------- Reminder Scheduler -------------------
+// A min-heap of upcoming reminder occurrences across all patients. date/time are
+// parsed to epoch seconds once, when a reminder is armed. A background thread sleeps
+// until the earliest one is due. Firing costs O(log n), and recurring reminders go
+// straight back on the heap with their next occurrence.
+class ReminderScheduler : public PatientObserver {
+    struct Entry {
+        string_view patientName; // interned
+        Reminder reminder;
+    };
+    using Slot = pair<time_t, size_t>; // (due time, index into entries)
+
+    vector<Entry> entries;
+    priority_queue<Slot, vector<Slot>, greater<Slot>> upcoming;
+    mutable mutex lock;
+    condition_variable wake;
+    thread worker;
+    bool stopping = false;
+
+    // Same wall-clock time `days` later (mktime keeps it right across DST changes).
+    static time_t addDays(time_t t, int days);
+    static int periodDays(ReminderFrequency f);
+
+    // Pushes the first occurrence that is still relevant: one falling today or later.
+    // Like Reminder::isDue, an occurrence earlier today still counts as due.
+    void arm(Entry entry, time_t now);
+
+    // Pops everything due at `now`, re-arming recurring entries. Caller holds the lock.
+    vector<const Entry*> popDue(time_t now);
+
+    static void announce(const Entry& e);
+
+    void run();
+
+public:
+    ReminderScheduler() { Patient::addObserver(this); }
+    ~ReminderScheduler() override;
+    ReminderScheduler(const ReminderScheduler&) = delete;
+    ReminderScheduler& operator=(const ReminderScheduler&) = delete;
+
+    void schedule(string_view patientName, const Reminder& reminder);
+
+    // New reminders entered by the user; reloaded ones are armed from the database.
+    void onReminderAdded(const Patient& patient, const Reminder& reminder) override;
+
+    // Prints everything already due and returns how many fired.
+    size_t fireDue();
+
+    size_t pending() const;
+
+    void start();
+    void stop();
+};
+
+
+// ------------------- Patient Search Index -------------------
+// Finds patients by the start of any word of their name (case-insensitive) or by
+// contact number, without scanning the patient list. Names and contacts are folded
+// into one text buffer. Every name word start is a key in one sorted array, searched
+// with lower_bound; every contact is a key in another, searched with equal_range.
+// Contacts are reduced to their digits first. Keys hold positions in the patients
+// vector, so building the index allocates nothing per patient. It is rebuilt after
+// loading and follows new patients through onPatientCreated; patients are never
+// removed during a session.
+class PatientIndex : public PatientObserver {
+    struct Key {
+        uint64_t head;           // first 8 bytes of the text, big-endian: most comparisons stop here
+        uint32_t offset, length; // into folded
+        uint32_t position;       // into patients
+    };
+    const vector<unique_ptr<Patient>>& patients;
+    string folded;
+    vector<Key> names;    // one per word of each name, sorted by text
+    vector<Key> contacts; // one per patient, sorted by text
+
+    string_view text(const Key& k) const { return string_view(folded).substr(k.offset, k.length); }
+    static uint64_t headOf(string_view s);
+    static char foldChar(char c) { return char(tolower((unsigned char)c)); }
+    // "+1 (555) 010-2030" and "15550102030" are the same number; contacts without
+    // digits (an e-mail address, say) are matched as folded text.
+    static void appendContactKey(string_view contact, string& out);
+    bool keyLess(const Key& a, const Key& b) const;
+    // Lower bound of `q` among keys sorted by text.
+    vector<Key>::const_iterator seek(const vector<Key>& keys, string_view q) const;
+
+    // Adds the patient's keys unsorted; the caller restores the order.
+    void appendKeys(uint32_t position, vector<Key>& nameKeys, vector<Key>& contactKeys);
+    void sortKeys(vector<Key>& keys) const;
+    void insertSorted(vector<Key>& keys, const Key& k) const;
+
+public:
+    explicit PatientIndex(const vector<unique_ptr<Patient>>& all) : patients(all) { Patient::addObserver(this); }
+    ~PatientIndex() override { Patient::removeObserver(this); }
+    PatientIndex(const PatientIndex&) = delete;
+    PatientIndex& operator=(const PatientIndex&) = delete;
+
+    void rebuild();
+
+    // New patients are pushed onto the vector before they are announced.
+    void onPatientCreated(const Patient& patient) override;
+
+    // Patients with a name word starting with `prefix`, in name order, at most `limit`.
+    vector<Patient*> findByNamePrefix(string_view prefix, size_t limit) const;
+
+    vector<Patient*> findByContact(string_view contact) const;
+};
+
+
+// ------------------- Concurrent Patient Registry -------------------
+// Append-only list with one writer and any number of readers, the way patient sets
+// grow here (patients are never removed during a session). Entries live in fixed
+// blocks that never move; the writer stores the entry, then publishes the new size,
+// so a reader that loads the size sees every entry below it, without a lock.
+template <typename T>
+class PublishedList {
+    static constexpr size_t BlockBits = 12, BlockSize = size_t(1) << BlockBits, MaxBlocks = 1024;
+    unique_ptr<atomic<T*>[]> blocks[MaxBlocks];
+    atomic<size_t> count{0};
+
+public:
+    static constexpr size_t Capacity = BlockSize * MaxBlocks;
+
+    size_t size() const { return count.load(memory_order_acquire); }
+    T* operator[](size_t i) const { return blocks[i >> BlockBits][i & (BlockSize - 1)].load(memory_order_relaxed); }
+
+    // Writer only. False once Capacity entries are in.
+    bool push_back(T* value) {
+        size_t n = count.load(memory_order_relaxed);
+        if (n == Capacity) return false;
+        auto& block = blocks[n >> BlockBits];
+        if (!block) block.reset(new atomic<T*>[BlockSize]);
+        block[n & (BlockSize - 1)].store(value, memory_order_relaxed);
+        count.store(n + 1, memory_order_release);
+        return true;
+    }
+};
+
+// The patient set, shared between the console and threads that read it (reports,
+// reminder checks, alert queries). One thread owns the registry, the console's:
+// only it adds patients or changes them, and it reads them without locking.
+// Other threads read through read/forEach/forEachInShard.
+//
+// Each patient belongs to one of ShardCount shards, picked from its identity (its
+// row id changes when a new patient is first saved, so that cannot be the key). A
+// shard is a reader-writer lock and the list of its patients. The owner takes one
+// shard exclusively to change a patient, and readers of the other shards carry on;
+// readers take shards shared, so they never wait on each other. Membership is
+// published through PublishedList, so adding a patient does not stop readers either.
+//
+// In lazy mode only histories already in memory are visible to other threads; the
+// owner hydrates patients (see HistoryCache, which takes the patient's shard).
+class PatientRegistry {
+public:
+    static constexpr size_t ShardCount = 16;
+
+private:
+    struct alignas(64) Shard {
+        mutable shared_mutex lock;
+        atomic<int> editsWaiting{0};
+        PublishedList<Patient> members;
+
+        // shared_mutex may prefer readers, and a shard under constant reading would
+        // then starve the console; readers step aside while an edit is waiting.
+        shared_lock<shared_mutex> lockShared() const {
+            while (editsWaiting.load(memory_order_acquire) != 0) this_thread::yield();
+            return shared_lock<shared_mutex>(lock);
+        }
+        unique_lock<shared_mutex> lockExclusive() {
+            editsWaiting.fetch_add(1, memory_order_acq_rel);
+            unique_lock<shared_mutex> guard(lock);
+            editsWaiting.fetch_sub(1, memory_order_release);
+            return guard;
+        }
+    };
+    vector<unique_ptr<Patient>> owned; // registration order; owner thread only
+    PublishedList<Patient> all;
+    array<Shard, ShardCount> shards;
+
+    // What this thread holds through edit or editAll: a shard index, ShardCount for
+    // every shard, and a null registry outside any edit (held starts zeroed).
+    struct Held {
+        const PatientRegistry* registry;
+        size_t shard;
+    };
+    static inline thread_local Held held;
+    // Records a hold for the duration of an edit, restoring the previous one after.
+    class HoldScope {
+        Held previous;
+    public:
+        HoldScope(const PatientRegistry* r, size_t shard) : previous(held) { held = {r, shard}; }
+        ~HoldScope() { held = previous; }
+        HoldScope(const HoldScope&) = delete;
+        HoldScope& operator=(const HoldScope&) = delete;
+    };
+
+    void publish(Patient* patient);
+
+public:
+    PatientRegistry() = default;
+    PatientRegistry(const PatientRegistry&) = delete;
+    PatientRegistry& operator=(const PatientRegistry&) = delete;
+
+    static size_t shardOf(const Patient* patient);
+
+    // --- Owner thread ---
+    // The patients in registration order, for the console (listing, selection, the
+    // search index and saves).
+    vector<unique_ptr<Patient>>& patients() { return owned; }
+    const vector<unique_ptr<Patient>>& patients() const { return owned; }
+
+    Patient& add(unique_ptr<Patient> patient);
+    // Takes over everything a loader produced, in order.
+    void adopt(vector<unique_ptr<Patient>>& loaded);
+
+    // Runs fn(patient) holding the patient's shard exclusively: readers of that shard
+    // wait, readers of every other shard do not.
+    // The shard lock is not recursive: fn must not edit again (see holdsExclusive).
+    template <typename Fn>
+    decltype(auto) edit(Patient& patient, Fn fn) {
+        size_t shard = shardOf(&patient);
+        unique_lock<shared_mutex> guard = shards[shard].lockExclusive();
+        HoldScope hold(this, shard);
+        return fn(patient);
+    }
+    // Runs fn() with every shard held exclusively, for changes spread over the whole
+    // set (the final save). Shards are taken in order, so this cannot deadlock with edit.
+    template <typename Fn>
+    decltype(auto) editAll(Fn fn) {
+        array<unique_lock<shared_mutex>, ShardCount> guards;
+        for (size_t s = 0; s < ShardCount; ++s) guards[s] = shards[s].lockExclusive();
+        HoldScope hold(this, ShardCount);
+        return fn();
+    }
+    // Whether this thread is inside edit or editAll, and whether that holds the
+    // patient's shard. Code that can run from within fn checks these before editing.
+    bool editing() const { return held.registry == this; }
+    bool holdsExclusive(const Patient& patient) const {
+        return editing() && (held.shard == ShardCount || held.shard == shardOf(&patient));
+    }
+
+    // --- Any thread ---
+    size_t size() const { return all.size(); }
+
+    // Runs fn(const Patient&) holding the patient's shard shared.
+    template <typename Fn>
+    decltype(auto) read(const Patient& patient, Fn fn) const {
+        shared_lock<shared_mutex> guard = shards[shardOf(&patient)].lockShared();
+        return fn(patient);
+    }
+    // Visits every patient in registration order, each under its shard's shared lock.
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (size_t i = 0, n = all.size(); i < n; ++i) read(*all[i], fn);
+    }
+    // Visits the patients at registration positions [first, last), each under its
+    // shard's shared lock.
+    template <typename Fn>
+    void forRange(size_t first, size_t last, Fn fn) const {
+        for (size_t i = first, n = min(last, all.size()); i < n; ++i) read(*all[i], fn);
+    }
+    // Visits one shard's patients under a single shared lock: the unit of work for
+    // readers that split the set between threads.
+    template <typename Fn>
+    void forEachInShard(size_t shard, Fn fn) const {
+        const Shard& s = shards[shard];
+        shared_lock<shared_mutex> guard = s.lockShared();
+        for (size_t i = 0, n = s.members.size(); i < n; ++i) fn(static_cast<const Patient&>(*s.members[i]));
+    }
+};
+
+
+// ------------------- Database Metrics -------------------
+// Counters and timers for the storage tier. They are process-wide, so the loader
+// threads and the background writer add to the same totals as the main connection.
+// Nothing is recorded until DbMetrics::enable(); until then an instrumented call
+// costs one relaxed load and a branch. Once enabled, a timed call adds two clock
+// reads and a few relaxed atomic adds, and SQLite's own memory accounting is on.
+
+// A small JSON builder, for the metrics dump and meditrack_bench's report. Compact
+// output (no line breaks) is one JSON value per line, for batch mode.
+class JsonWriter {
+    string out;
+    vector<bool> firstInScope;
+    bool compact;
+
+    void separate();
+    void key(const char* k);
+    void open(const char* k, char bracket);
+    void close(char bracket);
+
+public:
+    explicit JsonWriter(bool compactOutput = false) : compact(compactOutput) {}
+
+    JsonWriter& beginObject(const char* k = nullptr) { open(k, '{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray(const char* k) { open(k, '['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+    JsonWriter& field(const char* k, double v);
+    JsonWriter& field(const char* k, uint64_t v);
+    // Not an overload of field(): a string literal would convert to bool first.
+    JsonWriter& flag(const char* k, bool v);
+    JsonWriter& field(const char* k, string_view v);
+    // Writes v as it is; it must already be valid JSON.
+    JsonWriter& raw(const char* k, string_view v);
+    const string& text() const { return out; }
+};
+
+// Calls, rows and wall time of one kind of operation.
+struct OperationStats {
+    atomic<uint64_t> calls{0}, rows{0}, totalNs{0}, maxNs{0};
+
+    void record(uint64_t ns, uint64_t rowCount) {
+        calls.fetch_add(1, memory_order_relaxed);
+        rows.fetch_add(rowCount, memory_order_relaxed);
+        totalNs.fetch_add(ns, memory_order_relaxed);
+        uint64_t seen = maxNs.load(memory_order_relaxed);
+        while (ns > seen && !maxNs.compare_exchange_weak(seen, ns, memory_order_relaxed)) {}
+    }
+    void write(JsonWriter& json, const char* name) const {
+        uint64_t n = calls.load(memory_order_relaxed), total = totalNs.load(memory_order_relaxed);
+        json.beginObject(name);
+        json.field("calls", n);
+        json.field("rows", rows.load(memory_order_relaxed));
+        json.field("total_ms", total / 1e6);
+        json.field("avg_us", n ? total / 1e3 / n : 0.0);
+        json.field("max_us", maxNs.load(memory_order_relaxed) / 1e3);
+        json.endObject();
+    }
+    void render(RenderBuffer& out, string_view name) const {
+        uint64_t n = calls.load(memory_order_relaxed);
+        if (n == 0) return;
+        uint64_t total = totalNs.load(memory_order_relaxed);
+        char line[160];
+        snprintf(line, sizeof(line), "  %-24.*s %8llu calls %10llu rows %10.2f ms total %10.1f us avg %10.1f us max\n",
+                 int(name.size()), name.data(), (unsigned long long)n, (unsigned long long)rows.load(memory_order_relaxed),
+                 total / 1e6, total / 1e3 / n, maxNs.load(memory_order_relaxed) / 1e3);
+        out << line;
+    }
+};
+
+// Wall time of each startup phase, in ms from the start of main() (the first call to
+// global()), and when the menu became usable. Phases may overlap and be timed on any
+// thread. Recorded whether or not metrics are on: --trace-startup prints them and the
+// metrics JSON carries them, so time to interactive can be tracked across releases.
+class StartupTrace {
+    using Clock = chrono::steady_clock;
+    struct Phase {
+        const char* name;
+        double startMs, ms;
+    };
+    Clock::time_point origin = Clock::now();
+    mutable mutex lock;
+    vector<Phase> phases;
+    double readyMs = -1;
+
+    double msSince(Clock::time_point from, Clock::time_point to) const;
+
+public:
+    static StartupTrace& global();
+
+    // Times `name` from construction to destruction.
+    class Scope {
+        StartupTrace& trace;
+        const char* name;
+        Clock::time_point start = Clock::now();
+    public:
+        Scope(StartupTrace& t, const char* phaseName) : trace(t), name(phaseName) {}
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() { trace.record(name, start, Clock::now()); }
+    };
+    Scope phase(const char* name) { return Scope(*this, name); }
+
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+    // The menu is up; only the first call counts.
+    void markReady();
+    double timeToInteractiveMs() const;
+
+    void write(JsonWriter& json, const char* name) const;
+    void render(RenderBuffer& out) const;
+};
+
+// The public DatabaseManager calls that are timed individually.
+enum class DbOperation {
+    Open, CreateTables, SaveAllPatients, ApplyWrites, InsertVitalBatch, LoadPatients, LoadPatientsParallel,
+    LoadPatientRange, LoadPatientSummaries, LoadHistory, LoadVitalsInRange, ForEachLatestVitals, ForEachReminder,
+    LoadRollups, RebuildRollups, CompactVitals, ForEachChange, PruneChanges, Count
+};
+
+inline const char* dbOperationName(DbOperation op) {
+    static const char* names[] = {"open", "createTables", "saveAllPatients", "applyWrites", "insertVitalBatch",
+                                  "loadPatients", "loadPatientsParallel", "loadPatientRange", "loadPatientSummaries",
+                                  "loadHistory", "loadVitalsInRange", "forEachLatestVitals", "forEachReminder",
+                                  "loadRollups", "rebuildRollups", "compactVitals", "forEachChange", "pruneChanges"};
+    return names[int(op)];
+}
+
+class DbMetrics {
+    atomic<bool> on{false};
+    array<OperationStats, size_t(DbOperation::Count)> operations;
+    mutable mutex actionLock; // menu actions are looked up by name, at human speed
+    map<string, OperationStats, less<>> actions;
+    mutable mutex errorLock;
+    string lastError;
+
+public:
+    // Statement level, across all operations. Step rows are the SQLITE_ROW results.
+    OperationStats prepares, steps, finalizes, transactions;
+    atomic<uint64_t> rollbacks{0}, busyRetries{0}, stepErrors{0};
+    // Page cache counters, folded in from each connection as its operations finish.
+    atomic<uint64_t> cacheHits{0}, cacheMisses{0}, cacheWrites{0}, cacheSpills{0};
+
+    static DbMetrics& global();
+    bool enabled() const { return on.load(memory_order_relaxed); }
+    // Call before the first connection is opened: SQLite reads MEMSTATUS only once,
+    // when it initializes.
+    void enable();
+
+    OperationStats& operation(DbOperation op) { return operations[size_t(op)]; }
+
+    // The stats for one menu action, or null while metrics are off.
+    OperationStats* action(string_view name);
+
+    // A statement failed. Counted (and kept for the report) whether or not metrics are on.
+    void recordError(int rc, const char* message, const char* sql);
+
+    // Adds the connection's page cache counters since the last call. Run it on the
+    // thread that owns the connection.
+    void collectCacheStats(sqlite3* db);
+
+    string json() const;
+
+    void render(RenderBuffer& out) const;
+};
+
+// Times a scope into an OperationStats. Inert when given null, which is what the
+// metrics hand out while they are off.
+class ScopedTimer {
+    OperationStats* stats;
+    chrono::steady_clock::time_point start;
+    uint64_t rowCount = 0;
+public:
+    explicit ScopedTimer(OperationStats* s) : stats(s) {
+        if (stats) start = chrono::steady_clock::now();
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ~ScopedTimer() {
+        if (stats) stats->record(uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()), rowCount);
+    }
+    void addRows(uint64_t n) { rowCount += n; }
+};
+
+// Writes DbMetrics::json() to a file every `interval`, and once more on stop. The
+// file is replaced by rename, so readers never see a partial dump.
+class MetricsDumper {
+    string path;
+    chrono::seconds interval{60};
+    mutex lock;
+    condition_variable wake;
+    thread worker;
+    bool stopping = false;
+
+    void dump();
+    void run();
+
+public:
+    MetricsDumper() = default;
+    MetricsDumper(const MetricsDumper&) = delete;
+    MetricsDumper& operator=(const MetricsDumper&) = delete;
+    ~MetricsDumper() { stop(); }
+
+    void start(string file, chrono::seconds every);
+    void stop();
+};
+
+
+// ------------------- Prepared Statement Cache -------------------
+struct StatementFinalizer {
+    void operator()(sqlite3_stmt* stmt) const { sqlite3_finalize(stmt); }
+};
+using StatementHandle = unique_ptr<sqlite3_stmt, StatementFinalizer>;
+
+// A cached statement borrowed for one use. Releasing it resets the statement and
+// clears its bindings so the next caller starts clean.
+class CachedStatement {
+    sqlite3_stmt* stmt;
+public:
+    explicit CachedStatement(sqlite3_stmt* s) : stmt(s) {}
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+    ~CachedStatement() {
+        if (stmt) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+    }
+    operator sqlite3_stmt*() const { return stmt; }
+    explicit operator bool() const { return stmt != nullptr; }
+};
+
+
+// ------------------- Connection Profile -------------------
+// How a connection is tuned when it is opened. WAL lets readers run while a write is
+// in progress. synchronous=NORMAL in WAL mode only syncs at checkpoints, so a commit
+// does not pay for a full fsync.
+struct ConnectionProfile {
+    const char* journalMode = "WAL";
+    const char* synchronous = "NORMAL";
+    int cacheSizeKiB = 64 * 1024;              // page cache per connection
+    long long mmapSizeBytes = 256LL << 20;     // memory-mapped I/O window
+    bool tempStoreMemory = true;               // temp tables and sort files in RAM
+    int busyTimeoutMs = 5000;                  // wait this long for a lock before SQLITE_BUSY
+
+    // WAL + NORMAL: the everyday interactive profile.
+    static ConnectionProfile standard() { return ConnectionProfile(); }
+
+    // Every commit is synced to disk before it returns.
+    static ConnectionProfile durable() {
+        ConnectionProfile p;
+        p.synchronous = "FULL";
+        return p;
+    }
+
+    // Large one-off loads: no syncs at all and a bigger cache. A crash mid-import
+    // can lose the import (but WAL keeps the existing data consistent).
+    static ConnectionProfile bulkImport() {
+        ConnectionProfile p;
+        p.synchronous = "OFF";
+        p.cacheSizeKiB = 256 * 1024;
+        p.mmapSizeBytes = 1LL << 30;
+        return p;
+    }
+
+    static bool fromName(const string& name, ConnectionProfile& out) {
+        if (name == "standard") out = standard();
+        else if (name == "durable") out = durable();
+        else if (name == "bulk") out = bulkImport();
+        else return false;
+        return true;
+    }
+};
+
+
+// ------------------- DatabaseManager Class (Tier 3) -------------------
+// One change entered in this session, queued for the background writer (see
+// WriteBehind). It carries copies of everything written, so the writer thread never
+// reads the patient; `patient` only identifies the owner.
+struct PendingWrite {
+    enum class Kind { Patient, Vital, Medication, Reminder };
+    Kind kind;
+    const Patient* patient;
+    long long patientId = 0; // 0 while the patient row itself is still queued
+    chrono::steady_clock::time_point queuedAt;
+    // Kind::Patient
+    string name, contact;
+    int age = 0;
+    // Kind::Vital
+    VitalKind vitalKind = VitalKind::Weight;
+    time_t timestamp = 0;
+    double value1 = 0, value2 = 0;
+    // Kind::Medication / Kind::Reminder, with their position in the patient's vector
+    optional<Medication> medication;
+    optional<Reminder> reminder;
+    size_t index = 0;
+
+    long long rowId = 0; // set once written; stays 0 if the write failed or was skipped
+
+    PendingWrite(Kind k, const Patient* p) : kind(k), patient(p) {}
+};
+
+// One change_log row, as forEachChange hands it out: entity is patient, record,
+// medication or reminder, op is insert or update, data the row's new values as JSON.
+// The views are valid for the duration of the callback.
+struct LoggedChange {
+    long long seq;
+    string_view entity, op;
+    long long rowId, patientId;
+    string_view data;
+};
+
+class DatabaseManager {
+private:
+    sqlite3* DB;
+    string db_file;
+    ConnectionProfile profile; // as opened; reader connections reuse it
+    // Keyed by the statement's own SQL text (sqlite3_sql), so lookups need no allocation.
+    unordered_map<string_view, StatementHandle> statements;
+    uint64_t rowsTouched = 0; // rows read or written on this connection, for per-operation counts
+    chrono::steady_clock::time_point transactionStart;
+    bool timingTransaction = false;
+    // Rollup changes from the readings inserted in the current transaction, written
+    // to health_rollups just before it commits. Nearly every reading opens a bucket, so
+    // the nodes come from a pool the connection keeps: later transactions reuse them
+    // instead of allocating one per reading.
+    using RollupKey = tuple<long long, VitalKind, RollupPeriod, time_t>;
+    pmr::unsynchronized_pool_resource rollupMemory;
+    pmr::map<RollupKey, RollupBucket> pendingRollups{&rollupMemory};
+
+    // Times one public call into its DbOperation slot, with the rows it touched, and
+    // then folds the connection's page cache counters into the totals.
+    class OperationScope {
+        DatabaseManager& db;
+        ScopedTimer timer;
+        uint64_t firstRow;
+    public:
+        OperationScope(DatabaseManager& d, DbOperation op)
+            : db(d), timer(DbMetrics::global().enabled() ? &DbMetrics::global().operation(op) : nullptr), firstRow(d.rowsTouched) {}
+        ~OperationScope() {
+            timer.addRows(db.rowsTouched - firstRow);
+            if (DbMetrics::global().enabled() && db.DB) DbMetrics::global().collectCacheStats(db.DB);
+        }
+    };
+
+    // Returns the prepared statement for sql, compiling it only on first use.
+    CachedStatement prepare(const char* sql);
+
+    // sqlite3_step with timing and error reporting. Every query here goes through it,
+    // so a failing step is reported instead of reading as "no more rows".
+    int step(sqlite3_stmt* stmt);
+
+    // Transactions, timed from BEGIN to COMMIT or ROLLBACK.
+    bool begin(const char* sql = "BEGIN IMMEDIATE;");
+    bool commit();
+    void rollback();
+    void endTransaction();
+
+    // Stands in for sqlite3_busy_timeout so that lock waits can be counted: the same
+    // sleep schedule as SQLite's own handler, up to the profile's busyTimeoutMs.
+    static int onBusy(void* self, int attempt);
+
+    static string columnText(sqlite3_stmt* stmt, int col);
+    // A view of SQLite's own buffer, valid until the statement is stepped or reset.
+    static string_view columnView(sqlite3_stmt* stmt, int col);
+    // Binds without a copy; the text must stay put until the statement has been stepped.
+    static void bindView(sqlite3_stmt* stmt, int index, string_view text);
+
+    // Row handlers shared by the bulk and per-patient loaders. Column 0 is patient_id.
+    static void addRecordRow(Patient& patient, sqlite3_stmt* stmt);
+    // Sealed readings: columns are patient_id, id, type, data, as in the health_chunks
+    // queries in DatabaseManager.cpp. Each reading carries the negated chunk id as its
+    // row id, which marks it saved. A chunk that does not decode is reported and skipped.
+    static VitalChunkColumns& chunkScratch();
+    template <typename AddFn>
+    static void decodeChunkRow(sqlite3_stmt* stmt, AddFn add) {
+        VitalKind kind;
+        if (!readVitalType(stmt, 2, kind)) return;
+        long long chunkId = sqlite3_column_int64(stmt, 1);
+        const void* data = sqlite3_column_blob(stmt, 3);
+        VitalChunkColumns& c = chunkScratch();
+        if (!VitalChunkCodec::decode(data, size_t(sqlite3_column_bytes(stmt, 3)), c)) {
+            cerr << "Skipping unreadable vitals chunk " << chunkId << endl;
+            return;
+        }
+        for (size_t i = 0; i < c.times.size(); ++i) {
+            add(kind, c.times[i], c.values1[i], c.values2.empty() ? 0.0 : c.values2[i], -chunkId);
+        }
+    }
+    static void addChunkRow(Patient& patient, sqlite3_stmt* stmt);
+    static void storeChunkRow(Patient& patient, sqlite3_stmt* stmt);
+    // Medications and reminders are marked saved before they are added, so observers
+    // see stored rows.
+    static void addMedicationRow(Patient& patient, sqlite3_stmt* stmt);
+    static void addReminderRow(Patient& patient, sqlite3_stmt* stmt);
+    // Variants for the parallel loader's threads: they fill the patient directly and
+    // leave observers (which are not thread-safe) to Patient::announceHistory.
+    static void storeRecordRow(Patient& patient, sqlite3_stmt* stmt);
+    static void storeMedicationRow(Patient& patient, sqlite3_stmt* stmt);
+    static void storeReminderRow(Patient& patient, sqlite3_stmt* stmt);
+
+    // Steps through a child-table query whose first column is patient_id, sorted
+    // ascending, and hands each row to the patient that owns it. `patients` must be
+    // sorted by row id; rows whose patient is missing are skipped.
+    template <typename RowFn>
+    void mergeChildRows(sqlite3_stmt* stmt, vector<unique_ptr<Patient>>& patients, RowFn onRow) {
+        if (!stmt) return;
+        size_t next = 0;
+        while (step(stmt) == SQLITE_ROW) {
+            long long patient_id = sqlite3_column_int64(stmt, 0);
+            while (next < patients.size() && patients[next]->getRowId() < patient_id) ++next;
+            if (next == patients.size()) break;
+            if (patients[next]->getRowId() == patient_id) onRow(*patients[next], stmt);
+        }
+    }
+
+    // Runs a bound INSERT/UPDATE; on INSERT the new row id is written to rowId.
+    bool stepWrite(sqlite3_stmt* stmt, long long& rowId);
+
+    // Binds a change_log append's op, row_id and patient_id; the caller binds the row's
+    // values from parameter 4 on, for the json_object in the statement.
+    static void bindChange(sqlite3_stmt* stmt, bool inserted, long long rowId, long long patient_id);
+
+    bool savePatientRow(string_view name, int age, string_view contact, long long& rowId);
+    bool savePatientRow(const Patient& patient, long long& rowId);
+
+    // The type column of the vitals tables holds VitalTraits::storageId.
+    static int vitalTypeId(VitalKind kind) { return vitalInfo(kind).storageId; }
+    static bool readVitalType(sqlite3_stmt* stmt, int column, VitalKind& kind);
+
+    bool bumpGeneration();
+
+    // Readings are immutable once entered, so vitals are only ever inserted.
+    bool insertVital(long long patient_id, VitalKind kind, time_t timestamp, double value1, double value2, long long& rowId);
+
+    // Binds patient_id, type, period, bucket_start and the aggregates, in that order.
+    // value2 columns stay NULL for single-value kinds, as in health_records.
+    static void bindRollup(sqlite3_stmt* stmt, long long patient_id, VitalKind kind, RollupPeriod period, const RollupBucket& b);
+
+    // Adds a bucket's aggregates to its health_rollups row, creating it if need be.
+    static constexpr const char* UpsertRollupSql =
+        "INSERT INTO health_rollups (patient_id, type, period, bucket_start, readings, "
+        "value1_min, value1_max, value1_sum, value2_min, value2_max, value2_sum) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT (patient_id, type, period, bucket_start) DO UPDATE SET "
+        "readings = readings + excluded.readings, "
+        "value1_min = min(value1_min, excluded.value1_min), value1_max = max(value1_max, excluded.value1_max), "
+        "value1_sum = value1_sum + excluded.value1_sum, "
+        "value2_min = min(value2_min, excluded.value2_min), value2_max = max(value2_max, excluded.value2_max), "
+        "value2_sum = value2_sum + excluded.value2_sum;";
+
+    // Merges this transaction's rollup changes into health_rollups, one upsert per
+    // bucket touched.
+    bool flushRollups();
+
+    bool insertVitalRow(VitalKind kind, const VitalSeries& s, size_t i, long long patient_id, long long& rowId);
+
+    bool saveMedicationRow(const Medication& med, long long patient_id, long long& rowId);
+
+    bool saveReminderRow(const Reminder& rem, long long patient_id, long long& rowId);
+
+public:
+    DatabaseManager(const string& filename) : DB(nullptr), db_file(filename) {}
+    
+    ~DatabaseManager();
+
+    bool open(const ConnectionProfile& chosen = ConnectionProfile::standard());
+
+    // A read-only connection for a loader thread. The journal mode is a property of
+    // the database file (set to WAL by the main connection), so it is left alone.
+    bool openReadOnly(const ConnectionProfile& chosen);
+    // A second read-write connection to an existing database, for the write-behind thread.
+    bool openWriter(const ConnectionProfile& chosen);
+    const string& fileName() const { return db_file; }
+    const ConnectionProfile& connectionProfile() const { return profile; }
+
+    // `secondary` connections leave the journal mode to the main one.
+    bool applyProfile(const ConnectionProfile& profile, bool secondary = false);
+
+    // The PRAGMA user_version of a database whose tables match createTables(): those
+    // skip the checks and DDL. Bump it with any change to the schema or its migrations,
+    // so existing databases go through them once more. 0 is every database from before.
+    static constexpr int SchemaVersion = 1;
+
+    int schemaVersion();
+
+    // False when the database could not be brought up to this schema. A failed
+    // migration is rolled back, so the next start tries it again.
+    bool createTables();
+
+    // `table` is spliced into the SQL: only pass table names from this class.
+    bool tableHasRows(const char* table);
+
+    bool tableExists(const char* table);
+
+    bool columnExists(const char* table, const char* column);
+
+    // The declared type of a column, upper-cased; empty if there is no such column.
+    string columnType(const char* table, const char* column);
+
+    // Rebuilds the vitals tables of a database that tags kinds with text ('BP', 'Weight',
+    // 'Sugar') so their type column holds storage ids, in one transaction: the old tables
+    // are renamed aside, `schema` creates the new ones, and the rows are copied across
+    // with ids and AUTOINCREMENT counters kept. Tags no kind claims become 0, which
+    // the loaders skip, as they skipped unknown tags.
+    bool migrateVitalTypes(const char* schema);
+
+    // Writes only new or changed rows, all inside a single transaction. Row ids are
+    // handed back to the in-memory objects only once the commit has succeeded.
+    bool saveAllPatients(vector<unique_ptr<Patient>>& patients);
+
+    // Writes a batch of queued changes in one transaction; all or nothing. A queued
+    // child of a patient inserted earlier in the queue finds the patient's id in
+    // `patientIds`; a child whose patient never made it is skipped (rowId stays 0).
+    bool applyWrites(vector<PendingWrite>& batch, unordered_map<const Patient*, long long>& patientIds);
+
+    // Inserts a batch of imported readings in one transaction; all or nothing.
+    bool insertVitalBatch(const vector<ImportedVital>& rows);
+
+    // The write generation recorded in meta; changes with every committed save or import.
+    long long generation();
+
+    unordered_set<long long> loadPatientIds();
+
+    // Reads each table once, ordered by patient id, and merge-joins the child rows
+    // into the patients (which are themselves loaded in id order).
+    void loadPatients(vector<unique_ptr<Patient>>& patients, pmr::memory_resource* memory = pmr::get_default_resource());
+
+    // loadPatients restricted to patient ids in [firstId, lastId], read in one
+    // transaction so the tables agree. Observers are not notified.
+    bool loadPatientRange(vector<unique_ptr<Patient>>& out, long long firstId, long long lastId, pmr::memory_resource* memory);
+
+    // The eager load split by patient id range across `threads` read-only
+    // connections. Each thread builds its own patients in its own arena pool, so the
+    // threads share nothing; the main thread then concatenates the ranges (already
+    // in id order) and replays them to the observers.
+    void loadPatientsParallel(vector<unique_ptr<Patient>>& patients, PatientArena& arena, unsigned threads);
+
+    // Lazy mode: only the patients rows. History is fetched later by loadHistory.
+    void loadPatientSummaries(vector<unique_ptr<Patient>>& patients, HistoryCache* cache,
+                              pmr::memory_resource* memory = pmr::get_default_resource());
+
+    // Fetches one patient's records, medications and reminders (served by the
+    // patient_id indexes) and appends them to whatever is already in memory.
+    void loadHistory(Patient& patient);
+
+    // Windowed trend straight from SQLite (served by idx_health_chunks_patient_type_ts
+    // and idx_health_records_patient_type_ts), for patients whose history is not in
+    // memory. Readings are added as already saved.
+    void loadVitalsInRange(long long patient_id, VitalKind kind, time_t from, time_t to, VitalSeries& out);
+
+    // Rollup buckets of one patient's vital kind starting within [from, to], oldest first
+    // (served by the health_rollups primary key).
+    void loadRollups(long long patient_id, VitalKind kind, RollupPeriod period, time_t from, time_t to, vector<RollupBucket>& out);
+
+    // Recomputes health_rollups from the stored readings: one scan of the chunks and
+    // one of health_records, each in (patient, type) order (the rows via the covering
+    // index, in timestamp order), folding each group's readings as VitalSeries does.
+    // Buckets are upserted when the group changes, so a group found in both sources
+    // merges.
+    bool rebuildRollups();
+
+    // Seals readings older than sealBefore into compressed health_chunks. One scan of
+    // health_records in (patient, type, timestamp) order; each group of at least
+    // VitalChunkMinReadings readings is cut into evenly sized chunks of at most
+    // VitalChunkMaxReadings, and its rows are deleted once the scan is done. All in one
+    // transaction; rollups are untouched (the readings only change where they live).
+    // The freed pages are then given back to the file system with VACUUM.
+    bool compactVitals(time_t sealBefore);
+
+    // The size of the main database file in bytes (page_count * page_size).
+    long long databaseBytes();
+
+    // The newest two readings of every (patient, kind), oldest first, for seeding the
+    // alert engine in lazy mode. Calls fn(patient_id, kind, latest, previous-or-null).
+    // Rows come from a window query over health_records; for sealed readings only each
+    // group's newest chunk is decoded (a chunk holds at least two readings).
+    template <typename Fn>
+    void forEachLatestVitals(Fn fn) {
+        OperationScope scope(*this, DbOperation::ForEachLatestVitals);
+        struct Newest {
+            VitalReading readings[2]; // oldest first
+            int count = 0;
+            void offer(const VitalReading& r) {
+                if (count < 2) {
+                    readings[count++] = r;
+                    if (count == 2 && readings[1].timestamp < readings[0].timestamp) swap(readings[0], readings[1]);
+                } else if (r.timestamp >= readings[1].timestamp) {
+                    readings[0] = readings[1];
+                    readings[1] = r;
+                } else if (r.timestamp > readings[0].timestamp) {
+                    readings[0] = r;
+                }
+            }
+        };
+        map<pair<long long, VitalKind>, Newest> newest;
+        if (CachedStatement chunks = prepare(
+                "SELECT patient_id, id, type, data FROM health_chunks c WHERE last_ts = "
+                "(SELECT max(last_ts) FROM health_chunks WHERE patient_id = c.patient_id AND type = c.type);")) {
+            while (step(chunks) == SQLITE_ROW) {
+                long long patient_id = sqlite3_column_int64(chunks, 0);
+                decodeChunkRow(chunks, [&](VitalKind kind, time_t ts, double v1, double v2, long long) {
+                    newest[{patient_id, kind}].offer({ts, v1, v2});
+                });
+            }
+        }
+        CachedStatement stmt = prepare(
+            "SELECT patient_id, type, value1, value2, timestamp FROM ("
+            "  SELECT patient_id, type, value1, value2, timestamp, "
+            "  ROW_NUMBER() OVER (PARTITION BY patient_id, type ORDER BY timestamp DESC) AS rn "
+            "  FROM health_records) WHERE rn <= 2 ORDER BY patient_id, type, timestamp;");
+        if (!stmt) return;
+        while (step(stmt) == SQLITE_ROW) {
+            VitalKind kind;
+            if (!readVitalType(stmt, 1, kind)) continue;
+            newest[{sqlite3_column_int64(stmt, 0), kind}].offer(
+                {(time_t)sqlite3_column_int64(stmt, 4), sqlite3_column_double(stmt, 2), sqlite3_column_double(stmt, 3)});
+        }
+        for (const auto& [key, n] : newest) fn(key.first, key.second, n.readings[n.count - 1], n.count == 2 ? &n.readings[0] : nullptr);
+    }
+
+    // Every reminder with its patient's name, for arming the scheduler without
+    // hydrating patients. Calls fn(patient_name, reminder); the name is a view that
+    // is only valid during the call.
+    template <typename Fn>
+    void forEachReminder(Fn fn) {
+        OperationScope scope(*this, DbOperation::ForEachReminder);
+        CachedStatement stmt = prepare(
+            "SELECT p.name, r.id, r.message, r.date, r.time, r.frequency FROM reminders r "
+            "JOIN patients p ON p.id = r.patient_id;");
+        if (!stmt) return;
+        while (step(stmt) == SQLITE_ROW) {
+            Reminder rem(columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4), parseFrequency(columnView(stmt, 5)));
+            rem.markSaved(sqlite3_column_int64(stmt, 1));
+            fn(columnView(stmt, 0), rem);
+        }
+    }
+
+    // Visits the changes committed after `afterSeq`, oldest first, at most `limit` of
+    // them (0: all). Returns the seq of the last one visited, or afterSeq if none, which
+    // is the cursor to pass next time.
+    template <typename Fn>
+    long long forEachChange(long long afterSeq, size_t limit, Fn fn) {
+        OperationScope scope(*this, DbOperation::ForEachChange);
+        CachedStatement stmt = prepare(
+            "SELECT seq, entity, op, row_id, patient_id, data FROM change_log WHERE seq > ? ORDER BY seq LIMIT ?;");
+        if (!stmt) return afterSeq;
+        sqlite3_bind_int64(stmt, 1, afterSeq);
+        sqlite3_bind_int64(stmt, 2, limit ? (long long)limit : -1);
+        long long last = afterSeq;
+        while (step(stmt) == SQLITE_ROW) {
+            LoggedChange c{sqlite3_column_int64(stmt, 0), columnView(stmt, 1), columnView(stmt, 2),
+                           sqlite3_column_int64(stmt, 3), sqlite3_column_int64(stmt, 4), columnView(stmt, 5)};
+            fn(c);
+            last = c.seq;
+        }
+        return last;
+    }
+
+    // Drops the changes up to and including `throughSeq`, once every consumer has them.
+    // Returns the number removed, or -1 on error.
+    long long pruneChanges(long long throughSeq);
+};
+
+
+// ------------------- Memory-Mapped Files -------------------
+// Read-only view of a whole file. Uses mmap where available.
+class MappedFile {
+    const char* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    string buffer;
+#endif
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const string& path);
+
+    string_view contents() const { return string_view(base ? base : "", length); }
+
+    // Asks the kernel to start reading the whole file in now, in the background.
+    void willNeed() const;
+};
+
+// Warms the page cache for files about to be read (the database and the snapshot on a
+// --warm restart), on a thread of its own, so SQLite's and the loader's first reads
+// hit memory instead of the disk. Each file is mapped, advised WILLNEED, and touched
+// one byte per page; nothing is kept. Stops early when destroyed.
+class FilePrefetcher {
+    thread worker;
+    atomic<bool> stopping{false};
+
+public:
+    FilePrefetcher() = default;
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+    ~FilePrefetcher();
+
+    void start(vector<string> paths);
+};
+
+
+// ------------------- Binary Snapshot -------------------
+// A read-only image of the patient set for fast startup (e.g. kiosks). SQLite stays
+// the system of record: the snapshot carries the meta generation it was taken at
+// and is ignored, then rewritten, once the database has moved on.
+//
+// Layout (native byte order, every section 8-byte aligned):
+//   SnapshotHeader
+//   SnapshotPatient[patientCount]        sorted by rowId, one offset index entry each
+//   SnapshotMedication[medicationCount]  grouped by patient
+//   SnapshotReminder[reminderCount]      grouped by patient
+//   string table                         names, contacts, medications, reminders
+//   vitals columns                       per patient and kind: times, value1,
+//                                        value2 (blood pressure only), rowIds
+// Readers use the mapped file in place; only what a caller asks for is copied out.
+// The header checksum covers everything before the columns, so opening touches only
+// the index and strings; each patient's columns carry their own checksum, checked
+// the first time that patient is read.
+constexpr uint32_t SnapshotVersion = 1;
+constexpr uint32_t SnapshotByteOrder = 0x01020304;
+static_assert(sizeof(time_t) == 8, "snapshot columns store time_t as 64-bit seconds");
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t generation;
+    uint64_t fileBytes;
+    uint64_t checksum; // from the end of the header up to columnsOffset
+    uint64_t patientCount, patientsOffset;
+    uint64_t medicationCount, medicationsOffset;
+    uint64_t reminderCount, remindersOffset;
+    uint64_t stringsOffset, stringsBytes;
+    uint64_t columnsOffset, columnsBytes;
+};
+struct SnapshotString { uint32_t offset, length; };
+struct SnapshotSeries { uint64_t offset, count; }; // offset of the times column
+struct SnapshotPatient {
+    int64_t rowId;
+    int32_t age;
+    uint32_t reserved;
+    SnapshotString name, contact;
+    SnapshotSeries vitals[VitalKindCount]; // indexed by VitalKind
+    uint64_t columnsBytes, columnsChecksum; // every series, stored back to back
+    uint32_t firstMedication, medicationCount;
+    uint32_t firstReminder, reminderCount;
+};
+struct SnapshotMedication {
+    int64_t rowId;
+    SnapshotString name, dosage, schedule;
+    uint32_t reserved[2];
+};
+struct SnapshotReminder {
+    int64_t rowId;
+    SnapshotString message, date, time;
+    uint32_t frequency;
+    uint32_t reserved;
+};
+static constexpr char SnapshotMagic[8] = {'M', 'T', 'S', 'N', 'A', 'P', '\r', '\n'};
+
+inline uint64_t snapshotChecksum(const char* p, size_t n) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a offset basis, fed a word at a time
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    for (; i < n; ++i) h = (h ^ (unsigned char)p[i]) * 1099511628211ull;
+    return h;
+}
+
+class SnapshotWriter {
+    string strings;
+    string columns;
+
+    SnapshotString intern(string_view text);
+    template <typename T>
+    void appendColumn(ColumnView<T> column) {
+        columns.append((const char*)column.data(), column.size() * sizeof(T));
+    }
+    static void pad(string& out) { out.resize((out.size() + 7) & ~size_t(7), '\0'); }
+
+public:
+    // Writes every patient, which must have its history loaded, and replaces `path`
+    // atomically (write to a temporary file, then rename).
+    bool write(const string& path, const vector<unique_ptr<Patient>>& patients, long long generation);
+};
+
+class Snapshot {
+    MappedFile file;
+    const SnapshotHeader* header = nullptr;
+    const SnapshotPatient* patients = nullptr;
+    const SnapshotMedication* medications = nullptr;
+    const SnapshotReminder* reminders = nullptr;
+    const char* strings = nullptr;
+
+    template <typename T>
+    const T* at(uint64_t offset) const { return (const T*)(file.contents().data() + offset); }
+
+    string_view text(SnapshotString s) const { return string_view(strings + s.offset, s.length); }
+
+    bool sectionFits(uint64_t offset, uint64_t count, size_t size) const;
+
+public:
+    // Maps the file and checks magic, version, byte order, bounds and checksum.
+    bool open(const string& path);
+
+    long long generation() const { return (long long)header->generation; }
+    size_t size() const { return header->patientCount; }
+
+    // The patient's index entry, or nullptr if it is missing or its columns fail the checksum.
+    const SnapshotPatient* find(long long rowId) const;
+
+    // In-place columns of one patient's readings of `kind`.
+    ColumnView<time_t> times(const SnapshotPatient& p, VitalKind kind) const;
+    ColumnView<double> values1(const SnapshotPatient& p, VitalKind kind) const;
+    ColumnView<double> values2(const SnapshotPatient& p, VitalKind kind) const;
+    ColumnView<long long> rowIds(const SnapshotPatient& p, VitalKind kind) const;
+
+    // Creates the summary-only patients, in rowId order, attached to `cache`.
+    void loadPatientSummaries(vector<unique_ptr<Patient>>& out, HistoryCache* cache,
+                              pmr::memory_resource* memory = pmr::get_default_resource()) const;
+
+    // The snapshot counterpart of DatabaseManager::loadHistory.
+    bool loadHistory(Patient& patient) const;
+
+    // A trend window found by binary search on the mapped times column.
+    bool loadVitalsInRange(long long patientId, VitalKind kind, time_t from, time_t to, VitalSeries& out) const;
+};
+
+
+// ------------------- Lazy History Cache -------------------
+// Hydrates patient history on demand and, once the loaded histories exceed the
+// budget, evicts the least recently used ones that have nothing left to save.
+class HistoryCache {
+    DatabaseManager& db;
+    const Snapshot* snapshot = nullptr; // serves histories while it matches the database generation
+    size_t budgetBytes;
+    list<Patient*> lru; // most recently used at the front
+    struct Entry { list<Patient*>::iterator at; size_t bytes; };
+    unordered_map<Patient*, Entry> position;
+    size_t usedBytes = 0;
+    PatientRegistry* registry = nullptr; // if set, histories change under the patient's shard lock
+
+    // Callers should hydrate a patient before editing it, but a require from inside
+    // an edit of the same shard already holds the lock.
+    template <typename Fn>
+    void change(Patient& patient, Fn fn) {
+        if (registry && !registry->holdsExclusive(patient)) registry->edit(patient, [&](Patient&) { fn(); });
+        else fn();
+    }
+
+    // Only the front patient can have grown since it was measured: any other patient
+    // that gains history goes through require() and becomes the front first.
+    void remeasureFront();
+
+    // Skipped inside an edit: taking another shard there could deadlock against
+    // editAll, so the cache stays over budget until the next require outside one.
+    void evictOverBudget();
+
+public:
+    HistoryCache(DatabaseManager& database, size_t budget) : db(database), budgetBytes(budget) {}
+
+    void useSnapshot(const Snapshot* s) { snapshot = s; }
+    void guardWith(PatientRegistry* r) { registry = r; }
+    bool snapshotCurrent() { return snapshot && snapshot->generation() == db.generation(); }
+
+    void require(Patient& patient);
+
+    // Serves a trend window from SQLite without hydrating the patient.
+    VitalSeries loadWindow(const Patient& patient, VitalKind kind, time_t from, time_t to);
+    // Rollup buckets for a patient whose history is not in memory.
+    vector<RollupBucket> loadRollups(const Patient& patient, VitalKind kind, RollupPeriod period, time_t from, time_t to);
+};
+
+
+// ------------------- Bulk Import Pipeline -------------------
+// Non-interactive import of vitals feeds. One CSV row per reading:
+//
+//   patient_id,type,timestamp,value1[,value2]
+//
+// type is BP, Weight or Sugar (as stored in health_records), timestamp is Unix
+// seconds and value2 is the diastolic reading, required for BP only. Blank lines,
+// '#' comments and a leading "patient_id,..." header are skipped.
+//
+// The work runs as three stages: the reader maps the file and cuts it into chunks
+// at line boundaries, parser threads tokenize chunks in place (string_view and
+// from_chars, no per-line allocation) and the writer, on the calling thread, takes
+// parsed chunks back in file order and inserts them in large transactions. Bad rows
+// are copied verbatim to the rejects file, each after a "# line N: reason" comment,
+// so the file can be corrected and fed straight back in.
+
+struct ImportReport {
+    size_t lines = 0;
+    size_t imported = 0;
+    size_t rejected = 0;
+    double seconds = 0;
+    bool ok = true;
+
+    double rowsPerSecond() const { return seconds > 0 ? imported / seconds : 0; }
+};
+
+class BulkImporter {
+    struct Reject {
+        size_t line; // line number within the chunk, from 0
+        const char* reason;
+        string_view text;
+    };
+    struct ParsedChunk {
+        vector<ImportedVital> rows;
+        vector<Reject> rejects;
+        size_t lineCount = 0;
+    };
+    struct Chunk {
+        size_t sequence;
+        string_view text;
+    };
+
+    DatabaseManager& db;
+    size_t batchRows;
+    unsigned parserCount;
+    static constexpr size_t ChunkBytes = 1 << 20;
+
+    // Pipeline state. The reader stops once maxInFlight chunks are waiting to be
+    // written, so a slow writer bounds memory instead of the whole file being parsed ahead.
+    mutex lock;
+    condition_variable chunkReady, chunkTaken, parsedReady;
+    queue<Chunk> pendingChunks;
+    map<size_t, ParsedChunk> parsed; // keyed by sequence, drained in order
+    size_t inFlight = 0, maxInFlight = 0;
+    bool readerDone = false;
+
+    static string_view trim(string_view s);
+
+    template <typename T>
+    static bool parseNumber(string_view s, T& out) {
+        s = trim(s);
+        if (s.empty()) return false;
+        auto result = from_chars(s.data(), s.data() + s.size(), out);
+        return result.ec == errc() && result.ptr == s.data() + s.size();
+    }
+
+    // Returns nullptr on success, otherwise why the line was rejected.
+    static const char* parseLine(string_view line, const unordered_set<long long>& knownPatients, ImportedVital& out);
+
+    static ParsedChunk parseChunk(string_view text, bool first, const unordered_set<long long>& knownPatients);
+
+    void readStage(string_view data);
+
+    void parseStage(const unordered_set<long long>& knownPatients);
+
+public:
+    // batch: rows per transaction. parsers: 0 picks one per hardware thread.
+    BulkImporter(DatabaseManager& database, size_t batch = 50000, unsigned parsers = 0);
+
+    ImportReport run(const string& path, const string& rejectsPath);
+};
+
+
+// ------------------- Batch Command Mode -------------------
+// Scripted access for integration jobs: one command per line from a file or stdin,
+// applied on one open connection, one JSON object per line on the output.
+//
+//   add-patient NAME AGE [CONTACT]
+//   add-record PATIENT BP|Weight|Sugar VALUE [DIASTOLIC] [TIMESTAMP]
+//   query-trend PATIENT BP|Weight|Sugar [DAYS [readings|day|week]]
+//   export PATIENT|all
+//   commit
+//
+// Fields are separated by spaces or tabs; one with spaces goes in double quotes (\"
+// and \\ inside them). Blank lines and lines starting with # are skipped. PATIENT is
+// a patient id, or $N for the Nth patient added by this script ($ alone for the
+// latest). TIMESTAMP is in Unix seconds and defaults to now; DAYS defaults to 30 and
+// 0 means all time. export all prints one line per patient, then one with the count.
+//
+// Writes are queued and applied batchSize at a time in one transaction
+// (DatabaseManager::applyWrites), and their results are printed once their batch has
+// committed; a failed batch fails every write in it. Queries and `commit` apply the
+// queue first, so they see every write before them and the output stays in input
+// order. A client that waits for each answer should follow its writes with `commit`.
+
+// Parsing and JSON shapes shared by batch mode and the server. The parse functions
+// return nullptr on success, otherwise the error to report.
+struct CommandSyntax {
+    struct PatientArgs {
+        string name, contact;
+        int age = 0;
+    };
+    struct RecordArgs {
+        VitalKind kind = VitalKind::Weight;
+        double value1 = 0, value2 = 0;
+        time_t timestamp = 0;
+    };
+    struct TrendArgs {
+        VitalKind kind = VitalKind::Weight;
+        time_t from = 0, to = 0;
+        string view; // readings, day or week
+        RollupPeriod period() const { return view == "day" ? RollupPeriod::Day : RollupPeriod::Week; }
+    };
+
+    // Splits a command line into fields; false on an unterminated quote.
+    static bool tokenize(string_view line, vector<string>& fields);
+
+    template <typename T>
+    static bool parseNumber(const string& s, T& out) {
+        auto result = from_chars(s.data(), s.data() + s.size(), out);
+        return !s.empty() && result.ec == errc() && result.ptr == s.data() + s.size();
+    }
+
+    static bool parseKind(const string& s, VitalKind& kind) { return vitalKindFromTag(s, kind); }
+    static const char* kindTag(VitalKind kind) { return vitalInfo(kind).tag; }
+    static bool plausible(double v) { return v > 0 && v < 1e6; }
+
+    // add-patient NAME AGE [CONTACT]
+    static const char* parsePatient(const vector<string>& f, PatientArgs& out);
+
+    // add-record PATIENT TYPE VALUE [DIASTOLIC] [TIMESTAMP]; f[1] is left to the caller.
+    static const char* parseRecord(const vector<string>& f, RecordArgs& out);
+
+    // query-trend PATIENT TYPE [DAYS [readings|day|week]]; f[1] is left to the caller.
+    static const char* parseTrend(const vector<string>& f, TrendArgs& out);
+
+    static void writeReading(JsonWriter& json, VitalKind kind, const VitalSeries& s, size_t i, bool withType);
+
+    // The body of a query-trend answer: readings [first, last) of s, or the buckets.
+    static void writeTrend(JsonWriter& json, long long patientId, const TrendArgs& t, const VitalSeries& s, size_t first,
+                           size_t last, const RollupBucket* buckets, size_t bucketCount);
+
+    static void writePatient(JsonWriter& json, const Patient& p);
+
+    // Every answer starts {"line":N,"command":C and is finished by the caller.
+    static void begin(JsonWriter& json, size_t line, string_view command);
+    static string error(size_t line, string_view command, const char* message);
+};
+
+struct BatchReport {
+    size_t commands = 0;
+    size_t failed = 0;
+    double seconds = 0;
+
+    double commandsPerSecond() const { return seconds > 0 ? commands / seconds : 0; }
+};
+
+class BatchSession : CommandSyntax {
+    // A result waiting for the queued writes to commit: a write, or an error found
+    // while queueing (kept in line so the output stays in input order).
+    struct Queued {
+        size_t line;
+        string command;
+        size_t write;      // index into `writes`, unless error is set
+        const char* error;
+    };
+
+    DatabaseManager& db;
+    ostream& out;
+    size_t batchSize;
+    BatchReport report;
+    unordered_set<long long> knownPatients;
+    vector<unique_ptr<Patient>> added; // by this script, for $N: no history; null if the add failed
+    unordered_map<const Patient*, long long> patientIds;
+    vector<PendingWrite> writes;
+    vector<Queued> queued;
+
+    // Resolves PATIENT. `patient` is set for a $N whose row is still queued; otherwise
+    // the id is returned. Returns nullptr on success, else the error.
+    const char* resolve(const string& ref, long long& id, const Patient*& patient) const;
+
+    void emit(JsonWriter& json);
+    void fail(size_t line, const string& command, const char* error);
+    void printError(size_t line, const string& command, const char* message);
+
+    void queue(size_t line, const char* command, PendingWrite w);
+
+    // Commits the queued writes and prints their results. Returns how many were written.
+    size_t applyQueued();
+
+    void addPatient(size_t line, const vector<string>& f);
+
+    void addRecord(size_t line, const vector<string>& f);
+
+    void queryTrend(size_t line, const vector<string>& f);
+
+    void writePatientLine(size_t line, const Patient& p);
+
+    void exportPatients(size_t line, const vector<string>& f);
+
+public:
+    BatchSession(DatabaseManager& database, ostream& output, size_t batch = 1000)
+        : db(database), out(output), batchSize(batch ? batch : 1), knownPatients(database.loadPatientIds()) {}
+
+    BatchReport run(istream& in);
+};
+
+
+// ------------------- Write-Behind Queue -------------------
+// Changes entered in the UI are queued as they happen and written by a background
+// thread on its own connection, so the menu never waits on the disk and a crash
+// loses at most one commit window of input. The writer groups everything that
+// arrived within `window` of the oldest queued change, or MaxBatch changes, into one
+// transaction. The queue holds at most Capacity changes; beyond that enqueueing
+// blocks until the writer catches up.
+//
+// Row ids travel back through applyCommitted(), which the main thread calls between
+// menu actions. Objects stay unsaved until then, so saveAllPatients after flush()
+// still writes anything a failed batch left behind.
+class WriteBehind : public PatientObserver {
+    static constexpr size_t MaxBatch = 512;
+    static constexpr size_t Capacity = 8192;
+
+    DatabaseManager connection;
+    chrono::milliseconds window;
+
+    mutex lock;
+    condition_variable queued, drained, committed;
+    deque<PendingWrite> pending;
+    vector<PendingWrite> finished; // written or failed, waiting for applyCommitted
+    size_t enqueuedCount = 0, finishedCount = 0, flushTarget = 0;
+    bool stopping = false;
+    thread worker;
+
+    unordered_map<const Patient*, long long> patientIds; // writer thread only
+    unordered_map<const Patient*, size_t> outstanding;   // main thread only
+    unordered_set<const Patient*> failed;                // main thread only
+
+    void enqueue(PendingWrite w);
+    PendingWrite childOf(const Patient& patient, PendingWrite::Kind kind) const;
+
+    void run();
+
+    // Finds the reading a queued vital was made from. Readings only move when an
+    // older one is inserted before them, so the search goes by timestamp.
+    static void markVitalSaved(Patient& patient, const PendingWrite& w);
+
+    // Applies one finished write to its object (main thread).
+    void apply(Patient& patient, const PendingWrite& w);
+
+public:
+    WriteBehind(const DatabaseManager& db, chrono::milliseconds commitWindow)
+        : connection(db.fileName()), window(commitWindow) {}
+    ~WriteBehind() override { stop(); }
+    WriteBehind(const WriteBehind&) = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
+
+    bool start(const ConnectionProfile& profile);
+    // Writes whatever is still queued, then ends the writer thread.
+    void stop();
+
+    // Barrier: returns once everything queued so far has been written (or has
+    // failed), with the row ids applied.
+    void flush();
+
+    // For answering once a change is durable (the server): queuedCount() just after
+    // a change is queued is its ticket, and the change has been written, or has
+    // failed, once writtenCount() reaches it. commitNow() ends the commit window early.
+    size_t queuedCount();
+    size_t writtenCount();
+    void commitNow();
+    // Whether a change to this patient failed to write this session. Main thread only.
+    bool hasFailed(const Patient& patient) const { return failed.count(&patient) != 0; }
+
+    // Hands row ids of written changes back to their objects. Main thread only. The
+    // observer interface passes patients as const; the ids are applied to the
+    // main thread's own objects here, never from the writer thread.
+    // With a registry, each patient's ids are applied under its shard lock.
+    void applyCommitted(PatientRegistry* registry = nullptr);
+
+    // Only changes made in this session are queued; loaded rows already have ids.
+    void onPatientCreated(const Patient& patient) override;
+    void onVitalAdded(const Patient& patient, VitalKind kind, const VitalSeries& series, size_t index) override;
+    void onMedicationAdded(const Patient& patient, const Medication& medication) override;
+    void onReminderAdded(const Patient& patient, const Reminder& reminder) override;
+};
+
+
+// ------------------- Work-Stealing Pool -------------------
+// A fixed set of threads, each with its own task deque. A thread takes its newest
+// task from its own deque and, once that is empty, steals the oldest from another,
+// so partitions that turn out uneven (a few patients with long histories) even out.
+// run() deals a batch of tasks out round-robin, works on it from the calling thread
+// too, and returns once every task has finished. Tasks must not throw.
+class WorkStealingPool {
+    struct alignas(64) Queue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+    vector<unique_ptr<Queue>> queues; // [0] belongs to the thread calling run()
+    vector<thread> workers;
+    mutex idle;
+    condition_variable work, finished;
+    atomic<size_t> queued{0}, unfinished{0};
+    bool stopping = false;
+
+    bool runOne(size_t self);
+
+    void workerLoop(size_t self);
+
+public:
+    explicit WorkStealingPool(unsigned threads = thread::hardware_concurrency());
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned threads() const { return unsigned(queues.size()); }
+
+    void run(vector<function<void()>> tasks);
+};
+
+
+// ------------------- Population Reports -------------------
+// The nightly cross-patient report: alert counts, the distribution of latest weights,
+// medication follow-up lists and patients without recent readings. Patients have no
+// stored height, so weights stand in for a BMI distribution; doses are not logged,
+// so follow-up means "on medication with no reminder set" or "every reminder was a
+// one-off that has passed".
+struct ReportOptions {
+    int inactiveDays = 30;  // list patients whose newest reading is older than this
+    size_t listLimit = 20;  // names kept per list; the counts are always complete
+    time_t now = time(nullptr);
+    int32_t today = 0;      // local YYYYMMDD of now, for reminders
+    int minuteOfDay = 0;
+
+    ReportOptions() {
+        tm local = LocalCalendar::localParts(now);
+        today = (1900 + local.tm_year) * 10000 + (1 + local.tm_mon) * 100 + local.tm_mday;
+        minuteOfDay = local.tm_hour * 60 + local.tm_min;
+    }
+};
+
+// Partial aggregates for one partition of the patient set; merged in partition
+// order, so the name lists come out in registration order.
+struct PopulationReport {
+    static constexpr int WeightBands = 10; // under 50 kg, then 10 kg bands, then 130 kg and over
+
+    struct Listing {
+        size_t count = 0;
+        vector<string> names;
+        void add(const Patient& p, size_t limit) {
+            if (names.size() < limit) names.push_back(p.getName());
+            ++count;
+        }
+        void merge(const Listing& o, size_t limit) {
+            for (size_t i = 0; i < o.names.size() && names.size() < limit; ++i) names.push_back(o.names[i]);
+            count += o.count;
+        }
+    };
+
+    size_t patients = 0, withoutReadings = 0, withAbnormalReadings = 0;
+    VitalsSummary vitals;                        // every reading
+    array<size_t, AlertStateCount> alerting{};   // by each patient's newest reading, as AlertEngine decides
+    array<size_t, WeightBands> latestWeight{};
+    size_t withoutWeight = 0;
+    Listing noReminders, remindersLapsed, inactive;
+
+    void add(const Patient& p, const ReportOptions& opt);
+
+    void merge(const PopulationReport& o, size_t limit);
+
+    void render(RenderBuffer& out, const ReportOptions& opt) const;
+};
+
+// Splits the registry into partitions of PartitionSize patients, one pool task each,
+// and merges the partial reports. Runs on any thread: patients are read under their
+// shard locks. Lazy-mode patients whose history is not in memory are read from the
+// database instead, one range query per partition on the task's own read-only
+// connection, so the report never hydrates (or evicts) the live patients.
+class ReportEngine {
+public:
+    static constexpr size_t PartitionSize = 512;
+
+    static PopulationReport run(const PatientRegistry& registry, WorkStealingPool& pool, const DatabaseManager* db,
+                                const ReportOptions& opt);
+
+private:
+    static void runPartition(const PatientRegistry& registry, size_t first, size_t last, const DatabaseManager* db,
+                             const ReportOptions& opt, PopulationReport& out);
+};
+
+
+// ------------------- Patient Server -------------------
+// `meditrack --serve=PORT`: one long-lived process holds the database and the warm
+// patients, and the workstations talk to it over TCP instead of each opening
+// meditrack.db. The protocol is batch mode's (see CommandSyntax): one command per
+// line, one JSON object per line back, in request order on each connection.
+//
+//   get-patient ID
+//   find NAME-PREFIX [LIMIT]
+//   query-trend ID BP|Weight|Sugar [DAYS [readings|day|week]]
+//   add-patient NAME AGE [CONTACT]
+//   add-record ID BP|Weight|Sugar VALUE [DIASTOLIC] [TIMESTAMP]
+//
+// One thread runs a poll() loop over non-blocking sockets and owns the registry.
+// Each pass takes every complete request that has arrived. Runs of reads go to the
+// pool together and are answered from memory under shard locks; the writes between
+// them are applied on the loop thread in arrival order and reach the database only
+// through the WriteBehind writer. A write is answered once it has committed (the pass
+// asks the writer to commit straight away). That connection's later requests wait
+// behind it and run in the first pass after the commit, so they see the write: a find
+// after add-patient lists the new patient with its id. Reads on other connections are
+// served in the meantime.
+#ifndef _WIN32
+class PatientServer : CommandSyntax {
+    static constexpr size_t MaxLine = 64 * 1024;
+    static constexpr size_t DefaultFindLimit = 20;
+
+    struct Answer {
+        size_t line;
+        string command;
+        string text;                      // the JSON line, or empty until it can be rendered
+        size_t ticket = 0;                // a write: answered once the writer has written this many
+        const Patient* patient = nullptr; // a write's patient
+        bool created = false;             // add-patient: the answer carries the new id
+
+        Answer(size_t l, string c) : line(l), command(move(c)) {}
+    };
+    struct Connection {
+        int fd;
+        string in, out;
+        size_t lines = 0;
+        deque<Answer> answers; // in request order; references stay valid while pushing
+        bool closing = false;  // the peer has stopped sending: close once answered
+        bool broken = false;
+        size_t awaiting = 0;   // ticket of its last write; requests after it wait until it is written
+
+        explicit Connection(int f) : fd(f) {}
+    };
+    struct Request {
+        Connection* connection;
+        Answer* answer;
+        vector<string> fields;
+    };
+
+    PatientRegistry& registry;
+    const PatientIndex& index;
+    WriteBehind& writer;
+    WorkStealingPool& pool;
+    int listener = -1;
+    vector<unique_ptr<Connection>> connections;
+    unordered_map<long long, Patient*> byId; // saved patients; loop thread, read by the pool during a pass
+    size_t requests = 0, accepted = 0;
+
+    static bool isWrite(const string& command) { return command == "add-patient" || command == "add-record"; }
+
+    const char* resolve(const string& ref, Patient*& patient) const;
+
+    // --- Reads (pool threads) ---
+    string answerRead(const Answer& a, const vector<string>& f) const;
+
+    // --- Writes (loop thread) ---
+    void applyWrite(Answer& a, const vector<string>& f);
+
+    // Renders a committed write's answer.
+    void finishWrite(Answer& a);
+
+    // One pass: applies finished writes, takes the complete requests and runs them.
+    void pass();
+
+    static bool hasRequests(const Connection& c) { return c.in.find('\n') != string::npos; }
+
+    // Answers waiting on the writer, or requests held behind a write.
+    bool awaitingWrites() const;
+
+    void acceptAll();
+
+    static void receive(Connection& c);
+
+    static void transmit(Connection& c);
+
+public:
+    PatientServer(PatientRegistry& patients, const PatientIndex& search, WriteBehind& background, WorkStealingPool& readers);
+    ~PatientServer();
+    PatientServer(const PatientServer&) = delete;
+    PatientServer& operator=(const PatientServer&) = delete;
+
+    // Listens on the loopback interface only: the protocol has no authentication.
+    bool listen(uint16_t port);
+
+    // Serves until `stop` is set (from a signal handler). Answers still waiting on
+    // the writer when it stops are dropped with their connections.
+    void run(const volatile sig_atomic_t& stop);
+
+    size_t requestCount() const { return requests; }
+    size_t connectionCount() const { return accepted; }
+};
+#endif
@@ -0,0 +1,290 @@
+// Metrics.cpp
+// Metrics collection and output: the JSON writer, the startup trace, DbMetrics
+// and the periodic dumper.
+#include "MediTrack.h"
+
+// ------------------- JsonWriter -------------------
+void JsonWriter::separate() {
+    if (firstInScope.empty()) return;
+    if (!firstInScope.back()) out += ',';
+    firstInScope.back() = false;
+    if (compact) return;
+    out += '\n';
+    out.append(firstInScope.size() * 2, ' ');
+}
+
+void JsonWriter::key(const char* k) {
+    separate();
+    if (k) out += "\"" + string(k) + (compact ? "\":" : "\": ");
+}
+
+void JsonWriter::open(const char* k, char bracket) {
+    key(k);
+    out += bracket;
+    firstInScope.push_back(true);
+}
+
+void JsonWriter::close(char bracket) {
+    firstInScope.pop_back();
+    if (!compact) {
+        out += '\n';
+        out.append(firstInScope.size() * 2, ' ');
+    }
+    out += bracket;
+}
+
+JsonWriter& JsonWriter::field(const char* k, double v) {
+    key(k);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.6g", v);
+    out += buf;
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* k, uint64_t v) {
+    key(k);
+    out += to_string(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::flag(const char* k, bool v) {
+    key(k);
+    out += v ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* k, string_view v) {
+    key(k);
+    out += '"';
+    for (char c : v) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(const char* k, string_view v) {
+    key(k);
+    out += v;
+    return *this;
+}
+
+// ------------------- StartupTrace -------------------
+double StartupTrace::msSince(Clock::time_point from, Clock::time_point to) const {
+    return chrono::duration<double, milli>(to - from).count();
+}
+
+StartupTrace& StartupTrace::global() {
+    static StartupTrace trace;
+    return trace;
+}
+
+void StartupTrace::record(const char* name, Clock::time_point start, Clock::time_point end) {
+    lock_guard<mutex> guard(lock);
+    phases.push_back({name, msSince(origin, start), msSince(start, end)});
+}
+
+void StartupTrace::markReady() {
+    lock_guard<mutex> guard(lock);
+    if (readyMs < 0) readyMs = msSince(origin, Clock::now());
+}
+
+double StartupTrace::timeToInteractiveMs() const {
+    lock_guard<mutex> guard(lock);
+    return readyMs;
+}
+
+void StartupTrace::write(JsonWriter& json, const char* name) const {
+    lock_guard<mutex> guard(lock);
+    json.beginObject(name);
+    if (readyMs >= 0) json.field("interactive_ms", readyMs);
+    json.beginArray("phases");
+    for (const Phase& p : phases) json.beginObject().field("name", p.name).field("start_ms", p.startMs).field("ms", p.ms).endObject();
+    json.endArray();
+    json.endObject();
+}
+
+void StartupTrace::render(RenderBuffer& out) const {
+    lock_guard<mutex> guard(lock);
+    vector<Phase> ordered = phases;
+    stable_sort(ordered.begin(), ordered.end(), [](const Phase& a, const Phase& b) { return a.startMs < b.startMs; });
+    out << "Startup phases (ms from start):\n";
+    for (const Phase& p : ordered) {
+        char line[96];
+        snprintf(line, sizeof(line), "  %-20s %9.2f +%9.2f\n", p.name, p.startMs, p.ms);
+        out << line;
+    }
+    if (readyMs >= 0) {
+        char line[64];
+        snprintf(line, sizeof(line), "Interactive after %.2f ms.\n", readyMs);
+        out << line;
+    }
+}
+
+// ------------------- DbMetrics -------------------
+DbMetrics& DbMetrics::global() {
+    static DbMetrics metrics;
+    return metrics;
+}
+
+void DbMetrics::enable() {
+    sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 1);
+    on.store(true, memory_order_relaxed);
+}
+
+OperationStats* DbMetrics::action(string_view name) {
+    if (!enabled()) return nullptr;
+    lock_guard<mutex> guard(actionLock);
+    auto it = actions.find(name);
+    if (it == actions.end()) it = actions.emplace(piecewise_construct, forward_as_tuple(name), forward_as_tuple()).first;
+    return &it->second;
+}
+
+void DbMetrics::recordError(int rc, const char* message, const char* sql) {
+    stepErrors.fetch_add(1, memory_order_relaxed);
+    string text = string(sqlite3_errstr(rc)) + ": " + message + " [" + (sql ? sql : "") + "]";
+    cerr << "SQL error: " << text << endl;
+    lock_guard<mutex> guard(errorLock);
+    lastError = move(text);
+}
+
+void DbMetrics::collectCacheStats(sqlite3* db) {
+    auto take = [db](int op, atomic<uint64_t>& total) {
+        int current = 0, highwater = 0;
+        if (sqlite3_db_status(db, op, &current, &highwater, 1) == SQLITE_OK) total.fetch_add(current, memory_order_relaxed);
+    };
+    take(SQLITE_DBSTATUS_CACHE_HIT, cacheHits);
+    take(SQLITE_DBSTATUS_CACHE_MISS, cacheMisses);
+    take(SQLITE_DBSTATUS_CACHE_WRITE, cacheWrites);
+    take(SQLITE_DBSTATUS_CACHE_SPILL, cacheSpills);
+}
+
+string DbMetrics::json() const {
+    JsonWriter json;
+    json.beginObject();
+    json.field("enabled", uint64_t(enabled()));
+    json.field("timestamp", uint64_t(time(0)));
+    json.beginObject("operations");
+    for (int i = 0; i < int(DbOperation::Count); ++i) operations[i].write(json, dbOperationName(DbOperation(i)));
+    json.endObject();
+    json.beginObject("statements");
+    prepares.write(json, "prepare");
+    steps.write(json, "step");
+    finalizes.write(json, "finalize");
+    transactions.write(json, "transaction");
+    json.field("rollbacks", rollbacks.load(memory_order_relaxed));
+    json.field("busy_retries", busyRetries.load(memory_order_relaxed));
+    json.field("errors", stepErrors.load(memory_order_relaxed));
+    {
+        lock_guard<mutex> guard(errorLock);
+        if (!lastError.empty()) json.field("last_error", lastError);
+    }
+    json.endObject();
+    json.beginObject("page_cache");
+    json.field("hits", cacheHits.load(memory_order_relaxed));
+    json.field("misses", cacheMisses.load(memory_order_relaxed));
+    json.field("writes", cacheWrites.load(memory_order_relaxed));
+    json.field("spills", cacheSpills.load(memory_order_relaxed));
+    json.endObject();
+    json.beginObject("sqlite_memory");
+    auto status = [&](const char* name, int op) {
+        sqlite3_int64 current = 0, highwater = 0;
+        sqlite3_status64(op, &current, &highwater, 0);
+        json.beginObject(name);
+        json.field("current", uint64_t(current));
+        json.field("highwater", uint64_t(highwater));
+        json.endObject();
+    };
+    status("memory_used", SQLITE_STATUS_MEMORY_USED);
+    status("malloc_count", SQLITE_STATUS_MALLOC_COUNT);
+    status("largest_malloc", SQLITE_STATUS_MALLOC_SIZE);
+    status("pagecache_overflow", SQLITE_STATUS_PAGECACHE_OVERFLOW);
+    json.endObject();
+    {
+        lock_guard<mutex> guard(actionLock);
+        json.beginObject("menu_actions");
+        for (const auto& a : actions) a.second.write(json, a.first.c_str());
+        json.endObject();
+    }
+    StartupTrace::global().write(json, "startup");
+    json.endObject();
+    return json.text();
+}
+
+void DbMetrics::render(RenderBuffer& out) const {
+    out << "\n--- Database Statistics ---\n";
+    if (!enabled()) {
+        out << "Metrics are off. Start MediTrack with --metrics (or --metrics-file=PATH) to collect them.\n";
+        return;
+    }
+    out << "Operations:\n";
+    for (int i = 0; i < int(DbOperation::Count); ++i) operations[i].render(out, dbOperationName(DbOperation(i)));
+    out << "Statements:\n";
+    prepares.render(out, "prepare");
+    steps.render(out, "step");
+    finalizes.render(out, "finalize");
+    transactions.render(out, "transaction");
+    out << "  rollbacks " << (unsigned long long)rollbacks.load() << ", busy retries " << (unsigned long long)busyRetries.load()
+        << ", errors " << (unsigned long long)stepErrors.load() << "\n";
+    {
+        lock_guard<mutex> guard(errorLock);
+        if (!lastError.empty()) out << "  last error: " << lastError << "\n";
+    }
+    uint64_t hits = cacheHits.load(), misses = cacheMisses.load();
+    out << "Page cache: " << (unsigned long long)hits << " hits, " << (unsigned long long)misses << " misses";
+    if (hits + misses) out << " (" << 100.0 * hits / double(hits + misses) << "% hit)";
+    out << ", " << (unsigned long long)cacheWrites.load() << " writes, " << (unsigned long long)cacheSpills.load() << " spills\n";
+    sqlite3_int64 used = 0, peak = 0;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &used, &peak, 0);
+    out << "SQLite memory: " << (long long)used / 1024 << " KiB in use, " << (long long)peak / 1024 << " KiB peak\n";
+    lock_guard<mutex> guard(actionLock);
+    if (!actions.empty()) out << "Menu actions (including time spent at prompts):\n";
+    for (const auto& a : actions) a.second.render(out, a.first);
+}
+
+// ------------------- MetricsDumper -------------------
+void MetricsDumper::dump() {
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::trunc);
+        if (!out) return;
+        out << DbMetrics::global().json() << "\n";
+        if (!out) return;
+    }
+    rename(tmp.c_str(), path.c_str());
+}
+
+void MetricsDumper::run() {
+    unique_lock<mutex> guard(lock);
+    while (!wake.wait_for(guard, interval, [this] { return stopping; })) {
+        guard.unlock();
+        dump();
+        guard.lock();
+    }
+}
+
+void MetricsDumper::start(string file, chrono::seconds every) {
+    path = move(file);
+    interval = max(every, chrono::seconds(1));
+    if (!worker.joinable()) worker = thread(&MetricsDumper::run, this);
+}
+
+void MetricsDumper::stop() {
+    if (!worker.joinable()) return;
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    dump();
+}
@@ -0,0 +1,260 @@
+// PatientServer.cpp
+// The line-protocol patient server (POSIX only).
+#include "MediTrack.h"
+
+#ifndef _WIN32
+
+// ------------------- PatientServer -------------------
+const char* PatientServer::resolve(const string& ref, Patient*& patient) const {
+    long long id;
+    if (!parseNumber(ref, id)) return "bad patient id";
+    auto it = byId.find(id);
+    if (it == byId.end()) return "unknown patient";
+    patient = it->second;
+    return nullptr;
+}
+
+string PatientServer::answerRead(const Answer& a, const vector<string>& f) const {
+    const string& command = f[0];
+    JsonWriter json(true);
+    begin(json, a.line, command);
+    if (command == "get-patient") {
+        Patient* p;
+        if (f.size() != 2) return error(a.line, command, "usage: get-patient ID");
+        if (const char* e = resolve(f[1], p)) return error(a.line, command, e);
+        json.flag("ok", true);
+        registry.read(*p, [&](const Patient& patient) { writePatient(json, patient); });
+    } else if (command == "find") {
+        size_t limit = DefaultFindLimit;
+        if (f.size() < 2 || f.size() > 3 || (f.size() == 3 && !parseNumber(f[2], limit))) {
+            return error(a.line, command, "usage: find NAME-PREFIX [LIMIT]");
+        }
+        json.flag("ok", true);
+        json.beginArray("patients");
+        for (Patient* p : index.findByNamePrefix(f[1], limit)) {
+            registry.read(*p, [&](const Patient& patient) {
+                if (patient.isNew()) return; // no id to give out yet
+                json.beginObject().field("id", uint64_t(patient.getRowId())).field("name", patient.getName()).endObject();
+            });
+        }
+        json.endArray();
+    } else if (command == "query-trend") {
+        Patient* p;
+        TrendArgs args;
+        if (const char* e = parseTrend(f, args)) return error(a.line, command, e);
+        if (const char* e = resolve(f[1], p)) return error(a.line, command, e);
+        json.flag("ok", true);
+        registry.read(*p, [&](const Patient& patient) {
+            const VitalSeries& s = patient.getVitals().series(args.kind);
+            auto readings = s.range(args.from, args.to);
+            const auto& buckets = s.rollups().buckets(args.period());
+            auto window = s.rollups().range(args.period(), args.from, args.to);
+            writeTrend(json, patient.getRowId(), args, s, readings.first, readings.second,
+                       buckets.data() + window.first, window.second - window.first);
+        });
+    } else {
+        return error(a.line, command, "unknown command");
+    }
+    json.endObject();
+    return json.text();
+}
+
+void PatientServer::applyWrite(Answer& a, const vector<string>& f) {
+    if (f[0] == "add-patient") {
+        PatientArgs args;
+        if (const char* e = parsePatient(f, args)) { a.text = error(a.line, a.command, e); return; }
+        Patient& patient = registry.add(make_unique<Patient>(move(args.name), args.age, move(args.contact)));
+        patient.announceCreated();
+        a.patient = &patient;
+        a.created = true;
+    } else {
+        Patient* p;
+        RecordArgs args;
+        if (const char* e = parseRecord(f, args)) { a.text = error(a.line, a.command, e); return; }
+        if (const char* e = resolve(f[1], p)) { a.text = error(a.line, a.command, e); return; }
+        p->ensureHistory(); // loading takes the shard, so not inside the edit
+        registry.edit(*p, [&](Patient& patient) { patient.addVital(args.kind, args.timestamp, args.value1, args.value2); });
+        a.patient = p;
+    }
+    a.ticket = writer.queuedCount();
+}
+
+void PatientServer::finishWrite(Answer& a) {
+    if (writer.hasFailed(*a.patient)) {
+        a.text = error(a.line, a.command, "not written to the database yet; kept in memory and saved on shutdown");
+        return;
+    }
+    JsonWriter json(true);
+    begin(json, a.line, a.command);
+    json.flag("ok", true);
+    if (a.created) {
+        byId[a.patient->getRowId()] = const_cast<Patient*>(a.patient);
+        json.field("id", uint64_t(a.patient->getRowId()));
+    }
+    json.endObject();
+    a.text = json.text();
+}
+
+void PatientServer::pass() {
+    size_t written = writer.writtenCount(); // read first: applyCommitted covers at least these
+    writer.applyCommitted(&registry);
+
+    vector<Request> batch;
+    for (auto& c : connections) {
+        size_t start = 0, end;
+        bool held = c->awaiting > written; // behind a write that has not committed yet
+        while (!held && (end = c->in.find('\n', start)) != string::npos) {
+            string_view text = string_view(c->in).substr(start, end - start);
+            start = end + 1;
+            size_t first = text.find_first_not_of(" \t\r");
+            if (first == string_view::npos || text[first] == '#') continue;
+            ++requests;
+            Request r{c.get(), nullptr, {}};
+            bool parsed = tokenize(text, r.fields);
+            c->answers.push_back({++c->lines, parsed ? r.fields[0] : string()});
+            r.answer = &c->answers.back();
+            if (!parsed) r.answer->text = error(r.answer->line, "", "unterminated quote");
+            else {
+                held = isWrite(r.fields[0]); // the rest waits for this write's commit
+                batch.push_back(move(r));
+            }
+        }
+        c->in.erase(0, start);
+        if (!held && c->in.size() > MaxLine) {
+            c->answers.push_back({++c->lines, ""});
+            c->answers.back().text = error(c->lines, "", "request too long");
+            c->in.clear();
+            c->closing = true;
+        }
+    }
+
+    vector<function<void()>> reads;
+    bool wrote = false;
+    auto runReads = [&] {
+        if (!reads.empty()) pool.run(move(reads));
+        reads.clear();
+    };
+    for (Request& r : batch) {
+        if (isWrite(r.fields[0])) {
+            runReads(); // reads that arrived first see the state before this write
+            applyWrite(*r.answer, r.fields);
+            r.connection->awaiting = r.answer->ticket;
+            wrote = wrote || r.answer->ticket;
+        } else {
+            reads.push_back([this, &r] { r.answer->text = answerRead(*r.answer, r.fields); });
+        }
+    }
+    runReads();
+    if (wrote) writer.commitNow();
+
+    for (auto& c : connections) {
+        while (!c->answers.empty()) {
+            Answer& a = c->answers.front();
+            if (a.ticket > written) break;
+            if (a.text.empty()) finishWrite(a);
+            c->out += a.text;
+            c->out += '\n';
+            c->answers.pop_front();
+        }
+    }
+}
+
+bool PatientServer::awaitingWrites() const {
+    for (const auto& c : connections) {
+        if ((!c->answers.empty() && c->answers.front().ticket) || hasRequests(*c)) return true;
+    }
+    return false;
+}
+
+void PatientServer::acceptAll() {
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        connections.push_back(make_unique<Connection>(fd));
+        ++accepted;
+    }
+}
+
+void PatientServer::receive(Connection& c) {
+    char buffer[16 * 1024];
+    while (true) {
+        ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) { c.in.append(buffer, size_t(n)); continue; }
+        if (n == 0) c.closing = true;
+        else if (errno == EINTR) continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK) c.broken = true;
+        return;
+    }
+}
+
+void PatientServer::transmit(Connection& c) {
+    size_t sent = 0;
+    while (sent < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + sent, c.out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) { sent += size_t(n); continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) c.broken = true;
+        break;
+    }
+    c.out.erase(0, sent);
+}
+
+PatientServer::PatientServer(PatientRegistry& patients, const PatientIndex& search, WriteBehind& background, WorkStealingPool& readers)
+    : registry(patients), index(search), writer(background), pool(readers) {
+    for (const auto& p : registry.patients()) {
+        if (!p->isNew()) byId[p->getRowId()] = p.get();
+    }
+}
+
+PatientServer::~PatientServer() {
+    for (auto& c : connections) close(c->fd);
+    if (listener >= 0) close(listener);
+}
+
+bool PatientServer::listen(uint16_t port) {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) { perror("socket"); return false; }
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listener, 128) < 0) {
+        perror("Could not listen");
+        return false;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void PatientServer::run(const volatile sig_atomic_t& stop) {
+    vector<pollfd> fds;
+    while (!stop) {
+        fds.assign(1, pollfd{listener, POLLIN, 0});
+        for (const auto& c : connections) fds.push_back({c->fd, short(POLLIN | (c->out.empty() ? 0 : POLLOUT)), 0});
+        // While answers wait on the writer, check on it every millisecond.
+        if (poll(fds.data(), fds.size(), awaitingWrites() ? 1 : 250) < 0 && errno != EINTR) {
+            perror("poll");
+            return;
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) receive(*connections[i - 1]);
+        }
+        if (fds[0].revents & POLLIN) acceptAll();
+        pass();
+        for (auto& c : connections) {
+            if (!c->out.empty()) transmit(*c);
+        }
+        connections.erase(remove_if(connections.begin(), connections.end(), [](const unique_ptr<Connection>& c) {
+            bool done = c->broken || (c->closing && c->answers.empty() && c->out.empty() && !hasRequests(*c));
+            if (done) close(c->fd);
+            return done;
+        }), connections.end());
+    }
+}
+
+#endif
@@ -0,0 +1,271 @@
+// Patients.cpp
+// The patient roster and the observers that follow it: alert states, the reminder
+// scheduler and the name index.
+#include "MediTrack.h"
+
+// ------------------- AlertEngine -------------------
+void AlertEngine::apply(const Patient& patient, VitalKind kind, unsigned bits) {
+    auto& kinds = perKind[&patient];
+    kinds[int(kind)] = bits;
+    unsigned all = 0;
+    for (unsigned k : kinds) all |= k;
+    for (int st = 0; st < AlertStateCount; ++st) {
+        if (all & (1u << st)) inState[st].insert(&patient);
+        else inState[st].erase(&patient);
+    }
+    if (all) alerting.insert(&patient);
+    else alerting.erase(&patient);
+}
+
+AlertEngine::AlertEngine() {
+    forEachVitalKind([&](auto kind) {
+        if constexpr (VitalTraits<kind>::hasLimits) rules.push_back(make_unique<ThresholdRule<kind>>());
+    });
+    Patient::addObserver(this);
+}
+
+void AlertEngine::evaluate(const Patient& patient, VitalKind kind, const VitalReading& latest, const VitalReading* previous) {
+    unsigned bits = 0;
+    for (const auto& rule : rules) {
+        if (rule->kind() == kind) bits |= rule->evaluate(latest, previous);
+    }
+    apply(patient, kind, bits);
+}
+
+void AlertEngine::onVitalAdded(const Patient& patient, VitalKind kind, const VitalSeries& s, size_t index) {
+    // Only the two newest readings feed the rules; older back-filled ones change nothing.
+    if (index + 2 < s.size()) return;
+    size_t last = s.latest();
+    VitalReading latest{s.times()[last], s.values1()[last], s.secondAt(last)};
+    if (last == 0) { evaluate(patient, kind, latest, nullptr); return; }
+    VitalReading previous{s.times()[last - 1], s.values1()[last - 1], s.secondAt(last - 1)};
+    evaluate(patient, kind, latest, &previous);
+}
+
+void AlertEngine::onPatientDestroyed(const Patient& patient) {
+    if (perKind.erase(&patient) == 0) return;
+    for (auto& set : inState) set.erase(&patient);
+    alerting.erase(&patient);
+}
+
+// ------------------- ReminderScheduler -------------------
+time_t ReminderScheduler::addDays(time_t t, int days) {
+    tm when = LocalCalendar::localParts(t);
+    time_t quick;
+    if (LocalCalendar::quickLocalTime(LocalCalendar::civilDay(when) + days, when.tm_hour * 3600 + when.tm_min * 60 + when.tm_sec, quick))
+        return quick;
+    when.tm_mday += days;
+    when.tm_isdst = -1;
+    return mktime(&when);
+}
+
+int ReminderScheduler::periodDays(ReminderFrequency f) {
+    return f == ReminderFrequency::Daily ? 1 : f == ReminderFrequency::Weekly ? 7 : 0;
+}
+
+void ReminderScheduler::arm(Entry entry, time_t now) {
+    time_t due;
+    if (!entry.reminder.firstOccurrence(due)) return;
+    time_t today = LocalCalendar::dayStart(now);
+    if (due < today) {
+        int period = periodDays(entry.reminder.getFrequency());
+        if (period == 0) return; // a one-off reminder from an earlier day has passed
+        int days = int((today - due) / (24 * 60 * 60));
+        days = (days + period - 1) / period * period;
+        due = addDays(due, days);
+        if (due < today) due = addDays(due, period);
+    }
+    entries.push_back(move(entry));
+    upcoming.push({due, entries.size() - 1});
+}
+
+vector<const ReminderScheduler::Entry*> ReminderScheduler::popDue(time_t now) {
+    vector<const Entry*> fired;
+    while (!upcoming.empty() && upcoming.top().first <= now) {
+        Slot slot = upcoming.top();
+        upcoming.pop();
+        const Entry& e = entries[slot.second];
+        fired.push_back(&e);
+        if (int period = periodDays(e.reminder.getFrequency())) {
+            upcoming.push({addDays(slot.first, period), slot.second});
+        }
+    }
+    return fired;
+}
+
+void ReminderScheduler::announce(const Entry& e) {
+    cout << "⚠️ Reminder Due for " << e.patientName << ": ";
+    e.reminder.display();
+}
+
+void ReminderScheduler::run() {
+    unique_lock<mutex> guard(lock);
+    while (!stopping) {
+        if (upcoming.empty()) {
+            wake.wait(guard);
+        } else {
+            wake.wait_until(guard, chrono::system_clock::from_time_t(upcoming.top().first));
+        }
+        if (stopping) break;
+        auto fired = popDue(time(0));
+        if (!fired.empty()) cout << "\n";
+        for (const Entry* e : fired) announce(*e);
+        cout.flush();
+    }
+}
+
+ReminderScheduler::~ReminderScheduler() {
+    Patient::removeObserver(this);
+    stop();
+}
+
+void ReminderScheduler::schedule(string_view patientName, const Reminder& reminder) {
+    Entry entry{StringPool::shared().intern(patientName), reminder};
+    lock_guard<mutex> guard(lock);
+    arm(move(entry), time(0));
+    wake.notify_one();
+}
+
+void ReminderScheduler::onReminderAdded(const Patient& patient, const Reminder& reminder) {
+    if (reminder.isNew()) schedule(patient.getName(), reminder);
+}
+
+size_t ReminderScheduler::fireDue() {
+    lock_guard<mutex> guard(lock);
+    auto fired = popDue(time(0));
+    for (const Entry* e : fired) announce(*e);
+    return fired.size();
+}
+
+size_t ReminderScheduler::pending() const {
+    lock_guard<mutex> guard(lock);
+    return upcoming.size();
+}
+
+void ReminderScheduler::start() {
+    if (!worker.joinable()) worker = thread(&ReminderScheduler::run, this);
+}
+
+void ReminderScheduler::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) worker.join();
+}
+
+// ------------------- PatientIndex -------------------
+uint64_t PatientIndex::headOf(string_view s) {
+    uint64_t h = 0;
+    for (size_t i = 0; i < 8; ++i) h = (h << 8) | (i < s.size() ? (unsigned char)s[i] : 0);
+    return h;
+}
+
+void PatientIndex::appendContactKey(string_view contact, string& out) {
+    size_t start = out.size();
+    for (char c : contact) if (c >= '0' && c <= '9') out.push_back(c);
+    if (out.size() == start) for (char c : contact) out.push_back(foldChar(c));
+}
+
+bool PatientIndex::keyLess(const Key& a, const Key& b) const {
+    if (a.head != b.head) return a.head < b.head;
+    int c = text(a).compare(text(b));
+    return c != 0 ? c < 0 : a.position < b.position;
+}
+
+vector<PatientIndex::Key>::const_iterator PatientIndex::seek(const vector<Key>& keys, string_view q) const {
+    Key probe{headOf(q), 0, 0, 0};
+    return lower_bound(keys.begin(), keys.end(), probe, [&](const Key& k, const Key& p) {
+        return k.head != p.head ? k.head < p.head : text(k) < q;
+    });
+}
+
+void PatientIndex::appendKeys(uint32_t position, vector<Key>& nameKeys, vector<Key>& contactKeys) {
+    const Patient& p = *patients[position];
+    size_t start = folded.size();
+    for (char c : p.getName()) folded.push_back(foldChar(c));
+    size_t end = folded.size();
+    folded.push_back('\0'); // keys are separate strings in the buffer
+    for (size_t i = start; i < end; ++i) {
+        if (folded[i] != ' ' && (i == start || folded[i - 1] == ' ')) {
+            nameKeys.push_back({headOf(string_view(folded).substr(i, end - i)), uint32_t(i), uint32_t(end - i), position});
+        }
+    }
+    start = folded.size();
+    appendContactKey(p.getContact(), folded);
+    contactKeys.push_back({headOf(string_view(folded).substr(start)), uint32_t(start), uint32_t(folded.size() - start), position});
+    folded.push_back('\0');
+}
+
+void PatientIndex::sortKeys(vector<Key>& keys) const {
+    sort(keys.begin(), keys.end(), [this](const Key& a, const Key& b) { return keyLess(a, b); });
+}
+
+void PatientIndex::insertSorted(vector<Key>& keys, const Key& k) const {
+    keys.insert(upper_bound(keys.begin(), keys.end(), k, [this](const Key& a, const Key& b) { return keyLess(a, b); }), k);
+}
+
+void PatientIndex::rebuild() {
+    folded.clear();
+    names.clear();
+    contacts.clear();
+    contacts.reserve(patients.size());
+    for (uint32_t i = 0; i < patients.size(); ++i) appendKeys(i, names, contacts);
+    sortKeys(names);
+    sortKeys(contacts);
+}
+
+void PatientIndex::onPatientCreated(const Patient& patient) {
+    if (patients.empty() || patients.back().get() != &patient) return;
+    vector<Key> nameKeys, contactKeys;
+    appendKeys(uint32_t(patients.size() - 1), nameKeys, contactKeys);
+    for (const Key& k : nameKeys) insertSorted(names, k);
+    for (const Key& k : contactKeys) insertSorted(contacts, k);
+}
+
+vector<Patient*> PatientIndex::findByNamePrefix(string_view prefix, size_t limit) const {
+    string q;
+    for (char c : prefix) q.push_back(foldChar(c));
+    vector<Patient*> found;
+    if (q.empty()) return found;
+    unordered_set<uint32_t> seen;
+    for (auto it = seek(names, q); it != names.end() && found.size() < limit && text(*it).substr(0, q.size()) == q; ++it) {
+        if (seen.insert(it->position).second) found.push_back(patients[it->position].get());
+    }
+    return found;
+}
+
+vector<Patient*> PatientIndex::findByContact(string_view contact) const {
+    string q;
+    appendContactKey(contact, q);
+    vector<Patient*> found;
+    for (auto it = seek(contacts, q); it != contacts.end() && text(*it) == q; ++it) {
+        found.push_back(patients[it->position].get());
+    }
+    return found;
+}
+
+// ------------------- PatientRegistry -------------------
+void PatientRegistry::publish(Patient* patient) {
+    if (!all.push_back(patient) || !shards[shardOf(patient)].members.push_back(patient)) {
+        cerr << "Patient registry is full; patient not visible to readers.\n";
+    }
+}
+
+size_t PatientRegistry::shardOf(const Patient* patient) {
+    return size_t((uint64_t(reinterpret_cast<uintptr_t>(patient)) * 0x9E3779B97F4A7C15ull) >> 32) % ShardCount;
+}
+
+Patient& PatientRegistry::add(unique_ptr<Patient> patient) {
+    Patient* p = patient.get();
+    owned.push_back(move(patient));
+    publish(p);
+    return *p;
+}
+
+void PatientRegistry::adopt(vector<unique_ptr<Patient>>& loaded) {
+    owned.reserve(owned.size() + loaded.size());
+    for (auto& patient : loaded) add(move(patient));
+    loaded.clear();
+}
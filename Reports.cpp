@@ -0,0 +1,189 @@
+// Reports.cpp
+// Population reports and the work-stealing pool they run on.
+#include "MediTrack.h"
+
+// ------------------- WorkStealingPool -------------------
+bool WorkStealingPool::runOne(size_t self) {
+    function<void()> task;
+    for (size_t k = 0; k < queues.size() && !task; ++k) {
+        Queue& q = *queues[(self + k) % queues.size()];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) continue;
+        if (k == 0) { task = move(q.tasks.back()); q.tasks.pop_back(); }
+        else { task = move(q.tasks.front()); q.tasks.pop_front(); }
+    }
+    if (!task) return false;
+    queued.fetch_sub(1, memory_order_relaxed);
+    task();
+    if (unfinished.fetch_sub(1, memory_order_acq_rel) == 1) {
+        lock_guard<mutex> guard(idle);
+        finished.notify_all();
+    }
+    return true;
+}
+
+void WorkStealingPool::workerLoop(size_t self) {
+    for (;;) {
+        if (runOne(self)) continue;
+        unique_lock<mutex> guard(idle);
+        work.wait(guard, [&] { return stopping || queued.load(memory_order_relaxed) > 0; });
+        if (stopping) return;
+    }
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    threads = max(1u, threads);
+    for (unsigned t = 0; t < threads; ++t) queues.push_back(make_unique<Queue>());
+    for (unsigned t = 1; t < threads; ++t) workers.emplace_back([this, t] { workerLoop(t); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> guard(idle);
+        stopping = true;
+    }
+    work.notify_all();
+    for (thread& w : workers) w.join();
+}
+
+void WorkStealingPool::run(vector<function<void()>> tasks) {
+    if (tasks.empty()) return;
+    unfinished.fetch_add(tasks.size(), memory_order_relaxed);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        Queue& q = *queues[i % queues.size()];
+        lock_guard<mutex> guard(q.lock);
+        q.tasks.push_back(move(tasks[i]));
+    }
+    {
+        lock_guard<mutex> guard(idle);
+        queued.fetch_add(tasks.size(), memory_order_relaxed);
+    }
+    work.notify_all();
+    while (runOne(0)) {}
+    unique_lock<mutex> guard(idle);
+    finished.wait(guard, [&] { return unfinished.load(memory_order_acquire) == 0; });
+}
+
+// ------------------- PopulationReport -------------------
+void PopulationReport::add(const Patient& p, const ReportOptions& opt) {
+    ++patients;
+    const VitalsStore& store = p.getVitals();
+    VitalsSummary s = summarizeVitals(store);
+    if (s.bloodPressure.high + s.bloodPressure.low + s.sugar.high + s.sugar.low > 0) ++withAbnormalReadings;
+    vitals.merge(s);
+
+    time_t newest = numeric_limits<time_t>::min();
+    for (VitalKind kind : allVitalKinds) {
+        const VitalSeries& series = store.series(kind);
+        if (!series.hasLatest()) continue;
+        size_t i = series.latest();
+        newest = max(newest, series.times()[i]);
+        VitalReading latest{series.times()[i], series.values1()[i], series.secondAt(i)};
+        unsigned bits = vitalInfo(kind).alerts(latest.value1, latest.value2);
+        for (int st = 0; st < AlertStateCount; ++st) alerting[st] += (bits & alertBit(AlertState(st))) != 0;
+        if (kind == VitalKind::Weight) {
+            int band = latest.value1 < 50 ? 0 : int(min(double(WeightBands - 1), (latest.value1 - 40) / 10));
+            ++latestWeight[band];
+        }
+    }
+    if (!store.series(VitalKind::Weight).hasLatest()) ++withoutWeight;
+    if (newest == numeric_limits<time_t>::min()) ++withoutReadings;
+    if (newest < opt.now - time_t(opt.inactiveDays) * 24 * 60 * 60) inactive.add(p, opt.listLimit);
+
+    if (!p.getMedications().empty()) {
+        const auto& reminders = p.getReminders();
+        if (reminders.empty()) {
+            noReminders.add(p, opt.listLimit);
+        } else if (all_of(reminders.begin(), reminders.end(), [&](const Reminder& r) {
+                       return r.getFrequency() == ReminderFrequency::Once && r.startsBefore(opt.today, opt.minuteOfDay);
+                   })) {
+            remindersLapsed.add(p, opt.listLimit);
+        }
+    }
+}
+
+void PopulationReport::merge(const PopulationReport& o, size_t limit) {
+    patients += o.patients;
+    withoutReadings += o.withoutReadings;
+    withAbnormalReadings += o.withAbnormalReadings;
+    vitals.merge(o.vitals);
+    for (int st = 0; st < AlertStateCount; ++st) alerting[st] += o.alerting[st];
+    for (int b = 0; b < WeightBands; ++b) latestWeight[b] += o.latestWeight[b];
+    withoutWeight += o.withoutWeight;
+    noReminders.merge(o.noReminders, limit);
+    remindersLapsed.merge(o.remindersLapsed, limit);
+    inactive.merge(o.inactive, limit);
+}
+
+void PopulationReport::render(RenderBuffer& out, const ReportOptions& opt) const {
+    auto listing = [&](const char* title, const Listing& l) {
+        out << title << ": " << (unsigned long long)l.count << "\n";
+        for (const string& name : l.names) out << "  - " << name << "\n";
+        if (l.count > l.names.size()) out << "  (" << (unsigned long long)(l.count - l.names.size()) << " more)\n";
+    };
+    out << "\n--- Population Report (" << (unsigned long long)patients << " patients) ---\n";
+    out << "Readings: " << (unsigned long long)(vitals.systolic.count + vitals.weight.count + vitals.sugar.count)
+        << "; patients with none: " << (unsigned long long)withoutReadings << "\n";
+    out << "Abnormal readings: blood pressure " << (unsigned long long)vitals.bloodPressure.high << " high, "
+        << (unsigned long long)vitals.bloodPressure.low << " low; blood sugar " << (unsigned long long)vitals.sugar.high
+        << " high, " << (unsigned long long)vitals.sugar.low << " low; patients with any: "
+        << (unsigned long long)withAbnormalReadings << "\n";
+    out << "Alerting now (newest reading):\n";
+    for (int st = 0; st < AlertStateCount; ++st) {
+        out << "  " << alertStateName(AlertState(st)) << ": " << (unsigned long long)alerting[st] << "\n";
+    }
+    out << "Latest weight (no stored heights, so no BMI):\n";
+    for (int b = 0; b < WeightBands; ++b) {
+        if (b == 0) out << "  under 50 kg";
+        else if (b == WeightBands - 1) out << "  " << 40 + 10 * b << " kg and over";
+        else out << "  " << 40 + 10 * b << "-" << 49 + 10 * b << " kg";
+        out << ": " << (unsigned long long)latestWeight[b] << "\n";
+    }
+    out << "  no weight recorded: " << (unsigned long long)withoutWeight << "\n";
+    listing("On medication, no reminders set", noReminders);
+    listing("On medication, all reminders passed", remindersLapsed);
+    out << "No readings in the last " << opt.inactiveDays << " days";
+    listing("", inactive);
+    out << "---------------------------------\n";
+}
+
+// ------------------- ReportEngine -------------------
+PopulationReport ReportEngine::run(const PatientRegistry& registry, WorkStealingPool& pool, const DatabaseManager* db,
+                                   const ReportOptions& opt) {
+    size_t n = registry.size();
+    size_t partitions = (n + PartitionSize - 1) / PartitionSize;
+    vector<PopulationReport> partial(partitions);
+    vector<function<void()>> tasks;
+    tasks.reserve(partitions);
+    for (size_t t = 0; t < partitions; ++t) {
+        tasks.push_back([&, t] {
+            runPartition(registry, t * PartitionSize, min(n, (t + 1) * PartitionSize), db, opt, partial[t]);
+        });
+    }
+    pool.run(move(tasks));
+    PopulationReport total;
+    for (const PopulationReport& r : partial) total.merge(r, opt.listLimit);
+    return total;
+}
+
+void ReportEngine::runPartition(const PatientRegistry& registry, size_t first, size_t last, const DatabaseManager* db,
+                                const ReportOptions& opt, PopulationReport& out) {
+    vector<long long> stored; // row ids of patients whose history is only in the database
+    registry.forRange(first, last, [&](const Patient& p) {
+        if (p.isHistoryLoaded() || p.isNew()) out.add(p, opt);
+        else stored.push_back(p.getRowId());
+    });
+    if (stored.empty() || !db) return;
+    pmr::unsynchronized_pool_resource memory;
+    vector<unique_ptr<Patient>> loaded;
+    DatabaseManager reader(db->fileName());
+    auto [lo, hi] = minmax_element(stored.begin(), stored.end());
+    if (!reader.openReadOnly(db->connectionProfile()) || !reader.loadPatientRange(loaded, *lo, *hi, &memory)) {
+        cerr << "Report could not read " << stored.size() << " patients from the database.\n";
+        return;
+    }
+    sort(stored.begin(), stored.end());
+    for (const auto& p : loaded) {
+        if (binary_search(stored.begin(), stored.end(), p->getRowId())) out.add(*p, opt);
+    }
+}
@@ -0,0 +1,320 @@
+// Snapshot.cpp
+// Memory-mapped snapshots: writing and opening them, and the history cache that
+// loads patient histories from one on demand.
+#include "MediTrack.h"
+
+// ------------------- MappedFile -------------------
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (base && length) munmap(const_cast<char*>(base), length);
+#endif
+}
+
+bool MappedFile::open(const string& path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    length = (size_t)st.st_size;
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { ::close(fd); length = 0; return false; }
+        madvise(p, length, MADV_SEQUENTIAL);
+        base = (const char*)p;
+    }
+    ::close(fd);
+    return true;
+#else
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    base = buffer.data();
+    length = buffer.size();
+    return true;
+#endif
+}
+
+void MappedFile::willNeed() const {
+#ifndef _WIN32
+    if (base && length) madvise(const_cast<char*>(base), length, MADV_WILLNEED);
+#endif
+}
+
+// ------------------- FilePrefetcher -------------------
+FilePrefetcher::~FilePrefetcher() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+}
+
+void FilePrefetcher::start(vector<string> paths) {
+    worker = thread([this, paths = move(paths)] {
+        auto phase = StartupTrace::global().phase("prefetch");
+        for (const string& path : paths) {
+            MappedFile file;
+            if (!file.open(path)) continue;
+            file.willNeed();
+            string_view bytes = file.contents();
+            volatile char sink = 0;
+            for (size_t at = 0; at < bytes.size() && !stopping; at += 4096) sink = sink + bytes[at];
+        }
+    });
+}
+
+// ------------------- SnapshotWriter -------------------
+SnapshotString SnapshotWriter::intern(string_view text) {
+    SnapshotString ref{(uint32_t)strings.size(), (uint32_t)text.size()};
+    strings += text;
+    return ref;
+}
+
+bool SnapshotWriter::write(const string& path, const vector<unique_ptr<Patient>>& patients, long long generation) {
+    vector<SnapshotPatient> index;
+    vector<SnapshotMedication> meds;
+    vector<SnapshotReminder> rems;
+    index.reserve(patients.size());
+    for (const auto& patient : patients) {
+        if (patient->isNew() || !patient->isHistoryLoaded()) return false;
+        SnapshotPatient entry = {};
+        entry.rowId = patient->getRowId();
+        entry.age = patient->getAge();
+        entry.name = intern(patient->getName());
+        entry.contact = intern(patient->getContact());
+        size_t columnsStart = columns.size();
+        for (VitalKind kind : allVitalKinds) {
+            const VitalSeries& s = patient->getVitals().series(kind);
+            entry.vitals[int(kind)] = {columns.size(), s.size()};
+            appendColumn(s.times());
+            appendColumn(s.values1());
+            if (s.hasSecondValue()) appendColumn(s.values2());
+            for (size_t i = 0; i < s.size(); ++i) {
+                long long id = s.rowIdAt(i);
+                columns.append((const char*)&id, sizeof(id));
+            }
+        }
+        entry.columnsBytes = columns.size() - columnsStart;
+        entry.columnsChecksum = snapshotChecksum(columns.data() + columnsStart, entry.columnsBytes);
+        entry.firstMedication = (uint32_t)meds.size();
+        for (const auto& m : patient->getMedications()) {
+            meds.push_back({m.getRowId(), intern(m.getName()), intern(m.getDosage()), intern(m.getSchedule()), {0, 0}});
+        }
+        entry.medicationCount = (uint32_t)(meds.size() - entry.firstMedication);
+        entry.firstReminder = (uint32_t)rems.size();
+        for (const auto& r : patient->getReminders()) {
+            rems.push_back({r.getRowId(), intern(r.getMessage()), intern(r.getDate()), intern(r.getTime()),
+                            (uint32_t)r.getFrequency(), 0});
+        }
+        entry.reminderCount = (uint32_t)(rems.size() - entry.firstReminder);
+        index.push_back(entry);
+    }
+    if (strings.size() > numeric_limits<uint32_t>::max()) return false;
+    sort(index.begin(), index.end(), [](const SnapshotPatient& a, const SnapshotPatient& b) { return a.rowId < b.rowId; });
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+    header.version = SnapshotVersion;
+    header.byteOrder = SnapshotByteOrder;
+    header.generation = (uint64_t)generation;
+
+    string image(sizeof(SnapshotHeader), '\0');
+    auto section = [&](const void* data, size_t bytes) {
+        uint64_t offset = image.size();
+        image.append((const char*)data, bytes);
+        pad(image);
+        return offset;
+    };
+    header.patientCount = index.size();
+    header.patientsOffset = section(index.data(), index.size() * sizeof(SnapshotPatient));
+    header.medicationCount = meds.size();
+    header.medicationsOffset = section(meds.data(), meds.size() * sizeof(SnapshotMedication));
+    header.reminderCount = rems.size();
+    header.remindersOffset = section(rems.data(), rems.size() * sizeof(SnapshotReminder));
+    header.stringsBytes = strings.size();
+    header.stringsOffset = section(strings.data(), strings.size());
+    header.columnsBytes = columns.size();
+    header.columnsOffset = section(columns.data(), columns.size());
+    for (SnapshotPatient& entry : index) {
+        for (SnapshotSeries& s : entry.vitals) s.offset += header.columnsOffset;
+    }
+    memcpy(&image[header.patientsOffset], index.data(), index.size() * sizeof(SnapshotPatient));
+    header.fileBytes = image.size();
+    header.checksum = snapshotChecksum(image.data() + sizeof(SnapshotHeader), header.columnsOffset - sizeof(SnapshotHeader));
+    memcpy(&image[0], &header, sizeof(header));
+
+    string temp = path + ".tmp";
+    {
+        ofstream out(temp, ios::binary | ios::trunc);
+        if (!out.write(image.data(), image.size())) return false;
+    }
+    return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+// ------------------- Snapshot -------------------
+bool Snapshot::sectionFits(uint64_t offset, uint64_t count, size_t size) const {
+    return offset <= header->fileBytes && count <= (header->fileBytes - offset) / size;
+}
+
+bool Snapshot::open(const string& path) {
+    if (!file.open(path)) return false;
+    string_view data = file.contents();
+    if (data.size() < sizeof(SnapshotHeader)) return false;
+    header = (const SnapshotHeader*)data.data();
+    if (memcmp(header->magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 || header->version != SnapshotVersion
+        || header->byteOrder != SnapshotByteOrder || header->fileBytes != data.size()) return false;
+    if (!sectionFits(header->patientsOffset, header->patientCount, sizeof(SnapshotPatient))
+        || !sectionFits(header->medicationsOffset, header->medicationCount, sizeof(SnapshotMedication))
+        || !sectionFits(header->remindersOffset, header->reminderCount, sizeof(SnapshotReminder))
+        || !sectionFits(header->stringsOffset, header->stringsBytes, 1)
+        || !sectionFits(header->columnsOffset, header->columnsBytes, 1)
+        || header->columnsOffset < sizeof(SnapshotHeader)) return false;
+    if (snapshotChecksum(data.data() + sizeof(SnapshotHeader), header->columnsOffset - sizeof(SnapshotHeader)) != header->checksum) return false;
+    patients = at<SnapshotPatient>(header->patientsOffset);
+    medications = at<SnapshotMedication>(header->medicationsOffset);
+    reminders = at<SnapshotReminder>(header->remindersOffset);
+    strings = at<char>(header->stringsOffset);
+    return true;
+}
+
+const SnapshotPatient* Snapshot::find(long long rowId) const {
+    const SnapshotPatient* end = patients + header->patientCount;
+    const SnapshotPatient* it = lower_bound(patients, end, rowId,
+        [](const SnapshotPatient& p, long long id) { return p.rowId < id; });
+    if (it == end || it->rowId != rowId) return nullptr;
+    uint64_t start = it->vitals[0].offset;
+    if (start < header->columnsOffset || it->columnsBytes > header->columnsOffset + header->columnsBytes - start) return nullptr;
+    if (snapshotChecksum(at<char>(start), it->columnsBytes) != it->columnsChecksum) return nullptr;
+    return it;
+}
+
+ColumnView<time_t> Snapshot::times(const SnapshotPatient& p, VitalKind kind) const {
+    const SnapshotSeries& s = p.vitals[int(kind)];
+    const time_t* t = at<time_t>(s.offset);
+    return ColumnView<time_t>(t, t + s.count);
+}
+
+ColumnView<double> Snapshot::values1(const SnapshotPatient& p, VitalKind kind) const {
+    const SnapshotSeries& s = p.vitals[int(kind)];
+    const double* v = at<double>(s.offset + s.count * sizeof(time_t));
+    return ColumnView<double>(v, v + s.count);
+}
+
+ColumnView<double> Snapshot::values2(const SnapshotPatient& p, VitalKind kind) const {
+    const SnapshotSeries& s = p.vitals[int(kind)];
+    if (!vitalHasSecondValue(kind)) return ColumnView<double>(nullptr, nullptr);
+    const double* v = at<double>(s.offset + s.count * (sizeof(time_t) + sizeof(double)));
+    return ColumnView<double>(v, v + s.count);
+}
+
+ColumnView<long long> Snapshot::rowIds(const SnapshotPatient& p, VitalKind kind) const {
+    const SnapshotSeries& s = p.vitals[int(kind)];
+    size_t columns = 1 + vitalInfo(kind).values;
+    const long long* v = at<long long>(s.offset + s.count * columns * sizeof(double));
+    return ColumnView<long long>(v, v + s.count);
+}
+
+void Snapshot::loadPatientSummaries(vector<unique_ptr<Patient>>& out, HistoryCache* cache,
+                                    pmr::memory_resource* memory) const {
+    out.clear();
+    out.reserve(header->patientCount);
+    for (size_t i = 0; i < header->patientCount; ++i) {
+        const SnapshotPatient& p = patients[i];
+        auto patient = make_unique<Patient>(string(text(p.name)), p.age, string(text(p.contact)), memory);
+        patient->markSaved(p.rowId);
+        patient->attachHistoryCache(cache);
+        out.push_back(move(patient));
+    }
+    cout << "Loaded " << out.size() << " patient summaries from snapshot.\n";
+}
+
+bool Snapshot::loadHistory(Patient& patient) const {
+    const SnapshotPatient* p = find(patient.getRowId());
+    if (!p) return false;
+    bool wasDirty = patient.hasUnsavedHistory();
+    for (VitalKind kind : allVitalKinds) {
+        ColumnView<time_t> t = times(*p, kind);
+        ColumnView<double> v1 = values1(*p, kind), v2 = values2(*p, kind);
+        ColumnView<long long> ids = rowIds(*p, kind);
+        for (size_t i = 0; i < t.size(); ++i) patient.addVital(kind, t[i], v1[i], v2.empty() ? 0.0 : v2[i], ids[i]);
+    }
+    for (uint32_t i = 0; i < p->medicationCount; ++i) {
+        const SnapshotMedication& m = medications[p->firstMedication + i];
+        Medication med(text(m.name), text(m.dosage), text(m.schedule));
+        med.markSaved(m.rowId);
+        patient.addMedication(med);
+    }
+    for (uint32_t i = 0; i < p->reminderCount; ++i) {
+        const SnapshotReminder& r = reminders[p->firstReminder + i];
+        Reminder rem(text(r.message), text(r.date), text(r.time), ReminderFrequency(r.frequency));
+        rem.markSaved(r.rowId);
+        patient.addReminder(rem);
+    }
+    if (!wasDirty) patient.markHistorySaved();
+    return true;
+}
+
+bool Snapshot::loadVitalsInRange(long long patientId, VitalKind kind, time_t from, time_t to, VitalSeries& out) const {
+    const SnapshotPatient* p = find(patientId);
+    if (!p) return false;
+    ColumnView<time_t> t = times(*p, kind);
+    ColumnView<double> v1 = values1(*p, kind), v2 = values2(*p, kind);
+    ColumnView<long long> ids = rowIds(*p, kind);
+    size_t lo = lower_bound(t.begin(), t.end(), from) - t.begin();
+    size_t hi = upper_bound(t.begin() + lo, t.end(), to) - t.begin();
+    for (size_t i = lo; i < hi; ++i) out.insert(t[i], v1[i], v2.empty() ? 0.0 : v2[i], ids[i]);
+    return true;
+}
+
+// ------------------- HistoryCache -------------------
+void HistoryCache::remeasureFront() {
+    if (lru.empty()) return;
+    Entry& e = position[lru.front()];
+    usedBytes -= e.bytes;
+    e.bytes = lru.front()->historyBytes();
+    usedBytes += e.bytes;
+}
+
+void HistoryCache::evictOverBudget() {
+    if (registry && registry->editing()) return;
+    for (auto it = prev(lru.end()); usedBytes > budgetBytes && it != lru.begin();) {
+        Patient* p = *it;
+        auto victim = it--;
+        if (p->hasUnsavedHistory()) continue;
+        usedBytes -= position[p].bytes;
+        change(*p, [&] { p->releaseHistory(); });
+        position.erase(p);
+        lru.erase(victim);
+    }
+}
+
+void HistoryCache::require(Patient& patient) {
+    if (!lru.empty() && lru.front() == &patient) return;
+    remeasureFront();
+    auto it = position.find(&patient);
+    if (it != position.end()) {
+        lru.splice(lru.begin(), lru, it->second.at);
+        return;
+    }
+    lru.push_front(&patient);
+    position[&patient] = {lru.begin(), 0};
+    bool fromSnapshot = snapshotCurrent(); // asks the database, so outside the lock
+    change(patient, [&] {
+        patient.setHistoryLoaded(true);
+        if (!fromSnapshot || !snapshot->loadHistory(patient)) db.loadHistory(patient);
+    });
+    remeasureFront();
+    evictOverBudget();
+}
+
+VitalSeries HistoryCache::loadWindow(const Patient& patient, VitalKind kind, time_t from, time_t to) {
+    VitalSeries window(vitalHasSecondValue(kind));
+    if (!snapshotCurrent() || !snapshot->loadVitalsInRange(patient.getRowId(), kind, from, to, window)) {
+        db.loadVitalsInRange(patient.getRowId(), kind, from, to, window);
+    }
+    return window;
+}
+
+vector<RollupBucket> HistoryCache::loadRollups(const Patient& patient, VitalKind kind, RollupPeriod period, time_t from, time_t to) {
+    vector<RollupBucket> buckets;
+    db.loadRollups(patient.getRowId(), kind, period, from, to, buckets);
+    return buckets;
+}
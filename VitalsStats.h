@@ -0,0 +1,241 @@
+// VitalsStats.h
+// Aggregate kernels over contiguous vitals columns: min/max/mean/stddev plus the
+// number of readings past the alert thresholds, computed in one pass. Uses AVX2 or
+// NEON when available and falls back to plain scalar code everywhere else.
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MEDITRACK_STATS_AVX2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDITRACK_STATS_NEON 1
+#endif
+
+// --- Alert thresholds (shared with the record display code) ---
+namespace VitalThresholds {
+    constexpr double SystolicHigh = 140;  // high BP: systolic >= 140 or diastolic >= 90
+    constexpr double DiastolicHigh = 90;
+    constexpr double SystolicLow = 90;    // low BP: systolic <= 90 or diastolic <= 60
+    constexpr double DiastolicLow = 60;
+    constexpr double SugarHigh = 126;     // high sugar: >= 126 mg/dL
+    constexpr double SugarLow = 70;       // low sugar: < 70 mg/dL
+}
+
+// Aggregates for one column. Partial results merge, so per-patient stats can be
+// folded into population totals without a second pass.
+struct ColumnStats {
+    size_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    size_t high = 0; // readings at or above the high threshold
+    size_t low = 0;  // readings below (or at, for inclusive rules) the low threshold
+
+    double mean() const { return count ? sum / count : 0.0; }
+    double stddev() const {
+        if (count == 0) return 0.0;
+        double m = mean();
+        double var = sumSquares / count - m * m;
+        return var > 0 ? std::sqrt(var) : 0.0;
+    }
+    void merge(const ColumnStats& o) {
+        count += o.count;
+        if (o.min < min) min = o.min;
+        if (o.max > max) max = o.max;
+        sum += o.sum;
+        sumSquares += o.sumSquares;
+        high += o.high;
+        low += o.low;
+    }
+};
+
+// A single-column alert rule. NaN thresholds never match, which is how columns
+// without alerts (weight) are described.
+struct AlertRule {
+    double highAtOrAbove;
+    double low;
+    bool lowInclusive; // true: value <= low, false: value < low
+};
+
+constexpr double NoThreshold = std::numeric_limits<double>::quiet_NaN();
+constexpr AlertRule NoAlerts{NoThreshold, NoThreshold, false};
+constexpr AlertRule SugarAlerts{VitalThresholds::SugarHigh, VitalThresholds::SugarLow, false};
+
+// High/low counts for blood pressure, where either column can trigger an alert
+// and "high" takes precedence over "low" (as in BloodPressureRecord::display).
+struct PairAlertCounts {
+    size_t high = 0;
+    size_t low = 0;
+};
+
+namespace VitalsStatsDetail {
+
+inline ColumnStats columnStatsScalar(const double* v, size_t n, AlertRule rule) {
+    ColumnStats s;
+    for (size_t i = 0; i < n; ++i) {
+        double x = v[i];
+        if (x < s.min) s.min = x;
+        if (x > s.max) s.max = x;
+        s.sum += x;
+        s.sumSquares += x * x;
+        s.high += (x >= rule.highAtOrAbove);
+        s.low += rule.lowInclusive ? (x <= rule.low) : (x < rule.low);
+    }
+    s.count = n;
+    return s;
+}
+
+inline PairAlertCounts pairAlertsScalar(const double* sys, const double* dia, size_t n) {
+    using namespace VitalThresholds;
+    PairAlertCounts c;
+    for (size_t i = 0; i < n; ++i) {
+        bool high = sys[i] >= SystolicHigh || dia[i] >= DiastolicHigh;
+        bool low = sys[i] <= SystolicLow || dia[i] <= DiastolicLow;
+        c.high += high;
+        c.low += (!high && low);
+    }
+    return c;
+}
+
+#if defined(MEDITRACK_STATS_AVX2)
+template <bool LowInclusive>
+__attribute__((target("avx2"))) inline ColumnStats columnStatsAvx2(const double* v, size_t n, AlertRule rule) {
+    __m256d vmin = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d vmax = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    __m256d vsum = _mm256_setzero_pd(), vsq = _mm256_setzero_pd();
+    const __m256d hi = _mm256_set1_pd(rule.highAtOrAbove), lo = _mm256_set1_pd(rule.low);
+    size_t high = 0, low = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(v + i);
+        vmin = _mm256_min_pd(vmin, x);
+        vmax = _mm256_max_pd(vmax, x);
+        vsum = _mm256_add_pd(vsum, x);
+        vsq = _mm256_add_pd(vsq, _mm256_mul_pd(x, x));
+        high += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(x, hi, _CMP_GE_OQ)));
+        low += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(x, lo, LowInclusive ? _CMP_LE_OQ : _CMP_LT_OQ)));
+    }
+    alignas(32) double mins[4], maxs[4], sums[4], sqs[4];
+    _mm256_store_pd(mins, vmin);
+    _mm256_store_pd(maxs, vmax);
+    _mm256_store_pd(sums, vsum);
+    _mm256_store_pd(sqs, vsq);
+    ColumnStats s = columnStatsScalar(v + i, n - i, rule);
+    for (int k = 0; k < 4; ++k) {
+        if (mins[k] < s.min) s.min = mins[k];
+        if (maxs[k] > s.max) s.max = maxs[k];
+        s.sum += sums[k];
+        s.sumSquares += sqs[k];
+    }
+    s.count = n;
+    s.high += high;
+    s.low += low;
+    return s;
+}
+
+__attribute__((target("avx2"))) inline PairAlertCounts pairAlertsAvx2(const double* sys, const double* dia, size_t n) {
+    using namespace VitalThresholds;
+    const __m256d sHi = _mm256_set1_pd(SystolicHigh), dHi = _mm256_set1_pd(DiastolicHigh);
+    const __m256d sLo = _mm256_set1_pd(SystolicLow), dLo = _mm256_set1_pd(DiastolicLow);
+    PairAlertCounts c;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d s = _mm256_loadu_pd(sys + i), d = _mm256_loadu_pd(dia + i);
+        __m256d high = _mm256_or_pd(_mm256_cmp_pd(s, sHi, _CMP_GE_OQ), _mm256_cmp_pd(d, dHi, _CMP_GE_OQ));
+        __m256d low = _mm256_or_pd(_mm256_cmp_pd(s, sLo, _CMP_LE_OQ), _mm256_cmp_pd(d, dLo, _CMP_LE_OQ));
+        c.high += __builtin_popcount(_mm256_movemask_pd(high));
+        c.low += __builtin_popcount(_mm256_movemask_pd(_mm256_andnot_pd(high, low)));
+    }
+    PairAlertCounts tail = pairAlertsScalar(sys + i, dia + i, n - i);
+    c.high += tail.high;
+    c.low += tail.low;
+    return c;
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+#if defined(MEDITRACK_STATS_NEON) && defined(__aarch64__)
+inline size_t neonCount(uint64x2_t mask) {
+    return (vgetq_lane_u64(mask, 0) & 1) + (vgetq_lane_u64(mask, 1) & 1);
+}
+
+inline ColumnStats columnStatsNeon(const double* v, size_t n, AlertRule rule) {
+    float64x2_t vmin = vdupq_n_f64(std::numeric_limits<double>::infinity());
+    float64x2_t vmax = vdupq_n_f64(-std::numeric_limits<double>::infinity());
+    float64x2_t vsum = vdupq_n_f64(0.0), vsq = vdupq_n_f64(0.0);
+    const float64x2_t hi = vdupq_n_f64(rule.highAtOrAbove), lo = vdupq_n_f64(rule.low);
+    size_t high = 0, low = 0, i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t x = vld1q_f64(v + i);
+        vmin = vminq_f64(vmin, x);
+        vmax = vmaxq_f64(vmax, x);
+        vsum = vaddq_f64(vsum, x);
+        vsq = vfmaq_f64(vsq, x, x);
+        high += neonCount(vcgeq_f64(x, hi));
+        low += neonCount(rule.lowInclusive ? vcleq_f64(x, lo) : vcltq_f64(x, lo));
+    }
+    ColumnStats s = columnStatsScalar(v + i, n - i, rule);
+    double m = vminvq_f64(vmin), M = vmaxvq_f64(vmax);
+    if (m < s.min) s.min = m;
+    if (M > s.max) s.max = M;
+    s.sum += vaddvq_f64(vsum);
+    s.sumSquares += vaddvq_f64(vsq);
+    s.count = n;
+    s.high += high;
+    s.low += low;
+    return s;
+}
+
+inline PairAlertCounts pairAlertsNeon(const double* sys, const double* dia, size_t n) {
+    using namespace VitalThresholds;
+    const float64x2_t sHi = vdupq_n_f64(SystolicHigh), dHi = vdupq_n_f64(DiastolicHigh);
+    const float64x2_t sLo = vdupq_n_f64(SystolicLow), dLo = vdupq_n_f64(DiastolicLow);
+    PairAlertCounts c;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t s = vld1q_f64(sys + i), d = vld1q_f64(dia + i);
+        uint64x2_t high = vorrq_u64(vcgeq_f64(s, sHi), vcgeq_f64(d, dHi));
+        uint64x2_t low = vorrq_u64(vcleq_f64(s, sLo), vcleq_f64(d, dLo));
+        c.high += neonCount(high);
+        c.low += neonCount(vbicq_u64(low, high));
+    }
+    PairAlertCounts tail = pairAlertsScalar(sys + i, dia + i, n - i);
+    c.high += tail.high;
+    c.low += tail.low;
+    return c;
+}
+#endif
+
+} // namespace VitalsStatsDetail
+
+// Aggregates and threshold counts for one column of n readings.
+inline ColumnStats columnStats(const double* v, size_t n, AlertRule rule = NoAlerts) {
+#if defined(MEDITRACK_STATS_AVX2)
+    if (VitalsStatsDetail::hasAvx2()) {
+        return rule.lowInclusive ? VitalsStatsDetail::columnStatsAvx2<true>(v, n, rule)
+                                 : VitalsStatsDetail::columnStatsAvx2<false>(v, n, rule);
+    }
+#elif defined(MEDITRACK_STATS_NEON) && defined(__aarch64__)
+    return VitalsStatsDetail::columnStatsNeon(v, n, rule);
+#endif
+    return VitalsStatsDetail::columnStatsScalar(v, n, rule);
+}
+
+// Blood pressure alert counts over parallel systolic/diastolic columns.
+inline PairAlertCounts bloodPressureAlerts(const double* sys, const double* dia, size_t n) {
+#if defined(MEDITRACK_STATS_AVX2)
+    if (VitalsStatsDetail::hasAvx2()) return VitalsStatsDetail::pairAlertsAvx2(sys, dia, n);
+#elif defined(MEDITRACK_STATS_NEON) && defined(__aarch64__)
+    return VitalsStatsDetail::pairAlertsNeon(sys, dia, n);
+#endif
+    return VitalsStatsDetail::pairAlertsScalar(sys, dia, n);
+}
@@ -0,0 +1,161 @@
+// WriteBehind.cpp
+// The write-behind queue that saves patient changes off the UI thread.
+#include "MediTrack.h"
+
+// ------------------- WriteBehind -------------------
+void WriteBehind::enqueue(PendingWrite w) {
+    ++outstanding[w.patient];
+    unique_lock<mutex> guard(lock);
+    drained.wait(guard, [&] { return pending.size() < Capacity; });
+    w.queuedAt = chrono::steady_clock::now();
+    pending.push_back(move(w));
+    ++enqueuedCount;
+    queued.notify_one();
+}
+
+PendingWrite WriteBehind::childOf(const Patient& patient, PendingWrite::Kind kind) const {
+    PendingWrite w{kind, &patient};
+    w.patientId = patient.getRowId();
+    return w;
+}
+
+void WriteBehind::run() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        queued.wait(guard, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) break;
+        // Group commit: let the batch fill until the oldest change has waited a window.
+        queued.wait_until(guard, pending.front().queuedAt + window, [&] {
+            return stopping || pending.size() >= MaxBatch || flushTarget > finishedCount;
+        });
+        size_t n = min(pending.size(), MaxBatch);
+        vector<PendingWrite> batch(make_move_iterator(pending.begin()), make_move_iterator(pending.begin() + n));
+        pending.erase(pending.begin(), pending.begin() + n);
+        drained.notify_all();
+
+        guard.unlock();
+        connection.applyWrites(batch, patientIds);
+        guard.lock();
+        finishedCount += n;
+        for (PendingWrite& w : batch) finished.push_back(move(w));
+        committed.notify_all();
+    }
+}
+
+void WriteBehind::markVitalSaved(Patient& patient, const PendingWrite& w) {
+    VitalSeries& s = patient.getVitals().series(w.vitalKind);
+    auto times = s.times();
+    for (size_t i = s.size(); i-- > 0;) {
+        if (times[i] == w.timestamp && s.values1()[i] == w.value1 && s.rowIdAt(i) == 0) { s.markSaved(i, w.rowId); return; }
+    }
+}
+
+void WriteBehind::apply(Patient& patient, const PendingWrite& w) {
+    if (w.rowId == 0) {
+        failed.insert(w.patient);
+    } else {
+        switch (w.kind) {
+            case PendingWrite::Kind::Patient: patient.markSaved(w.rowId); break;
+            case PendingWrite::Kind::Vital: markVitalSaved(patient, w); break;
+            case PendingWrite::Kind::Medication: patient.getMedications()[w.index].markSaved(w.rowId); break;
+            case PendingWrite::Kind::Reminder: patient.getReminders()[w.index].markSaved(w.rowId); break;
+        }
+    }
+    // A patient with queued changes is never evicted by the HistoryCache, so
+    // its history is still loaded here.
+    auto it = outstanding.find(w.patient);
+    if (--it->second == 0) {
+        outstanding.erase(it);
+        if (!failed.count(w.patient)) patient.markHistorySaved();
+    }
+}
+
+bool WriteBehind::start(const ConnectionProfile& profile) {
+    if (!connection.openWriter(profile)) return false;
+    Patient::addObserver(this);
+    worker = thread(&WriteBehind::run, this);
+    return true;
+}
+
+void WriteBehind::stop() {
+    Patient::removeObserver(this);
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    queued.notify_one();
+    if (worker.joinable()) worker.join();
+}
+
+void WriteBehind::flush() {
+    {
+        unique_lock<mutex> guard(lock);
+        flushTarget = enqueuedCount;
+        queued.notify_one();
+        committed.wait(guard, [&] { return finishedCount >= flushTarget; });
+    }
+    applyCommitted();
+}
+
+size_t WriteBehind::queuedCount() {
+    lock_guard<mutex> guard(lock);
+    return enqueuedCount;
+}
+
+size_t WriteBehind::writtenCount() {
+    lock_guard<mutex> guard(lock);
+    return finishedCount;
+}
+
+void WriteBehind::commitNow() {
+    lock_guard<mutex> guard(lock);
+    flushTarget = enqueuedCount;
+    queued.notify_one();
+}
+
+void WriteBehind::applyCommitted(PatientRegistry* registry) {
+    vector<PendingWrite> done;
+    {
+        lock_guard<mutex> guard(lock);
+        done.swap(finished);
+    }
+    for (const PendingWrite& w : done) {
+        Patient& patient = const_cast<Patient&>(*w.patient);
+        if (registry) registry->edit(patient, [&](Patient&) { apply(patient, w); });
+        else apply(patient, w);
+    }
+}
+
+void WriteBehind::onPatientCreated(const Patient& patient) {
+    PendingWrite w{PendingWrite::Kind::Patient, &patient};
+    w.name = patient.getName();
+    w.age = patient.getAge();
+    w.contact = patient.getContact();
+    enqueue(move(w));
+}
+
+void WriteBehind::onVitalAdded(const Patient& patient, VitalKind kind, const VitalSeries& series, size_t index) {
+    if (series.rowIdAt(index) != 0) return;
+    PendingWrite w = childOf(patient, PendingWrite::Kind::Vital);
+    w.vitalKind = kind;
+    w.timestamp = series.times()[index];
+    w.value1 = series.values1()[index];
+    w.value2 = series.secondAt(index);
+    enqueue(move(w));
+}
+
+void WriteBehind::onMedicationAdded(const Patient& patient, const Medication& medication) {
+    if (!medication.isNew()) return;
+    PendingWrite w = childOf(patient, PendingWrite::Kind::Medication);
+    w.medication = medication;
+    w.index = &medication - patient.getMedications().data();
+    enqueue(move(w));
+}
+
+void WriteBehind::onReminderAdded(const Patient& patient, const Reminder& reminder) {
+    if (!reminder.isNew()) return;
+    PendingWrite w = childOf(patient, PendingWrite::Kind::Reminder);
+    w.reminder = reminder;
+    w.index = &reminder - patient.getReminders().data();
+    enqueue(move(w));
+}
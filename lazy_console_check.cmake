@@ -0,0 +1,56 @@
+# lazy_console_check.cmake
+# The lazy_console test (see CMakeLists.txt). Under --lazy and --snapshot, adds a
+# record, a medication and a reminder from the patient menu before the profile has
+# been viewed, so each add loads the patient's history on the way in. Fails if the
+# console does not exit cleanly or a fresh start does not show what was added.
+#
+# Run: cmake -DMEDITRACK=path/to/meditrack -DWORK_DIR=scratch/dir -P lazy_console_check.cmake
+
+if(NOT MEDITRACK OR NOT WORK_DIR)
+    message(FATAL_ERROR "usage: cmake -DMEDITRACK=... -DWORK_DIR=... -P lazy_console_check.cmake")
+endif()
+
+function(run_meditrack name input)
+    file(WRITE "${WORK_DIR}/${name}.in" "${input}")
+    execute_process(COMMAND "${MEDITRACK}" ${ARGN}
+                    WORKING_DIRECTORY "${WORK_DIR}"
+                    INPUT_FILE "${WORK_DIR}/${name}.in"
+                    OUTPUT_VARIABLE out ERROR_VARIABLE out
+                    RESULT_VARIABLE rc TIMEOUT 60)
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "${name}: meditrack ${ARGN} exited with '${rc}'\n${out}")
+    endif()
+    set(output "${out}" PARENT_SCOPE)
+endfunction()
+
+function(expect name text)
+    string(FIND "${output}" "${text}" at)
+    if(at EQUAL -1)
+        message(FATAL_ERROR "${name}: expected \"${text}\" in the output\n${output}")
+    endif()
+endfunction()
+
+# Main menu 2 selects a patient (blank search, first match); the patient menu adds
+# with 2 to 4 and returns with 8; main menu 4 saves and exits.
+set(select "2\n\n1\n")
+set(adds "${select}2\n2\n71\n3\nAspirin\n100mg\nDaily\n4\nCheck weight\n2030-01-01\n09:00\nonce\n8\n4\n")
+
+foreach(mode --lazy --snapshot)
+    file(REMOVE_RECURSE "${WORK_DIR}")
+    file(MAKE_DIRECTORY "${WORK_DIR}")
+    run_meditrack(seed "add-patient \"Ann Lee\" 42 555-1234\nadd-record $ Weight 70 1700000000\ncommit\n" --batch)
+    if(mode STREQUAL "--snapshot")
+        run_meditrack(snapshot "" --snapshot --report) # writes meditrack.snap
+    endif()
+
+    run_meditrack(add${mode} "${adds}" ${mode})
+    foreach(text "Record added." "Medication added." "Reminder added.")
+        expect(add${mode} "${text}")
+    endforeach()
+
+    run_meditrack(view${mode} "${select}1\n8\n4\n" --lazy)
+    foreach(text "Weight: 71 kg" "Medication: Aspirin" "Reminder: Check weight")
+        expect(view${mode} "${text}")
+    endforeach()
+endforeach()
+message(STATUS "lazy console adds: ok")
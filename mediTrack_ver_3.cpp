@@ -1,521 +1,299 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <ctime>
-#include <memory>
-#include <limits>
-#include <typeinfo>
-#include <sstream>
-#include "sqlite3.h" // The SQLite C header
+// mediTrack_ver_3.cpp
+// The MediTrack console application: option parsing, startup and the main menu.
+// Everything else lives in meditrack_core (MediTrack.h, MediTrack.cpp).
+#include "MediTrack.h"
 
-using namespace std;
+static volatile sig_atomic_t stopServing = 0;
+extern "C" void onStopSignal(int) { stopServing = 1; }
 
-// --- Forward Declarations ---
-class Patient;
-class DatabaseManager;
-void clearInputBuffer();
-void addNewPatient(vector<unique_ptr<Patient>>& patients);
-void listAllPatients(const vector<unique_ptr<Patient>>& patients);
-void patientSubMenu(Patient* patient);
-void selectPatient(vector<unique_ptr<Patient>>& patients);
-
-
-// ------------------- Health Record Classes (with Getters for DB) -------------------
-class HealthRecord {
-protected:
-    time_t timestamp;
-public:
-    HealthRecord() : timestamp(time(0)) {}
-    HealthRecord(time_t loaded_time) : timestamp(loaded_time) {}
-    virtual void display() const = 0;
-    virtual ~HealthRecord() = default;
-    
-    string getFormattedTimestamp() const {
-        char buffer[20];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", localtime(&timestamp));
-        return string(buffer);
-    }
-    time_t getTimestamp() const { return timestamp; }
-};
-
-class BloodPressureRecord : public HealthRecord {
-    int systolic, diastolic;
-public:
-    BloodPressureRecord(int s, int d) : HealthRecord(), systolic(s), diastolic(d) {}
-    BloodPressureRecord(int s, int d, time_t t) : HealthRecord(t), systolic(s), diastolic(d) {}
-    
-    void display() const override {
-        cout << getFormattedTimestamp() << " - Blood Pressure: " << systolic << "/" << diastolic << " mmHg";
-        if (systolic >= 140 || diastolic >= 90) cout << "  <-- ⚠️ ALERT: High Blood Pressure!";
-        else if (systolic <= 90 || diastolic <= 60) cout << "  <-- ⚠️ ALERT: Low Blood Pressure!";
-        cout << "\n";
-    }
-    int getSystolic() const { return systolic; }
-    int getDiastolic() const { return diastolic; }
-};
-
-class WeightRecord : public HealthRecord {
-    double weight;
-public:
-    WeightRecord(double w) : HealthRecord(), weight(w) {}
-    WeightRecord(double w, time_t t) : HealthRecord(t), weight(w) {}
-    void display() const override { cout << getFormattedTimestamp() << " - Weight: " << weight << " kg\n"; }
-    double getWeight() const { return weight; }
-};
-
-class BloodSugarRecord : public HealthRecord {
-    double sugar;
-public:
-    BloodSugarRecord(double s) : HealthRecord(), sugar(s) {}
-    BloodSugarRecord(double s, time_t t) : HealthRecord(t), sugar(s) {}
-    void display() const override {
-        cout << getFormattedTimestamp() << " - Blood Sugar: " << sugar << " mg/dL";
-        if (sugar >= 126) cout << "  <-- ⚠️ ALERT: High Blood Sugar (Potential Diabetes)!";
-        else if (sugar < 70) cout << "  <-- ⚠️ ALERT: Low Blood Sugar (Hypoglycemia)!";
-        cout << "\n";
-    }
-    double getSugar() const { return sugar; }
-};
-
-
-// ------------------- Medication & Reminder Classes (with Getters for DB) -------------------
-class Medication {
-    string name, dosage, schedule;
-public:
-    Medication(string n, string d, string s) : name(n), dosage(d), schedule(s) {}
-    void display() const { cout << "Medication: " << name << " | Dosage: " << dosage << " | Schedule: " << schedule << "\n"; }
-    string getName() const { return name; }
-    string getDosage() const { return dosage; }
-    string getSchedule() const { return schedule; }
-};
-
-class Reminder {
-    string message, date, reminderTime;
-public:
-    Reminder(string m, string d, string t) : message(m), date(d), reminderTime(t) {}
-    bool isDue() const {
-        time_t now = time(0);
-        tm *ltm = localtime(&now);
-        char todayDate[11], currentTime[6];
-        sprintf(todayDate, "%04d-%02d-%02d", 1900 + ltm->tm_year, 1 + ltm->tm_mon, ltm->tm_mday);
-        sprintf(currentTime, "%02d:%02d", ltm->tm_hour, ltm->tm_min);
-        return (date == todayDate && reminderTime <= currentTime);
-    }
-    void display() const { cout << "Reminder: " << message << " on " << date << " at " << reminderTime << "\n"; }
-    string getMessage() const { return message; }
-    string getDate() const { return date; }
-    string getTime() const { return reminderTime; }
-};
-
-
-// ------------------- Patient Class -------------------
-class Patient {
-    string name;
-    int age;
-    string contactInfo;
-    vector<unique_ptr<HealthRecord>> records;
-    vector<Medication> medications;
-    vector<Reminder> reminders;
-public:
-    Patient(string n, int a, string c) : name(n), age(a), contactInfo(c) {}
-
-    void addRecord(unique_ptr<HealthRecord> r) { records.push_back(move(r)); }
-    void addMedication(const Medication& m) { medications.push_back(m); }
-    void addReminder(const Reminder& r) { reminders.push_back(r); }
-
-    void calculateAndDisplayBMI() const;
-    void displayHealthTrend() const;
-    void display() const;
-    void checkReminders() const;
-
-    string getName() const { return name; }
-    int getAge() const { return age; }
-    string getContact() const { return contactInfo; }
-    const vector<unique_ptr<HealthRecord>>& getRecords() const { return records; }
-    const vector<Medication>& getMedications() const { return medications; }
-    const vector<Reminder>& getReminders() const { return reminders; }
-};
-
-
-// ------------------- DatabaseManager Class (Tier 3) -------------------
-class DatabaseManager {
-private:
-    sqlite3* DB;
-    string db_file;
-
-public:
-    DatabaseManager(const string& filename) : db_file(filename), DB(nullptr) {}
-    
-    ~DatabaseManager() {
-        if (DB) {
-            sqlite3_close(DB);
-        }
-    }
-
-    bool open() {
-        if (sqlite3_open(db_file.c_str(), &DB) != SQLITE_OK) {
-            cerr << "Error opening database: " << sqlite3_errmsg(DB) << endl;
-            return false;
+// ------------------- Main Function -------------------
+// Usage: mediTrack [--lazy] [--history-budget-mb=N] [--profile=standard|durable|bulk]
+//        mediTrack --snapshot [--history-budget-mb=N] [--profile=...]
+//        mediTrack --warm [--trace-startup] [--history-budget-mb=N] [--profile=...]
+//        mediTrack --import=FILE [--rejects=FILE] [--profile=...]
+//        mediTrack --rebuild-rollups
+//        mediTrack --compact-vitals[=DAYS]
+//        mediTrack --report[=DAYS] [--load-threads=N]
+//        mediTrack --batch[=FILE] [--batch-size=N] [--profile=...]
+//        mediTrack --serve=PORT [--load-threads=N] [--commit-window-ms=N]
+//        mediTrack --changes[=SEQ] [--changes-limit=N]
+//        mediTrack --prune-changes=SEQ
+//   --lazy                 load only patient summaries at startup and fetch each
+//                          patient's history when it is first viewed
+//   --history-budget-mb=N  memory budget for loaded histories in lazy mode (default 64)
+//   --profile=NAME         SQLite connection profile (default standard: WAL, synchronous=NORMAL)
+//   --snapshot             start from meditrack.snap (lazy, histories read from the
+//                          mapped snapshot); if it is missing or stale, load from
+//                          SQLite and write a fresh one
+//   --warm                 --snapshot, reading the database and snapshot files into
+//                          the page cache in the background while starting up
+//   --trace-startup        print the time of each startup phase and when the menu
+//                          came up (also in the metrics JSON, as "startup")
+//   --import=FILE          import a vitals CSV feed (see BulkImporter) and exit; uses
+//                          the bulk profile unless --profile is given
+//   --rejects=FILE         where malformed rows go (default FILE.rejects)
+//   --rebuild-rollups      recompute the daily/weekly rollups from the stored readings and exit
+//   --compact-vitals[=N]   seal readings older than N days (default 30; 0 seals all) into
+//                          compressed chunks, shrink the database file and exit
+//   --report[=N]           print the population report (patients without readings in
+//                          N days, default 30) and exit, for nightly runs
+//   --batch[=FILE]         run the scripted commands in FILE, or stdin if none or "-"
+//                          (see BatchSession), print one JSON result per line and exit;
+//                          other output goes to stderr
+//   --batch-size=N         writes per transaction in batch mode (default 1000)
+//   --serve=PORT           load every patient and serve them on 127.0.0.1:PORT (see
+//                          PatientServer) until interrupted, then save and exit;
+//                          --lazy and --snapshot are ignored
+//   --changes[=SEQ]        print the change log after SEQ (default 0) as one JSON object
+//                          per line and exit; the last seq printed is the next cursor
+//   --changes-limit=N      print at most N changes (default: all)
+//   --prune-changes=SEQ    delete the change log up to and including SEQ and exit
+//   --load-threads=N       read-only connections for the eager load, and report threads
+//                          (default: one per core; 1 loads on the main connection)
+//   --commit-window-ms=N   changes are written in the background and committed at
+//                          most N ms after they are entered (default 200)
+//   --metrics              collect database and menu timings (see menu option 7)
+//   --metrics-file=PATH    also write them as JSON to PATH every
+//   --metrics-interval-s=N   N seconds (default 60) and on exit; implies --metrics
+int main(int argc, char* argv[]) {
+    StartupTrace& startup = StartupTrace::global(); // phases are timed from here
+    bool lazy = false, useSnapshot = false, warm = false, traceStartup = false;
+    size_t historyBudgetMb = 64;
+    ConnectionProfile profile = ConnectionProfile::standard();
+    bool profileChosen = false;
+    string importPath, rejectsPath;
+    unsigned loadThreads = max(1u, thread::hardware_concurrency());
+    long commitWindowMs = 200;
+    bool metrics = false, rebuildRollups = false;
+    string metricsPath;
+    long metricsIntervalS = 60;
+    long compactDays = -1; // no compaction
+    long reportDays = -1;  // no report run
+    bool batch = false;
+    string batchPath;
+    size_t batchSize = 1000;
+    long servePort = 0;
+    long long changesAfter = -1, pruneThrough = -1; // no change feed, no pruning
+    size_t changesLimit = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--lazy") == 0) lazy = true;
+        else if (strcmp(argv[i], "--snapshot") == 0) useSnapshot = true;
+        else if (strcmp(argv[i], "--warm") == 0) warm = useSnapshot = true;
+        else if (strcmp(argv[i], "--trace-startup") == 0) traceStartup = true;
+        else if (strncmp(argv[i], "--history-budget-mb=", 20) == 0) historyBudgetMb = strtoul(argv[i] + 20, nullptr, 10);
+        else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            if (!ConnectionProfile::fromName(argv[i] + 10, profile)) { cerr << "Unknown profile: " << argv[i] + 10 << endl; return 1; }
+            profileChosen = true;
         }
-        cout << "Database opened successfully.\n";
-        return true;
-    }
-
-    void createTables() {
-        char* errMsg = 0;
-        const char* sql_statements = 
-            "PRAGMA foreign_keys = ON;"
-            "CREATE TABLE IF NOT EXISTS patients ("
-            "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-            "name TEXT NOT NULL, age INTEGER, contact TEXT);"
-
-            "CREATE TABLE IF NOT EXISTS health_records ("
-            "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER, type TEXT, "
-            "value1 REAL, value2 REAL, timestamp INTEGER, "
-            "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);"
-            
-            "CREATE TABLE IF NOT EXISTS medications ("
-            "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER, name TEXT, "
-            "dosage TEXT, schedule TEXT, "
-            "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);"
-
-            "CREATE TABLE IF NOT EXISTS reminders ("
-            "id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id INTEGER, message TEXT, "
-            "date TEXT, time TEXT, "
-            "FOREIGN KEY(patient_id) REFERENCES patients(id) ON DELETE CASCADE);";
-
-        if (sqlite3_exec(DB, sql_statements, 0, 0, &errMsg) != SQLITE_OK) {
-            cerr << "SQL error: " << errMsg << endl;
-            sqlite3_free(errMsg);
-        } else {
-            cout << "Tables created or already exist.\n";
+        else if (strncmp(argv[i], "--import=", 9) == 0) importPath = argv[i] + 9;
+        else if (strncmp(argv[i], "--rejects=", 10) == 0) rejectsPath = argv[i] + 10;
+        else if (strncmp(argv[i], "--load-threads=", 15) == 0) loadThreads = strtoul(argv[i] + 15, nullptr, 10);
+        else if (strncmp(argv[i], "--commit-window-ms=", 19) == 0) commitWindowMs = strtol(argv[i] + 19, nullptr, 10);
+        else if (strcmp(argv[i], "--metrics") == 0) metrics = true;
+        else if (strcmp(argv[i], "--rebuild-rollups") == 0) rebuildRollups = true;
+        else if (strcmp(argv[i], "--compact-vitals") == 0) compactDays = 30;
+        else if (strncmp(argv[i], "--compact-vitals=", 17) == 0) compactDays = max(0L, strtol(argv[i] + 17, nullptr, 10));
+        else if (strcmp(argv[i], "--batch") == 0) batch = true;
+        else if (strncmp(argv[i], "--batch=", 8) == 0) { batch = true; batchPath = argv[i] + 8; }
+        else if (strncmp(argv[i], "--batch-size=", 13) == 0) batchSize = strtoul(argv[i] + 13, nullptr, 10);
+        else if (strncmp(argv[i], "--serve=", 8) == 0) {
+            servePort = strtol(argv[i] + 8, nullptr, 10);
+            if (servePort <= 0 || servePort > 65535) { cerr << "Bad port: " << argv[i] + 8 << endl; return 1; }
         }
+        else if (strcmp(argv[i], "--changes") == 0) changesAfter = 0;
+        else if (strncmp(argv[i], "--changes=", 10) == 0) changesAfter = max(0LL, strtoll(argv[i] + 10, nullptr, 10));
+        else if (strncmp(argv[i], "--changes-limit=", 16) == 0) changesLimit = strtoul(argv[i] + 16, nullptr, 10);
+        else if (strncmp(argv[i], "--prune-changes=", 16) == 0) pruneThrough = max(0LL, strtoll(argv[i] + 16, nullptr, 10));
+        else if (strcmp(argv[i], "--report") == 0) reportDays = 30;
+        else if (strncmp(argv[i], "--report=", 9) == 0) reportDays = max(0L, strtol(argv[i] + 9, nullptr, 10));
+        else if (strncmp(argv[i], "--metrics-file=", 15) == 0) metricsPath = argv[i] + 15;
+        else if (strncmp(argv[i], "--metrics-interval-s=", 21) == 0) metricsIntervalS = strtol(argv[i] + 21, nullptr, 10);
+        else { cerr << "Unknown option: " << argv[i] << endl; return 1; }
     }
 
-    void saveAllPatients(const vector<unique_ptr<Patient>>& patients) {
-        sqlite3_exec(DB, "DELETE FROM patients;", 0, 0, 0); // Cascading delete will clear other tables
+    // The server reads patients from several threads, so their history has to be in
+    // memory from the start.
+    if (servePort) lazy = useSnapshot = warm = false;
 
-        sqlite3_stmt *stmt_p, *stmt_r, *stmt_m, *stmt_rem;
-        const char* sql_p = "INSERT INTO patients (name, age, contact) VALUES (?, ?, ?);";
-        const char* sql_r = "INSERT INTO health_records (patient_id, type, value1, value2, timestamp) VALUES (?, ?, ?, ?, ?);";
-        const char* sql_m = "INSERT INTO medications (patient_id, name, dosage, schedule) VALUES (?, ?, ?, ?);";
-        const char* sql_rem = "INSERT INTO reminders (patient_id, message, date, time) VALUES (?, ?, ?, ?);";
+    const char* snapshotPath = "meditrack.snap";
+    FilePrefetcher prefetcher;
+    if (warm) prefetcher.start({"meditrack.db", snapshotPath});
 
-        for (const auto& patient : patients) {
-            sqlite3_prepare_v2(DB, sql_p, -1, &stmt_p, 0);
-            sqlite3_bind_text(stmt_p, 1, patient->getName().c_str(), -1, SQLITE_STATIC);
-            sqlite3_bind_int(stmt_p, 2, patient->getAge());
-            sqlite3_bind_text(stmt_p, 3, patient->getContact().c_str(), -1, SQLITE_STATIC);
-            sqlite3_step(stmt_p);
-            sqlite3_finalize(stmt_p);
-            
-            long long patient_id = sqlite3_last_insert_rowid(DB);
+    MetricsDumper metricsDumper; // before the database, so the final dump sees its teardown
+    if (metrics || !metricsPath.empty()) DbMetrics::global().enable();
+    if (!metricsPath.empty()) metricsDumper.start(metricsPath, chrono::seconds(metricsIntervalS));
 
-            for (const auto& rec : patient->getRecords()) {
-                sqlite3_prepare_v2(DB, sql_r, -1, &stmt_r, 0);
-                sqlite3_bind_int(stmt_r, 1, patient_id);
-                sqlite3_bind_int64(stmt_r, 5, rec->getTimestamp());
-                if (auto r = dynamic_cast<BloodPressureRecord*>(rec.get())) {
-                    sqlite3_bind_text(stmt_r, 2, "BP", -1, SQLITE_STATIC);
-                    sqlite3_bind_double(stmt_r, 3, r->getSystolic());
-                    sqlite3_bind_double(stmt_r, 4, r->getDiastolic());
-                } else if (auto r = dynamic_cast<WeightRecord*>(rec.get())) {
-                    sqlite3_bind_text(stmt_r, 2, "Weight", -1, SQLITE_STATIC);
-                    sqlite3_bind_double(stmt_r, 3, r->getWeight());
-                } else if (auto r = dynamic_cast<BloodSugarRecord*>(rec.get())) {
-                    sqlite3_bind_text(stmt_r, 2, "Sugar", -1, SQLITE_STATIC);
-                    sqlite3_bind_double(stmt_r, 3, r->getSugar());
-                }
-                sqlite3_step(stmt_r);
-                sqlite3_finalize(stmt_r);
-            }
-            for (const auto& med : patient->getMedications()) {
-                sqlite3_prepare_v2(DB, sql_m, -1, &stmt_m, 0);
-                sqlite3_bind_int(stmt_m, 1, patient_id);
-                sqlite3_bind_text(stmt_m, 2, med.getName().c_str(), -1, SQLITE_STATIC);
-                sqlite3_bind_text(stmt_m, 3, med.getDosage().c_str(), -1, SQLITE_STATIC);
-                sqlite3_bind_text(stmt_m, 4, med.getSchedule().c_str(), -1, SQLITE_STATIC);
-                sqlite3_step(stmt_m);
-                sqlite3_finalize(stmt_m);
-            }
-            for (const auto& rem : patient->getReminders()) {
-                sqlite3_prepare_v2(DB, sql_rem, -1, &stmt_rem, 0);
-                sqlite3_bind_int(stmt_rem, 1, patient_id);
-                sqlite3_bind_text(stmt_rem, 2, rem.getMessage().c_str(), -1, SQLITE_STATIC);
-                sqlite3_bind_text(stmt_rem, 3, rem.getDate().c_str(), -1, SQLITE_STATIC);
-                sqlite3_bind_text(stmt_rem, 4, rem.getTime().c_str(), -1, SQLITE_STATIC);
-                sqlite3_step(stmt_rem);
-                sqlite3_finalize(stmt_rem);
-            }
-        }
-        cout << "All data saved to database.\n";
-    }
-
-    void loadPatients(vector<unique_ptr<Patient>>& patients) {
-        patients.clear();
-        sqlite3_stmt *stmt_p, *stmt_r, *stmt_m, *stmt_rem;
-        const char* sql_p = "SELECT id, name, age, contact FROM patients;";
-        
-        sqlite3_prepare_v2(DB, sql_p, -1, &stmt_p, 0);
-        while (sqlite3_step(stmt_p) == SQLITE_ROW) {
-            int id = sqlite3_column_int(stmt_p, 0);
-            string name = (const char*)sqlite3_column_text(stmt_p, 1);
-            int age = sqlite3_column_int(stmt_p, 2);
-            string contact = (const char*)sqlite3_column_text(stmt_p, 3);
-            auto patient = make_unique<Patient>(name, age, contact);
-            const char* sql_r = "SELECT type, value1, value2, timestamp FROM health_records WHERE patient_id = ?;";
-            sqlite3_prepare_v2(DB, sql_r, -1, &stmt_r, 0);
-            sqlite3_bind_int(stmt_r, 1, id);
-            while (sqlite3_step(stmt_r) == SQLITE_ROW) {
-                string type = (const char*)sqlite3_column_text(stmt_r, 0);
-                double val1 = sqlite3_column_double(stmt_r, 1);
-                double val2 = sqlite3_column_double(stmt_r, 2);
-                time_t ts = sqlite3_column_int64(stmt_r, 3);
-                if (type == "BP") patient->addRecord(make_unique<BloodPressureRecord>(val1, val2, ts));
-                else if (type == "Weight") patient->addRecord(make_unique<WeightRecord>(val1, ts));
-                else if (type == "Sugar") patient->addRecord(make_unique<BloodSugarRecord>(val1, ts));
-            }
-            sqlite3_finalize(stmt_r);
-            const char* sql_m = "SELECT name, dosage, schedule FROM medications WHERE patient_id = ?;";
-            sqlite3_prepare_v2(DB, sql_m, -1, &stmt_m, 0);
-            sqlite3_bind_int(stmt_m, 1, id);
-            while(sqlite3_step(stmt_m) == SQLITE_ROW) {
-                patient->addMedication(Medication((const char*)sqlite3_column_text(stmt_m, 0), (const char*)sqlite3_column_text(stmt_m, 1), (const char*)sqlite3_column_text(stmt_m, 2)));
-            }
-            sqlite3_finalize(stmt_m);
-            const char* sql_rem = "SELECT message, date, time FROM reminders WHERE patient_id = ?;";
-            sqlite3_prepare_v2(DB, sql_rem, -1, &stmt_rem, 0);
-            sqlite3_bind_int(stmt_rem, 1, id);
-            while(sqlite3_step(stmt_rem) == SQLITE_ROW) {
-                patient->addReminder(Reminder((const char*)sqlite3_column_text(stmt_rem, 0), (const char*)sqlite3_column_text(stmt_rem, 1), (const char*)sqlite3_column_text(stmt_rem, 2)));
-            }
-            sqlite3_finalize(stmt_rem);
-            patients.push_back(move(patient));
+    if (!importPath.empty() && !profileChosen) profile = ConnectionProfile::bulkImport();
+    // Batch results and the change feed own stdout; everything else printed along the
+    // way goes to stderr.
+    ostream resultsOut(batch || changesAfter >= 0 ? cout.rdbuf(cerr.rdbuf()) : cout.rdbuf());
+    DatabaseManager db("meditrack.db");
+    {
+        auto phase = startup.phase("open");
+        if (!db.open(profile)) {
+            return 1;
         }
-        sqlite3_finalize(stmt_p);
-        cout << "Loaded " << patients.size() << " patients from database.\n";
     }
-};
-
-
-// ------------------- Patient Method Implementations -------------------
-// (We declare these down here because they use UI elements like cout/cin)
-void Patient::calculateAndDisplayBMI() const {
-    double lastWeight = 0.0;
-    for (auto it = records.rbegin(); it != records.rend(); ++it) {
-        if (WeightRecord* wr = dynamic_cast<WeightRecord*>(it->get())) {
-            lastWeight = wr->getWeight();
-            break;
-        }
+    {
+        auto phase = startup.phase("schema");
+        if (!db.createTables()) return 1;
     }
-    if (lastWeight <= 0) {
-        cout << "\nBMI cannot be calculated. No weight records found.\n";
-        return;
+    if (rebuildRollups) return db.rebuildRollups() ? 0 : 1;
+    if (compactDays >= 0) return db.compactVitals(time(nullptr) - compactDays * 24 * 3600) ? 0 : 1;
+    if (changesAfter >= 0) {
+        size_t listed = 0;
+        long long cursor = db.forEachChange(changesAfter, changesLimit, [&](const LoggedChange& c) {
+            JsonWriter json(true);
+            json.beginObject().field("seq", uint64_t(c.seq)).field("entity", c.entity).field("op", c.op);
+            json.field("id", uint64_t(c.rowId)).field("patient", uint64_t(c.patientId)).raw("data", c.data).endObject();
+            resultsOut << json.text() << '\n';
+            ++listed;
+        });
+        resultsOut.flush();
+        cerr << "Listed " << listed << " changes; continue with --changes=" << cursor << "\n";
+        return 0;
     }
-    double heightMeters;
-    cout << "\nPlease enter patient's height in meters (e.g., 1.75): ";
-    cin >> heightMeters;
-    if (cin.fail() || heightMeters <= 0) {
-        cout << "Invalid height. Cannot calculate BMI.\n";
-        cin.clear();
-        clearInputBuffer();
-        return;
+    if (pruneThrough >= 0) {
+        long long pruned = db.pruneChanges(pruneThrough);
+        if (pruned < 0) return 1;
+        cout << "Pruned " << pruned << " changes through seq " << pruneThrough << ".\n";
+        return 0;
     }
-    double bmi = lastWeight / (heightMeters * heightMeters);
-    cout << "\n--- BMI Calculation for " << name << " ---\n";
-    cout << "Using most recent weight: " << lastWeight << " kg\n";
-    cout << "Height: " << heightMeters << " m\n";
-    cout << "Calculated BMI is: " << bmi << "\n";
-    if (bmi < 18.5) cout << "Category: Underweight\n";
-    else if (bmi < 25) cout << "Category: Normal weight\n";
-    else if (bmi < 30) cout << "Category: Overweight\n";
-    else cout << "Category: Obesity\n";
-    cout << "---------------------------------\n";
-}
 
-void Patient::displayHealthTrend() const {
-    int choice;
-    cout << "\n--- View Health Trends for " << name << " ---\n";
-    cout << "1. Blood Pressure Trend\n";
-    cout << "2. Weight Trend\n";
-    cout << "3. Blood Sugar Trend\n";
-    cout << "Enter your choice: ";
-    cin >> choice;
-    if (cin.fail()) {
-        cin.clear(); clearInputBuffer();
-        cout << "Invalid input.\n";
-        return;
-    }
-    cout << "\n--- Trend Report ---\n";
-    bool found = false;
-    switch(choice) {
-        case 1: for(const auto& rec : records) if(dynamic_cast<BloodPressureRecord*>(rec.get())) { rec->display(); found = true; } break;
-        case 2: for(const auto& rec : records) if(dynamic_cast<WeightRecord*>(rec.get())) { rec->display(); found = true; } break;
-        case 3: for(const auto& rec : records) if(dynamic_cast<BloodSugarRecord*>(rec.get())) { rec->display(); found = true; } break;
-        default: cout << "Invalid choice.\n"; return;
-    }
-    if (!found) cout << "No records of that type found.\n";
-    cout << "--------------------\n";
-}
-
-void Patient::display() const {
-    cout << "\n--- Patient Profile ---\n";
-    cout << "Name: " << name << "\nAge: " << age << "\nContact: " << contactInfo << "\n";
-    cout << "\n--- Health Records ---\n";
-    if (records.empty()) cout << "No health records found.\n"; else for (const auto& r : records) r->display();
-    cout << "\n--- Medications ---\n";
-    if (medications.empty()) cout << "No medications found.\n"; else for (const auto &m : medications) m.display();
-    cout << "\n--- Reminders ---\n";
-    if (reminders.empty()) cout << "No reminders found.\n"; else for (const auto &rem : reminders) rem.display();
-    cout << "-----------------------\n";
-}
-
-void Patient::checkReminders() const {
-    cout << "\n--- Checking Reminders for " << name << " ---\n";
-    bool found = false;
-    for (const auto &rem : reminders) {
-        if (rem.isDue()) {
-            cout << "⚠️ Reminder Due: ";
-            rem.display();
-            found = true;
+    if (batch) {
+        ifstream file;
+        if (!batchPath.empty() && batchPath != "-") {
+            file.open(batchPath);
+            if (!file) { cerr << "Could not open batch file: " << batchPath << endl; return 1; }
         }
+        BatchReport report = BatchSession(db, resultsOut, batchSize).run(file.is_open() ? file : cin);
+        cerr << "Ran " << report.commands << " commands (" << report.failed << " failed) in " << report.seconds
+             << " s (" << (long long)report.commandsPerSecond() << " commands/s).\n";
+        return report.failed ? 2 : 0;
     }
-    if (!found) cout << "No reminders are currently due.\n";
-}
 
-// ------------------- UI Functions -------------------
-void clearInputBuffer() {
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-}
-
-void addNewPatient(vector<unique_ptr<Patient>>& patients) {
-    string name, contact;
-    int age;
-    cout << "\nEnter patient's full name: ";
-    clearInputBuffer();
-    getline(cin, name);
-    cout << "Enter patient's age: ";
-    cin >> age;
-    cout << "Enter patient's contact info: ";
-    clearInputBuffer();
-    getline(cin, contact);
-    patients.push_back(make_unique<Patient>(name, age, contact));
-    cout << "Patient '" << name << "' added successfully!\n";
-}
-
-void listAllPatients(const vector<unique_ptr<Patient>>& patients) {
-    cout << "\n--- All Patients ---\n";
-    if (patients.empty()) { cout << "No patients in the system.\n"; return; }
-    for (size_t i = 0; i < patients.size(); ++i) {
-        cout << i + 1 << ". " << patients[i]->getName() << "\n";
+    if (!importPath.empty()) {
+        if (rejectsPath.empty()) rejectsPath = importPath + ".rejects";
+        ImportReport report = BulkImporter(db).run(importPath, rejectsPath);
+        if (!report.ok && report.lines == 0) return 1;
+        cout << "Imported " << report.imported << " readings from " << report.lines << " lines in "
+             << report.seconds << " s (" << (long long)report.rowsPerSecond() << " rows/s).\n";
+        if (report.rejected) cout << report.rejected << " malformed rows written to " << rejectsPath << "\n";
+        return report.ok ? 0 : 1;
     }
-}
 
-void patientSubMenu(Patient* patient) {
-    int choice;
-    do {
-        cout << "\n--- Managing Patient: " << patient->getName() << " ---\n";
-        cout << "1. View Patient Profile\n";
-        cout << "2. Add Health Record\n";
-        cout << "3. Add Medication\n";
-        cout << "4. Add Reminder\n";
-        cout << "5. Calculate BMI\n";
-        cout << "6. View Health Trends\n";
-        cout << "7. Return to Main Menu\n";
-        cout << "Enter your choice: ";
-        cin >> choice;
-        if (cin.fail()) {
-            cout << "Invalid input.\n";
-            cin.clear(); clearInputBuffer();
-            choice = 0; continue;
-        }
-        switch (choice) {
-            case 1: patient->display(); break;
-            case 2: {
-                int recordChoice;
-                cout << "\nSelect record type:\n1. Blood Pressure\n2. Weight\n3. Blood Sugar\nChoice: ";
-                cin >> recordChoice;
-                if (recordChoice == 1) {
-                    int s, d;
-                    cout << "Enter Systolic: "; cin >> s;
-                    cout << "Enter Diastolic: "; cin >> d;
-                    patient->addRecord(make_unique<BloodPressureRecord>(s, d));
-                } else if (recordChoice == 2) {
-                    double w;
-                    cout << "Enter weight in kg: "; cin >> w;
-                    patient->addRecord(make_unique<WeightRecord>(w));
-                } else if (recordChoice == 3) {
-                    double s;
-                    cout << "Enter blood sugar in mg/dL: "; cin >> s;
-                    patient->addRecord(make_unique<BloodSugarRecord>(s));
-                } else { cout << "Invalid record type.\n"; }
-                if(!cin.fail()) cout << "Record added.\n";
-                break;
-            }
-            case 3: {
-                string name, dosage, schedule;
-                cout << "Medication name: "; clearInputBuffer(); getline(cin, name);
-                cout << "Dosage (e.g., 500mg): "; getline(cin, dosage);
-                cout << "Schedule (e.g., Twice a day): "; getline(cin, schedule);
-                patient->addMedication(Medication(name, dosage, schedule));
-                cout << "Medication added.\n";
-                break;
-            }
-            case 4: {
-                string msg, date, time;
-                cout << "Reminder message: "; clearInputBuffer(); getline(cin, msg);
-                cout << "Date (YYYY-MM-DD): "; getline(cin, date);
-                cout << "Time (HH:MM, 24-hr): "; getline(cin, time);
-                patient->addReminder(Reminder(msg, date, time));
-                cout << "Reminder added.\n";
-                break;
-            }
-            case 5: patient->calculateAndDisplayBMI(); break;
-            case 6: patient->displayHealthTrend(); break;
-            case 7: cout << "Returning to main menu...\n"; break;
-            default: cout << "Invalid choice. Please try again.\n";
-        }
-    } while (choice != 7);
-}
+    AlertEngine alerts; // observers are declared before patients so they outlive them
+    ReminderScheduler reminders;
+    bool alertsSeeded = !lazy;
+    WriteBehind writer(db, chrono::milliseconds(max(0L, commitWindowMs)));
+    PatientArena arena; // declared before patients, which give their memory back on teardown
+    PatientRegistry registry;
+    vector<unique_ptr<Patient>> patients; // what the loaders produce, then handed to the registry
+    HistoryCache historyCache(db, historyBudgetMb * 1024 * 1024);
+    historyCache.guardWith(&registry);
+
+    // The menu's reminders are read on a connection of their own while the patients
+    // load: the scheduler needs patient names, not Patient objects.
+    thread reminderLoader;
+    atomic<bool> remindersLoaded{false};
+    if (!servePort && reportDays < 0) {
+        reminderLoader = thread([&] {
+            auto phase = startup.phase("reminders");
+            DatabaseManager reader("meditrack.db");
+            if (!reader.openReadOnly(profile)) return; // read on the main connection instead
+            reader.forEachReminder([&](string_view patientName, const Reminder& rem) { reminders.schedule(patientName, rem); });
+            remindersLoaded = true;
+        });
+    }
 
-void selectPatient(vector<unique_ptr<Patient>>& patients) {
-    if (patients.empty()) { cout << "No patients to select.\n"; return; }
-    listAllPatients(patients);
-    cout << "Select a patient by number: ";
-    int patientIndex;
-    cin >> patientIndex;
-    if (cin.fail() || patientIndex <= 0 || patientIndex > patients.size()) {
-        cout << "Invalid selection.\n";
-        if(cin.fail()){ cin.clear(); clearInputBuffer(); }
+    Snapshot snapshot;
+    auto loadPhase = make_optional<StartupTrace::Scope>(startup, "load");
+    if (useSnapshot && snapshot.open(snapshotPath) && snapshot.generation() == db.generation()) {
+        snapshot.loadPatientSummaries(patients, &historyCache, arena.resource());
+        historyCache.useSnapshot(&snapshot);
+        alertsSeeded = false;
+    } else if (useSnapshot) {
+        cout << "Snapshot missing or stale, loading from database.\n";
+        db.loadPatientsParallel(patients, arena, loadThreads);
+        if (!SnapshotWriter().write(snapshotPath, patients, db.generation())) cerr << "Could not write snapshot " << snapshotPath << endl;
+    } else if (lazy) {
+        db.loadPatientSummaries(patients, &historyCache, arena.resource());
     } else {
-        patientSubMenu(patients[patientIndex - 1].get());
+        db.loadPatientsParallel(patients, arena, loadThreads);
     }
-}
 
+    loadPhase.reset();
 
-// ------------------- Main Function -------------------
-int main() {
-    DatabaseManager db("meditrack.db");
-    if (!db.open()) {
+    registry.adopt(patients);
+    WorkStealingPool reportPool(loadThreads);
+    const DatabaseManager* reportSource = lazy || useSnapshot ? &db : nullptr; // where unloaded histories are
+    if (reportDays >= 0) {
+        displayPopulationReport(registry, reportSource, reportPool, int(reportDays));
+        return 0;
+    }
+    PatientIndex patientIndex(registry.patients()); // after patients: it holds positions into the vector
+    {
+        auto phase = startup.phase("index");
+        patientIndex.rebuild();
+    }
+    // Started after loading, so only changes made from here on are queued.
+    bool writerStarted;
+    {
+        auto phase = startup.phase("writer");
+        writerStarted = writer.start(profile);
+    }
+    if (!writerStarted) cerr << "Background writer unavailable, changes are saved on exit.\n";
+
+    if (servePort) {
+#ifndef _WIN32
+        if (!writerStarted) return 1; // the server answers writes once the writer has committed them
+        PatientServer server(registry, patientIndex, writer, reportPool);
+        if (!server.listen(uint16_t(servePort))) return 1;
+        signal(SIGINT, onStopSignal);
+        signal(SIGTERM, onStopSignal);
+        cout << "Serving " << registry.size() << " patients on 127.0.0.1:" << servePort << " (Ctrl-C stops).\n";
+        startup.markReady();
+        if (traceStartup) {
+            RenderBuffer out;
+            startup.render(out);
+            out.flush();
+        }
+        server.run(stopServing);
+        cout << "Served " << server.requestCount() << " requests on " << server.connectionCount() << " connections.\n";
+        writer.flush();
+        registry.editAll([&] { db.saveAllPatients(registry.patients()); });
+        return 0;
+#else
+        cerr << "--serve is not available on this platform.\n";
         return 1;
+#endif
     }
-    db.createTables();
-
-    vector<unique_ptr<Patient>> patients;
-    db.loadPatients(patients);
 
+    reminderLoader.join();
+    if (!remindersLoaded)
+        db.forEachReminder([&](string_view patientName, const Reminder& rem) { reminders.schedule(patientName, rem); });
     cout << "\nWelcome to MediTrack: Your health, Our priority\n";
-    for (const auto& p : patients) {
-        p->checkReminders();
+    if (reminders.fireDue() == 0) cout << "No reminders are currently due.\n";
+    reminders.start();
+    startup.markReady();
+    if (traceStartup) {
+        RenderBuffer out;
+        startup.render(out);
+        out.flush();
     }
-    
+
     int choice;
     do {
+        writer.applyCommitted(&registry);
         cout << "\n===== MediTrack Main Menu =====\n";
         cout << "1. Add New Patient\n";
         cout << "2. Select Patient\n";
         cout << "3. List All Patients\n";
         cout << "4. Save and Exit\n";
+        cout << "5. Population Vitals Statistics\n";
+        cout << "6. Patients Currently Alerting\n";
+        cout << "7. Database Statistics\n";
+        cout << "8. Population Report\n";
         cout << "Enter your choice: ";
         cin >> choice;
 
@@ -527,18 +305,38 @@ int main() {
             continue;
         }
 
+        static const char* actionNames[] = {"", "addPatient", "selectPatient", "listPatients", "saveAndExit",
+                                            "populationStatistics", "alertingPatients", "databaseStatistics",
+                                            "populationReport"};
+        ScopedTimer timer(choice >= 1 && choice <= 8 ? DbMetrics::global().action(actionNames[choice]) : nullptr);
         switch (choice) {
-            case 1: addNewPatient(patients); break;
-            case 2: selectPatient(patients); break;
-            case 3: listAllPatients(patients); break;
+            case 1: addNewPatient(registry); break;
+            case 2: selectPatient(registry, patientIndex); break;
+            case 3: listAllPatients(registry.patients()); break;
             case 4: 
-                db.saveAllPatients(patients);
+                writer.flush();
+                registry.editAll([&] { db.saveAllPatients(registry.patients()); });
                 cout << "Exiting MediTrack. Goodbye!\n";
                 break;
+            case 5: displayPopulationStatistics(registry.patients()); break;
+            case 6:
+                if (!alertsSeeded) { seedAlertsFromDatabase(db, registry.patients(), alerts); alertsSeeded = true; }
+                displayAlertingPatients(alerts);
+                break;
+            case 7: displayDatabaseStatistics(); break;
+            case 8: {
+                int days;
+                cout << "List patients without readings in how many days? ";
+                if (!(cin >> days) || days < 0) { cin.clear(); days = 30; }
+                clearInputBuffer();
+                writer.flush(); // unloaded histories are read back from the database
+                displayPopulationReport(registry, reportSource, reportPool, days);
+                break;
+            }
             default: 
                 cout << "Invalid choice. Please try again.\n";
         }
     } while (choice != 4);
 
     return 0;
-}
\ No newline at end of file
+}
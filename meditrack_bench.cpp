@@ -0,0 +1,636 @@
+// meditrack_bench.cpp
+// End-to-end benchmark for the SQLite tier in mediTrack_ver_3.cpp, plus the text
+// file persistence of meditrack_ver_2.cpp run on the same data. Patients, readings,
+// medications and reminders come from a deterministic generator: the same seed and
+// counts give the same data on every platform.
+//
+// For each scale it times createTables, saveAllPatients (the first, full save),
+// loadPatients (serial and parallel), trend queries (SQL window and in-memory),
+// reminder checks, a warm restart (schema check, summaries, index and reminders),
+// compactVitals with the parallel load and SQL trend queries
+// repeated on the sealed chunks, PatientRegistry readers (1 to 8 threads summarising
+// vitals shard by shard while the main thread keeps editing), the population report
+// on a work-stealing pool of 1 to 8 threads, and ver_2's
+// saveData/loadData. Results go to stdout as one JSON
+// document. Each operation reports wall time, throughput, latency percentiles for
+// the per-patient ones, and heap allocations (operator new and SQLite's allocator,
+// counted separately). Scales run smallest first, so the peak RSS after a scale is
+// that scale's peak.
+//
+// Build: the meditrack_bench target in CMakeLists.txt (links meditrack_core)
+// Run:   ./meditrack_bench [--patients=1000,10000,100000] [--records=20] [--medications=2]
+//                          [--reminders=2] [--samples=1000] [--seed=42] [--dir=meditrack_bench_data]
+// Check: ./meditrack_bench --check [--patients=...]   (ctest runs it: see CMakeLists.txt)
+//        saves and loads each scale and fails if a path exceeds its heap allocation
+//        budget (see allocationBudgets)
+#include <atomic>
+#include <cstdio>
+#include <new>
+#include <random>
+#include <typeinfo>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/stat.h>
+#else
+#include <direct.h>
+#endif
+
+#include "MediTrack.h"
+
+// ver_2 has its own Patient, records and main; a namespace keeps them apart. Its
+// headers are all included above, so their guards keep them out of the namespace.
+#define main legacy_main
+namespace legacy {
+#include "meditrack_ver_2.cpp"
+}
+#undef main
+
+// --- Allocation counting ---
+// GCC flags the free() in the replaced operator delete as not matching operator new
+// once the two are inlined together; here they are malloc and free on both sides.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static atomic<uint64_t> heapAllocations{0};
+static atomic<uint64_t> sqliteAllocations{0};
+
+void* operator new(size_t n) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static sqlite3_mem_methods sqliteDefaultMemory;
+static void* countingMalloc(int n) {
+    sqliteAllocations.fetch_add(1, memory_order_relaxed);
+    return sqliteDefaultMemory.xMalloc(n);
+}
+static void* countingRealloc(void* p, int n) {
+    if (!p) sqliteAllocations.fetch_add(1, memory_order_relaxed);
+    return sqliteDefaultMemory.xRealloc(p, n);
+}
+// Must run before SQLite is first used.
+static void countSqliteAllocations() {
+    sqlite3_config(SQLITE_CONFIG_GETMALLOC, &sqliteDefaultMemory);
+    sqlite3_mem_methods counting = sqliteDefaultMemory;
+    counting.xMalloc = countingMalloc;
+    counting.xRealloc = countingRealloc;
+    sqlite3_config(SQLITE_CONFIG_MALLOC, &counting);
+}
+
+static long peakRssKb() {
+#ifndef _WIN32
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return long(usage.ru_maxrss / 1024);
+#else
+    return long(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
+
+// The app prints progress with cout; the JSON goes out through stdio, so cout is
+// simply muted while an operation runs.
+struct QuietCout {
+    streambuf* saved;
+    QuietCout() : saved(cout.rdbuf(nullptr)) {}
+    ~QuietCout() {
+        cout.rdbuf(saved);
+        cout.clear();
+    }
+};
+
+// --- Synthetic data ---
+struct BenchConfig {
+    vector<size_t> scales{1000, 10000, 100000};
+    size_t records = 20;     // per patient, spread over the three vital kinds
+    size_t medications = 2;  // per patient
+    size_t reminders = 2;    // per patient
+    size_t samples = 1000;   // patients timed in the trend query benchmarks
+    uint32_t seed = 42;
+    string dir = "meditrack_bench_data";
+};
+
+struct SyntheticReading {
+    VitalKind kind;
+    time_t timestamp;
+    double value1, value2;
+};
+struct SyntheticPatient {
+    string name, contact;
+    int age;
+    vector<SyntheticReading> readings; // in time order
+    vector<array<string, 3>> medications; // name, dosage, schedule
+    vector<array<string, 3>> reminders;   // message, date, time
+    vector<ReminderFrequency> frequencies;
+};
+
+// Only raw mt19937 draws are used: the standard distributions differ between
+// library implementations, the engine does not.
+class Generator {
+    const BenchConfig& config;
+    static constexpr time_t Epoch = 1700000000; // readings end here
+public:
+    explicit Generator(const BenchConfig& c) : config(c) {}
+
+    SyntheticPatient patient(size_t i) const {
+        static const char* surnames[] = {"Smith", "Patel", "Garcia", "Chen", "Okafor", "Novak", "Haddad", "Kim", "Silva", "Jones"};
+        static const char* drugs[] = {"Metformin", "Lisinopril", "Atorvastatin", "Amlodipine", "Omeprazole", "Levothyroxine"};
+        static const char* schedules[] = {"Once a day", "Twice a day", "Before meals", "At bedtime"};
+        mt19937 rng(config.seed * 2654435761u + uint32_t(i));
+        auto below = [&](uint32_t n) { return rng() % n; };
+
+        SyntheticPatient p;
+        p.name = "Patient" + to_string(i + 1) + " " + surnames[below(10)];
+        p.age = 18 + int(below(80));
+        p.contact = "555" + to_string(1000000 + i % 9000000);
+        time_t ts = Epoch - time_t(config.records) * 8 * 3600;
+        for (size_t r = 0; r < config.records; ++r) {
+            ts += 4 * 3600 + below(8 * 3600);
+            switch (r % 3) {
+                case 0: p.readings.push_back({VitalKind::BloodPressure, ts, 90.0 + below(80), 55.0 + below(50)}); break;
+                case 1: p.readings.push_back({VitalKind::Weight, ts, 50.0 + below(700) / 10.0, 0}); break;
+                default: p.readings.push_back({VitalKind::BloodSugar, ts, 60.0 + below(140), 0}); break;
+            }
+        }
+        for (size_t m = 0; m < config.medications; ++m) {
+            p.medications.push_back({drugs[below(6)], to_string(5 * (1 + below(100))) + "mg", schedules[below(4)]});
+        }
+        for (size_t r = 0; r < config.reminders; ++r) {
+            char date[16], time[8];
+            snprintf(date, sizeof(date), "2024-%02u-%02u", unsigned(1 + below(12)), unsigned(1 + below(28)));
+            snprintf(time, sizeof(time), "%02u:%02u", unsigned(below(24)), unsigned(below(60)));
+            p.reminders.push_back({"Take " + string(drugs[below(6)]), date, time});
+            p.frequencies.push_back(ReminderFrequency(below(3)));
+        }
+        return p;
+    }
+};
+
+static void buildPatients(const Generator& gen, size_t count, vector<unique_ptr<Patient>>& out, pmr::memory_resource* memory) {
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        SyntheticPatient s = gen.patient(i);
+        auto p = make_unique<Patient>(move(s.name), s.age, move(s.contact), memory);
+        for (const SyntheticReading& r : s.readings) p->addVital(r.kind, r.timestamp, r.value1, r.value2);
+        for (const auto& m : s.medications) p->emplaceMedication(m[0], m[1], m[2]);
+        for (size_t r = 0; r < s.reminders.size(); ++r) {
+            p->emplaceReminder(s.reminders[r][0], s.reminders[r][1], s.reminders[r][2], s.frequencies[r]);
+        }
+        out.push_back(move(p));
+    }
+}
+
+static void buildLegacyPatients(const Generator& gen, size_t count, vector<unique_ptr<legacy::Patient>>& out) {
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        SyntheticPatient s = gen.patient(i);
+        auto p = make_unique<legacy::Patient>(s.name, s.age, s.contact);
+        for (const SyntheticReading& r : s.readings) {
+            switch (r.kind) {
+                case VitalKind::BloodPressure: p->addRecord(make_unique<legacy::BloodPressureRecord>(int(r.value1), int(r.value2), r.timestamp)); break;
+                case VitalKind::Weight: p->addRecord(make_unique<legacy::WeightRecord>(r.value1, r.timestamp)); break;
+                case VitalKind::BloodSugar: p->addRecord(make_unique<legacy::BloodSugarRecord>(r.value1, r.timestamp)); break;
+            }
+        }
+        for (const auto& m : s.medications) p->addMedication(legacy::Medication(m[0], m[1], m[2]));
+        for (const auto& r : s.reminders) p->addReminder(legacy::Reminder(r[0], r[1], r[2]));
+        out.push_back(move(p));
+    }
+}
+
+// --- Measurements ---
+struct Measurement {
+    string name;
+    double seconds = 0;
+    size_t items = 0; // rows or calls processed
+    uint64_t heapAllocations = 0, sqliteAllocations = 0;
+    vector<double> latenciesUs; // per call, for operations made of many calls
+    string note;
+};
+
+// Runs fn(measurement), which returns the number of items it processed.
+template <typename Fn>
+static Measurement measure(const char* name, Fn fn) {
+    Measurement m;
+    m.name = name;
+    uint64_t heap0 = heapAllocations.load(), sql0 = sqliteAllocations.load();
+    auto t0 = chrono::steady_clock::now();
+    {
+        QuietCout quiet;
+        m.items = fn(m);
+    }
+    m.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    m.heapAllocations = heapAllocations.load() - heap0;
+    m.sqliteAllocations = sqliteAllocations.load() - sql0;
+    return m;
+}
+
+// Times one call into m.latenciesUs.
+template <typename Fn>
+static void timeCall(Measurement& m, Fn fn) {
+    auto t0 = chrono::steady_clock::now();
+    fn();
+    m.latenciesUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+}
+
+static size_t rowCount(const vector<unique_ptr<Patient>>& patients) {
+    size_t rows = 0;
+    for (const auto& p : patients) rows += 1 + p->getVitals().size() + p->getMedications().size() + p->getReminders().size();
+    return rows;
+}
+
+static void removeDatabase(const string& path) {
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+}
+
+// --- JSON output ---
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = size_t(p / 100.0 * double(sorted.size() - 1) + 0.5);
+    return sorted[min(rank, sorted.size() - 1)];
+}
+
+static void writeMeasurement(JsonWriter& json, const Measurement& m) {
+    json.beginObject(m.name.c_str());
+    json.field("seconds", m.seconds);
+    json.field("items", uint64_t(m.items));
+    json.field("items_per_second", m.seconds > 0 ? m.items / m.seconds : 0.0);
+    json.field("heap_allocations", m.heapAllocations);
+    json.field("sqlite_allocations", m.sqliteAllocations);
+    if (!m.latenciesUs.empty()) {
+        vector<double> sorted = m.latenciesUs;
+        sort(sorted.begin(), sorted.end());
+        json.beginObject("latency_us");
+        json.field("p50", percentile(sorted, 50));
+        json.field("p90", percentile(sorted, 90));
+        json.field("p99", percentile(sorted, 99));
+        json.field("max", sorted.back());
+        json.endObject();
+    }
+    if (!m.note.empty()) json.field("note", m.note);
+    json.endObject();
+}
+
+// --- One scale ---
+static void runScale(const BenchConfig& config, size_t patientCount, JsonWriter& json) {
+    Generator gen(config);
+    vector<Measurement> results;
+    string dbPath = "bench_" + to_string(patientCount) + ".db";
+    removeDatabase(dbPath);
+
+    {
+        DatabaseManager db(dbPath);
+        results.push_back(measure("createTables", [&](Measurement&) {
+            db.open();
+            db.createTables();
+            return size_t(1);
+        }));
+
+        size_t rows = 0;
+        {
+            PatientArena arena;
+            vector<unique_ptr<Patient>> patients;
+            buildPatients(gen, patientCount, patients, arena.resource());
+            rows = rowCount(patients);
+            results.push_back(measure("saveAllPatients", [&](Measurement& m) {
+                if (!db.saveAllPatients(patients)) m.note = "save failed";
+                return rows;
+            }));
+        }
+
+        {
+            PatientArena arena;
+            vector<unique_ptr<Patient>> loaded;
+            results.push_back(measure("loadPatients", [&](Measurement&) {
+                db.loadPatients(loaded, arena.resource());
+                return rowCount(loaded);
+            }));
+        }
+
+        PatientArena arena;
+        vector<unique_ptr<Patient>> loaded;
+        unsigned threads = max(2u, thread::hardware_concurrency());
+        results.push_back(measure("loadPatientsParallel", [&](Measurement& m) {
+            db.loadPatientsParallel(loaded, arena, threads);
+            m.note = to_string(threads) + " threads";
+            return rowCount(loaded);
+        }));
+
+        // The last 30 days of one vital kind for evenly spread sample patients.
+        size_t step = max<size_t>(1, loaded.size() / max<size_t>(1, config.samples));
+        const time_t Month = 30 * 24 * 3600;
+        auto windowOf = [&](const Patient& p, VitalKind kind) {
+            const VitalSeries& s = p.getVitals().series(kind);
+            time_t last = s.empty() ? 0 : s.times().back();
+            return make_pair(last - Month, last);
+        };
+        auto trendQuerySql = [&](Measurement& m) {
+            for (size_t i = 0; i < loaded.size(); i += step) {
+                const Patient& p = *loaded[i];
+                VitalKind kind = VitalKind(i % VitalKindCount);
+                auto window = windowOf(p, kind);
+                VitalSeries out(vitalHasSecondValue(kind));
+                timeCall(m, [&] { db.loadVitalsInRange(p.getRowId(), kind, window.first, window.second, out); });
+            }
+            return m.latenciesUs.size();
+        };
+        results.push_back(measure("trendQuerySql", trendQuerySql));
+        results.push_back(measure("trendQueryMemory", [&](Measurement& m) {
+            volatile double sink = 0;
+            for (size_t i = 0; i < loaded.size(); i += step) {
+                const Patient& p = *loaded[i];
+                VitalKind kind = VitalKind(i % VitalKindCount);
+                auto window = windowOf(p, kind);
+                timeCall(m, [&] {
+                    const VitalSeries& s = p.getVitals().series(kind);
+                    auto range = s.range(window.first, window.second);
+                    double sum = 0;
+                    for (size_t k = range.first; k < range.second; ++k) sum += s.values1()[k];
+                    sink = sink + sum;
+                });
+            }
+            return m.latenciesUs.size();
+        }));
+        results.push_back(measure("reminderCheck", [&](Measurement& m) {
+            size_t due = 0;
+            for (const auto& p : loaded) {
+                timeCall(m, [&] {
+                    for (const Reminder& r : p->getReminders()) due += r.isDue();
+                });
+            }
+            m.note = to_string(due) + " due";
+            return m.latenciesUs.size();
+        }));
+        // A restart on the database as it is now, up to where main() shows the menu:
+        // the schema version check, patient summaries, the name index, and the
+        // reminders, read on their own connection while the summaries load.
+        results.push_back(measure("warmRestart", [&](Measurement&) {
+            DatabaseManager restarted(dbPath);
+            restarted.open();
+            restarted.createTables();
+            ReminderScheduler scheduler;
+            thread reminderLoader([&] {
+                DatabaseManager reader(dbPath);
+                if (!reader.openReadOnly(restarted.connectionProfile())) return;
+                reader.forEachReminder([&](string_view name, const Reminder& r) { scheduler.schedule(name, r); });
+            });
+            PatientArena summaryArena;
+            vector<unique_ptr<Patient>> summaries;
+            HistoryCache cache(restarted, 64 * 1024 * 1024);
+            restarted.loadPatientSummaries(summaries, &cache, summaryArena.resource());
+            PatientIndex index(summaries);
+            index.rebuild();
+            reminderLoader.join();
+            return summaries.size();
+        }));
+
+        // Every reading sealed into chunks, then the SQL-backed operations again.
+        size_t readings = 0;
+        for (const auto& p : loaded) readings += p->getVitals().size();
+        long long rowBytes = db.databaseBytes();
+        results.push_back(measure("compactVitals", [&](Measurement& m) {
+            if (!db.compactVitals(numeric_limits<time_t>::max())) m.note = "compaction failed";
+            else m.note = "database " + to_string(rowBytes / 1024) + " KiB -> " + to_string(db.databaseBytes() / 1024) + " KiB";
+            return readings;
+        }));
+        {
+            PatientArena sealedArena;
+            vector<unique_ptr<Patient>> sealed;
+            results.push_back(measure("loadPatientsParallelCompacted", [&](Measurement& m) {
+                db.loadPatientsParallel(sealed, sealedArena, threads);
+                m.note = to_string(threads) + " threads";
+                return rowCount(sealed);
+            }));
+        }
+        results.push_back(measure("trendQuerySqlCompacted", trendQuerySql));
+
+        // Reader threads each claim whole shards and summarise their patients, for a
+        // fixed time, while this thread adds a reading to some patient every 50 us.
+        PatientRegistry registry;
+        registry.adopt(loaded);
+        mt19937 pick(config.seed);
+        for (unsigned readers : {1u, 2u, 4u, 8u}) {
+            string name = "registryRead" + to_string(readers);
+            results.push_back(measure(name.c_str(), [&](Measurement& m) {
+                atomic<bool> stop{false};
+                atomic<size_t> summaries{0};
+                vector<thread> pool;
+                for (unsigned t = 0; t < readers; ++t) {
+                    pool.emplace_back([&, t] {
+                        size_t done = 0;
+                        volatile double sink = 0;
+                        for (size_t shard = t; !stop.load(memory_order_relaxed); shard = (shard + 1) % PatientRegistry::ShardCount) {
+                            registry.forEachInShard(shard, [&](const Patient& p) {
+                                sink = sink + summarizeVitals(p.getVitals()).weight.sum;
+                                ++done;
+                            });
+                        }
+                        summaries += done;
+                    });
+                }
+                size_t edits = 0;
+                auto until = chrono::steady_clock::now() + chrono::milliseconds(500);
+                while (chrono::steady_clock::now() < until) {
+                    Patient& p = *registry.patients()[pick() % registry.patients().size()];
+                    registry.edit(p, [](Patient& patient) { patient.getVitals().add(VitalKind::Weight, time(nullptr), 70.0, 0.0); });
+                    ++edits;
+                    this_thread::sleep_for(chrono::microseconds(50));
+                }
+                stop = true;
+                for (thread& t : pool) t.join();
+                m.note = to_string(readers) + " readers, " + to_string(edits) + " edits";
+                return summaries.load();
+            }));
+        }
+        for (unsigned threads : {1u, 2u, 4u, 8u}) {
+            WorkStealingPool pool(threads);
+            string name = "populationReport" + to_string(threads);
+            results.push_back(measure(name.c_str(), [&](Measurement& m) {
+                PopulationReport report = ReportEngine::run(registry, pool, nullptr, ReportOptions());
+                m.note = to_string(threads) + " threads, " + to_string(report.inactive.count) + " inactive";
+                return report.patients;
+            }));
+        }
+    }
+    removeDatabase(dbPath);
+
+    {
+        vector<unique_ptr<legacy::Patient>> patients;
+        buildLegacyPatients(gen, patientCount, patients);
+        size_t rows = 0;
+        for (const auto& p : patients) rows += 1 + p->getRecords().size() + p->getMedications().size() + p->getReminders().size();
+        results.push_back(measure("legacySaveData", [&](Measurement&) {
+            legacy::saveData(patients);
+            return rows;
+        }));
+        patients.clear();
+        results.push_back(measure("legacyLoadData", [&](Measurement& m) {
+            legacy::loadData(patients);
+            if (patients.size() != patientCount) {
+                m.note = "loaded " + to_string(patients.size()) + " of " + to_string(patientCount) + " patients (ver_2 refuses files with more than 10000)";
+            }
+            size_t loadedRows = 0;
+            for (const auto& p : patients) loadedRows += 1 + p->getRecords().size() + p->getMedications().size() + p->getReminders().size();
+            return loadedRows;
+        }));
+        remove(legacy::FILENAME.c_str());
+    }
+
+    json.beginObject();
+    json.field("patients", uint64_t(patientCount));
+    json.beginObject("operations");
+    for (const Measurement& m : results) writeMeasurement(json, m);
+    json.endObject();
+    json.field("peak_rss_kb", uint64_t(peakRssKb()));
+    json.endObject();
+}
+
+// --- Allocation budget (--check) ---
+// The load and save paths hand out views and bind without copies (user-014), so their
+// heap allocations are per patient, not per row. Each budget is a fixed allowance plus
+// one per patient and one per row; a copy per row or an extra one per patient blows it.
+// Only operator new is counted: SQLite's own allocator is outside the budget.
+struct AllocationBudget {
+    const char* operation;
+    uint64_t fixed;
+    double perPatient, perRow;
+};
+static const AllocationBudget allocationBudgets[] = {
+    {"saveAllPatients", 256, 0.0, 0.01},      // a pooled map and a few vectors growing
+    {"loadPatients", 256, 2.5, 0.01},         // the Patient, and the alert engine's index
+    {"loadPatientsParallel", 512, 2.5, 0.01}, // the same, plus the reader threads
+};
+
+// Saves and loads a generated dataset and checks each path against its budget.
+// Returns the number of paths over budget.
+static int runCheck(const BenchConfig& config, size_t patientCount) {
+    Generator gen(config);
+    vector<Measurement> results;
+    string dbPath = "check_" + to_string(patientCount) + ".db";
+    removeDatabase(dbPath);
+    size_t rows = 0;
+    {
+        DatabaseManager db(dbPath);
+        {
+            QuietCout quiet;
+            db.open();
+            db.createTables();
+        }
+        {
+            PatientArena arena;
+            vector<unique_ptr<Patient>> patients;
+            buildPatients(gen, patientCount, patients, arena.resource());
+            rows = rowCount(patients);
+            results.push_back(measure("saveAllPatients", [&](Measurement& m) {
+                if (!db.saveAllPatients(patients)) m.note = "save failed";
+                return rows;
+            }));
+        }
+        {
+            PatientArena arena;
+            vector<unique_ptr<Patient>> loaded;
+            results.push_back(measure("loadPatients", [&](Measurement&) {
+                db.loadPatients(loaded, arena.resource());
+                return rowCount(loaded);
+            }));
+        }
+        PatientArena arena;
+        vector<unique_ptr<Patient>> loaded;
+        results.push_back(measure("loadPatientsParallel", [&](Measurement&) {
+            db.loadPatientsParallel(loaded, arena, 4);
+            return rowCount(loaded);
+        }));
+    }
+    removeDatabase(dbPath);
+
+    int failed = 0;
+    for (const AllocationBudget& budget : allocationBudgets) {
+        auto m = find_if(results.begin(), results.end(), [&](const Measurement& r) { return r.name == budget.operation; });
+        uint64_t allowed = budget.fixed + uint64_t(budget.perPatient * patientCount + budget.perRow * rows);
+        if (m == results.end()) { printf("%-22s not run  FAILED\n", budget.operation); ++failed; continue; }
+        bool ok = m->note.empty() && m->items == rows && m->heapAllocations <= allowed;
+        if (!ok) ++failed;
+        printf("%-22s %8llu heap allocations for %zu patients, %zu rows (budget %llu)%s %s\n", budget.operation,
+               (unsigned long long)m->heapAllocations, patientCount, rows, (unsigned long long)allowed,
+               ok ? "" : "  FAILED", m->note.c_str());
+    }
+    return failed;
+}
+
+static vector<size_t> parseList(const char* text) {
+    vector<size_t> values;
+    for (const char* p = text; *p;) {
+        char* end;
+        unsigned long long v = strtoull(p, &end, 10);
+        if (end == p) break;
+        if (v > 0) values.push_back(size_t(v));
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    bool check = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--patients=", 11) == 0) config.scales = parseList(argv[i] + 11);
+        else if (strncmp(argv[i], "--records=", 10) == 0) config.records = strtoul(argv[i] + 10, nullptr, 10);
+        else if (strncmp(argv[i], "--medications=", 14) == 0) config.medications = strtoul(argv[i] + 14, nullptr, 10);
+        else if (strncmp(argv[i], "--reminders=", 12) == 0) config.reminders = strtoul(argv[i] + 12, nullptr, 10);
+        else if (strncmp(argv[i], "--samples=", 10) == 0) config.samples = strtoul(argv[i] + 10, nullptr, 10);
+        else if (strncmp(argv[i], "--seed=", 7) == 0) config.seed = uint32_t(strtoul(argv[i] + 7, nullptr, 10));
+        else if (strncmp(argv[i], "--dir=", 6) == 0) config.dir = argv[i] + 6;
+        else if (strcmp(argv[i], "--check") == 0) check = true;
+        else { fprintf(stderr, "Unknown option: %s\n", argv[i]); return 1; }
+    }
+    sort(config.scales.begin(), config.scales.end());
+    if (config.scales.empty()) { fprintf(stderr, "No patient counts given.\n"); return 1; }
+
+    countSqliteAllocations();
+#ifndef _WIN32
+    mkdir(config.dir.c_str(), 0755);
+    if (chdir(config.dir.c_str()) != 0) { fprintf(stderr, "Cannot use directory %s\n", config.dir.c_str()); return 1; }
+#else
+    _mkdir(config.dir.c_str());
+    if (_chdir(config.dir.c_str()) != 0) { fprintf(stderr, "Cannot use directory %s\n", config.dir.c_str()); return 1; }
+#endif
+
+    if (check) {
+        int failed = 0;
+        for (size_t n : config.scales) failed += runCheck(config, n);
+        return failed ? 1 : 0;
+    }
+
+    JsonWriter json;
+    json.beginObject();
+    json.field("benchmark", string("meditrack"));
+    json.beginObject("config");
+    json.field("records_per_patient", uint64_t(config.records));
+    json.field("medications_per_patient", uint64_t(config.medications));
+    json.field("reminders_per_patient", uint64_t(config.reminders));
+    json.field("trend_samples", uint64_t(config.samples));
+    json.field("seed", uint64_t(config.seed));
+    json.endObject();
+    json.beginArray("runs");
+    for (size_t n : config.scales) {
+        fprintf(stderr, "running %zu patients...\n", n);
+        runScale(config, n, json);
+    }
+    json.endArray();
+    json.endObject();
+    printf("%s\n", json.text().c_str());
+    return 0;
+}
@@ -119,7 +119,7 @@ public:
     bool isDue() const {
         time_t now = time(0);
         tm *ltm = localtime(&now);
-        char todayDate[11], currentTime[6];
+        char todayDate[40], currentTime[24];
         sprintf(todayDate, "%04d-%02d-%02d", 1900 + ltm->tm_year, 1 + ltm->tm_mon, ltm->tm_mday);
         sprintf(currentTime, "%02d:%02d", ltm->tm_hour, ltm->tm_min);
         return (date == todayDate && reminderTime <= currentTime);
@@ -447,7 +447,7 @@ void selectPatient(vector<unique_ptr<Patient>>& patients) {
     cout << "Select a patient by number: ";
     int patientIndex;
     cin >> patientIndex;
-    if (patientIndex > 0 && patientIndex <= patients.size()) {
+    if (patientIndex > 0 && size_t(patientIndex) <= patients.size()) {
         patientSubMenu(patients[patientIndex - 1].get());
     } else {
         cout << "Invalid selection.\n";
@@ -0,0 +1,35 @@
+// sqlite3_config.h
+// Compile-time options for the vendored sqlite3.c amalgamation. They are picked up
+// through SQLite's SQLITE_CUSTOM_INCLUDE hook, so sqlite3.c itself stays untouched:
+//
+//   gcc -O2 -DSQLITE_CUSTOM_INCLUDE=sqlite3_config.h -I. -c sqlite3.c
+//
+// These match the runtime ConnectionProfile in mediTrack_ver_3.cpp; a connection
+// can still override any of them with a PRAGMA.
+#pragma once
+
+// Multi-thread mode: SQLite can be used from several threads, as long as each
+// connection is only used by one thread at a time. No per-call connection mutex.
+#ifndef SQLITE_THREADSAFE
+#define SQLITE_THREADSAFE 2
+#endif
+
+// In WAL mode, sync only at checkpoints (synchronous=NORMAL) unless a profile asks for more.
+#define SQLITE_DEFAULT_WAL_SYNCHRONOUS 1
+
+// No global memory-usage bookkeeping on every malloc/free.
+#define SQLITE_DEFAULT_MEMSTATUS 0
+
+// Temp tables and sort spill files live in memory unless temp_store says otherwise.
+#define SQLITE_TEMP_STORE 2
+
+// Map up to 256 MiB of the database file by default; the bulk import profile raises it.
+#define SQLITE_DEFAULT_MMAP_SIZE 268435456
+
+// 64 MiB page cache per connection (negative values are KiB).
+#define SQLITE_DEFAULT_CACHE_SIZE -65536
+
+// Legacy interfaces and double-quoted string literals are not used by the app.
+#define SQLITE_OMIT_DEPRECATED 1
+#define SQLITE_DQS 0
+#define SQLITE_LIKE_DOESNT_MATCH_BLOBS 1
@@ -0,0 +1,124 @@
+// stats_bench.cpp
+// Micro-benchmark for VitalsStats.h: compares the old per-object loop (one heap
+// allocated, polymorphic record per reading, found with dynamic_cast) against the
+// scalar and vectorised column kernels on the same data.
+//
+// Build: g++ -std=c++17 -O2 stats_bench.cpp -o stats_bench
+// Run:   ./stats_bench [readings]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "VitalsStats.h"
+
+using namespace std;
+
+// The record layout before the columnar store, reduced to what the loop touches.
+struct OldRecord {
+    virtual ~OldRecord() = default;
+};
+struct OldBloodPressure : OldRecord {
+    int systolic, diastolic;
+    OldBloodPressure(int s, int d) : systolic(s), diastolic(d) {}
+};
+struct OldSugar : OldRecord {
+    double sugar;
+    explicit OldSugar(double s) : sugar(s) {}
+};
+
+struct Result {
+    ColumnStats systolic, sugar;
+    PairAlertCounts bp;
+};
+
+static Result perObjectLoop(const vector<unique_ptr<OldRecord>>& records) {
+    using namespace VitalThresholds;
+    Result r;
+    for (const auto& rec : records) {
+        if (auto bp = dynamic_cast<OldBloodPressure*>(rec.get())) {
+            double s = bp->systolic;
+            ColumnStats& c = r.systolic;
+            ++c.count;
+            if (s < c.min) c.min = s;
+            if (s > c.max) c.max = s;
+            c.sum += s;
+            c.sumSquares += s * s;
+            if (bp->systolic >= SystolicHigh || bp->diastolic >= DiastolicHigh) ++r.bp.high;
+            else if (bp->systolic <= SystolicLow || bp->diastolic <= DiastolicLow) ++r.bp.low;
+        } else if (auto sg = dynamic_cast<OldSugar*>(rec.get())) {
+            double x = sg->sugar;
+            ColumnStats& c = r.sugar;
+            ++c.count;
+            if (x < c.min) c.min = x;
+            if (x > c.max) c.max = x;
+            c.sum += x;
+            c.sumSquares += x * x;
+            if (x >= SugarHigh) ++c.high;
+            else if (x < SugarLow) ++c.low;
+        }
+    }
+    return r;
+}
+
+template <typename Fn>
+static double bestOfMs(int runs, Fn fn) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        auto t0 = chrono::steady_clock::now();
+        fn();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        if (ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+    mt19937 rng(42);
+    uniform_int_distribution<int> sysDist(80, 170), diaDist(50, 105);
+    uniform_real_distribution<double> sugarDist(55, 180);
+
+    vector<unique_ptr<OldRecord>> records;
+    vector<double> sys, dia, sugar;
+    records.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (i % 2 == 0) {
+            int s = sysDist(rng), d = diaDist(rng);
+            records.push_back(make_unique<OldBloodPressure>(s, d));
+            sys.push_back(s);
+            dia.push_back(d);
+        } else {
+            double x = sugarDist(rng);
+            records.push_back(make_unique<OldSugar>(x));
+            sugar.push_back(x);
+        }
+    }
+
+    volatile size_t sink = 0;
+    Result old;
+    double oldMs = bestOfMs(5, [&] { old = perObjectLoop(records); sink = sink + old.bp.high; });
+    double scalarMs = bestOfMs(5, [&] {
+        ColumnStats s = VitalsStatsDetail::columnStatsScalar(sys.data(), sys.size(), NoAlerts);
+        ColumnStats g = VitalsStatsDetail::columnStatsScalar(sugar.data(), sugar.size(), SugarAlerts);
+        PairAlertCounts bp = VitalsStatsDetail::pairAlertsScalar(sys.data(), dia.data(), sys.size());
+        sink = sink + s.count + g.high + bp.high;
+    });
+    Result cols;
+    double simdMs = bestOfMs(5, [&] {
+        cols.systolic = columnStats(sys.data(), sys.size());
+        cols.sugar = columnStats(sugar.data(), sugar.size(), SugarAlerts);
+        cols.bp = bloodPressureAlerts(sys.data(), dia.data(), sys.size());
+        sink = sink + cols.bp.high;
+    });
+
+    bool same = old.bp.high == cols.bp.high && old.bp.low == cols.bp.low && old.sugar.high == cols.sugar.high
+             && old.sugar.low == cols.sugar.low && old.systolic.min == cols.systolic.min && old.systolic.max == cols.systolic.max;
+    printf("readings: %zu\n", n);
+    printf("per-object loop : %8.2f ms\n", oldMs);
+    printf("scalar columns  : %8.2f ms  (%.1fx)\n", scalarMs, oldMs / scalarMs);
+    printf("simd columns    : %8.2f ms  (%.1fx)\n", simdMs, oldMs / simdMs);
+    printf("results match   : %s\n", same ? "yes" : "NO");
+    return same ? 0 : 1;
+}